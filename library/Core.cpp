@@ -48,6 +48,7 @@ distribution.
 #include "modules/Filesystem.h"
 #include "modules/Gui.h"
 #include "modules/Textures.h"
+#include "modules/Units.h"
 #include "modules/World.h"
 #include "modules/Persistence.h"
 
@@ -82,6 +83,10 @@ distribution.
 #include <forward_list>
 #include <type_traits>
 #include <cstdarg>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
 #include <SDL_events.h>
 
 #ifdef LINUX_BUILD
@@ -153,10 +158,60 @@ void PerfCounters::reset(bool ignorePauseState) {
     baseline_elapsed_ms = Core::getInstance().p->getTickCount();
 }
 
-void PerfCounters::incCounter(uint32_t &counter, uint32_t baseline_ms) {
+void PerfCounter::record(uint64_t elapsed_ns) {
+    total_ns += elapsed_ns;
+    max_ns = std::max(max_ns, elapsed_ns);
+    ++count;
+
+    uint64_t us = elapsed_ns / 1000;
+    size_t idx = 0;
+    if (us > 0) {
+        size_t octave = std::bit_width(us) - 1;
+        size_t sub;
+        if (octave >= NUM_OCTAVES) {
+            octave = NUM_OCTAVES - 1;
+            sub = SUB_BUCKETS - 1;
+        } else if (octave >= 2) {
+            sub = (us >> (octave - 2)) & (SUB_BUCKETS - 1);
+        } else {
+            sub = (us << (2 - octave)) & (SUB_BUCKETS - 1);
+        }
+        idx = 1 + octave * SUB_BUCKETS + sub;
+    }
+    ++buckets[idx];
+}
+
+uint64_t PerfCounter::getPercentileNs(double pct) const {
+    if (count == 0)
+        return 0;
+    uint64_t target = std::max<uint64_t>(1, uint64_t(std::ceil(count * pct / 100)));
+    uint64_t seen = 0;
+    for (size_t idx = 0; idx < NUM_BUCKETS; ++idx) {
+        seen += buckets[idx];
+        if (seen < target)
+            continue;
+        if (idx == 0)
+            return std::min<uint64_t>(1000, max_ns);
+        if (idx == NUM_BUCKETS - 1)
+            return max_ns;
+        size_t octave = (idx - 1) / SUB_BUCKETS;
+        size_t sub = (idx - 1) % SUB_BUCKETS;
+        uint64_t base_ns = uint64_t(1000) << octave;
+        uint64_t upper_ns = base_ns + (sub + 1) * base_ns / SUB_BUCKETS;
+        return std::min(upper_ns, max_ns);
+    }
+    return max_ns;
+}
+
+uint64_t PerfCounters::getTimestampNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PerfCounters::incCounter(PerfCounter &counter, uint64_t baseline_ns) {
     if (!ignore_pause_state && (!World::isFortressMode() || World::ReadPauseState()))
         return;
-    counter += Core::getInstance().p->getTickCount() - baseline_ms;
+    counter.record(getTimestampNs() - baseline_ns);
 }
 
 bool PerfCounters::getIgnorePauseState() {
@@ -2044,10 +2099,10 @@ int Core::Update()
                 return -1;
         }
 
-        uint32_t start_ms = p->getTickCount();
-        perf_counters.registerTick(start_ms);
+        uint64_t start_ns = PerfCounters::getTimestampNs();
+        perf_counters.registerTick(p->getTickCount());
         doUpdate(out);
-        perf_counters.incCounter(perf_counters.total_update_ms, start_ms);
+        perf_counters.incCounter(perf_counters.total_update_ms, start_ns);
     }
 
     // Let all commands run that require CoreSuspender
@@ -2061,29 +2116,35 @@ extern bool buildings_do_onupdate;
 void buildings_onStateChange(color_ostream &out, state_change_event event);
 void buildings_onUpdate(color_ostream &out);
 
+void world_onStateChange(color_ostream &out, state_change_event event);
+
+void materials_onStateChange(color_ostream &out, state_change_event event);
+
 static int buildings_timer = 0;
 
 void Core::onUpdate(color_ostream &out)
 {
     Gui::clearFocusStringCache();
+    Gui::clearViewportSnapshot();
+    Units::markUnitGridStale();
 
-    uint32_t step_start_ms = p->getTickCount();
+    uint64_t step_start_ns = PerfCounters::getTimestampNs();
     EventManager::manageEvents(out);
-    perf_counters.incCounter(perf_counters.update_event_manager_ms, step_start_ms);
+    perf_counters.incCounter(perf_counters.update_event_manager_ms, step_start_ns);
 
     // convert building reagents
     if (buildings_do_onupdate && (++buildings_timer & 1))
         buildings_onUpdate(out);
 
     // notify all the plugins that a game tick is finished
-    step_start_ms = p->getTickCount();
+    step_start_ns = PerfCounters::getTimestampNs();
     plug_mgr->OnUpdate(out);
-    perf_counters.incCounter(perf_counters.update_plugin_ms, step_start_ms);
+    perf_counters.incCounter(perf_counters.update_plugin_ms, step_start_ns);
 
     // process timers in lua
-    step_start_ms = p->getTickCount();
+    step_start_ns = PerfCounters::getTimestampNs();
     Lua::Core::onUpdate(out);
-    perf_counters.incCounter(perf_counters.update_lua_ms, step_start_ms);
+    perf_counters.incCounter(perf_counters.update_lua_ms, step_start_ns);
 }
 
 void getFilesWithPrefixAndSuffix(const std::string& folder, const std::string& prefix, const std::string& suffix, std::vector<std::string>& result) {
@@ -2305,6 +2366,10 @@ void Core::onStateChange(color_ostream &out, state_change_event event)
 
     buildings_onStateChange(out, event);
 
+    world_onStateChange(out, event);
+
+    materials_onStateChange(out, event);
+
     plug_mgr->OnStateChange(out, event);
 
     Lua::Core::onStateChange(out, event);
@@ -2433,9 +2498,9 @@ void Core::setArmokTools(const std::vector<std::string> &tool_names) {
 
 // returns true if the event is handled
 bool Core::DFH_SDL_Event(SDL_Event* ev) {
-    uint32_t start_ms = p->getTickCount();
+    uint64_t start_ns = PerfCounters::getTimestampNs();
     bool ret = doSdlInputEvent(ev);
-    perf_counters.incCounter(perf_counters.total_keybinding_ms, start_ms);
+    perf_counters.incCounter(perf_counters.total_keybinding_ms, start_ns);
     return ret;
 }
 
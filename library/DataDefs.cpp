@@ -24,6 +24,9 @@ distribution.
 
 #include "Internal.h"
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 #include <map>
@@ -119,6 +122,8 @@ const std::string compound_identity::getFullName() const
 
 static std::mutex *known_mutex = NULL;
 
+static void publish_known_vtables();
+
 void compound_identity::Init(Core *core)
 {
     if (!known_mutex)
@@ -128,6 +133,30 @@ void compound_identity::Init(Core *core)
     // they are called in an undefined order.
     for (compound_identity *p = list; p; p = p->next)
         p->doInit(core);
+
+    // Number the class tree, so that is_subclass is an interval test.
+    int counter = 0;
+    for (compound_identity *p = list; p; p = p->next)
+    {
+        switch (p->type())
+        {
+        case IDTYPE_STRUCT:
+        case IDTYPE_CLASS:
+        case IDTYPE_UNION:
+        case IDTYPE_GLOBAL:
+        {
+            auto s = static_cast<struct_identity*>(p);
+            if (!s->getParent())
+                s->numberSubtree(counter);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(*known_mutex);
+    publish_known_vtables();
 }
 
 bitfield_identity::bitfield_identity(size_t size,
@@ -180,10 +209,19 @@ struct_identity::struct_identity(size_t size, TAllocateFn alloc,
     const compound_identity *scope_parent, const char *dfhack_name,
     const struct_identity *parent, const struct_field_info *fields)
     : compound_identity(size, alloc, scope_parent, dfhack_name),
-      parent(const_cast<struct_identity*>(parent)), has_children(false), fields(fields)
+      parent(const_cast<struct_identity*>(parent)), has_children(false),
+      class_first(-1), class_last(-1), fields(fields)
 {
 }
 
+void struct_identity::numberSubtree(int &counter) const
+{
+    class_first = counter++;
+    for (auto child : children)
+        child->numberSubtree(counter);
+    class_last = counter - 1;
+}
+
 void struct_identity::doInit(Core *core)
 {
     compound_identity::doInit(core);
@@ -199,6 +237,15 @@ bool struct_identity::is_subclass(const struct_identity *actual) const
     if (!has_children && actual != this)
         return false;
 
+    if (class_first >= 0)
+    {
+        // Climb out of any plugin classes, which are not numbered.
+        for (; actual && actual->class_first < 0; actual = actual->getParent())
+            if (actual == this) return true;
+
+        return actual && class_first <= actual->class_first && actual->class_first <= class_last;
+    }
+
     for (; actual; actual = actual->getParent())
         if (actual == this) return true;
 
@@ -255,8 +302,139 @@ virtual_identity::virtual_identity(size_t size, const TAllocateFn alloc,
 /* Vtable name to identity lookup. */
 static std::map<std::string, virtual_identity*> name_lookup;
 
-/* Vtable pointer to identity lookup. */
-std::map<void*, virtual_identity*> virtual_identity::known;
+/* Vtable pointer to identity lookup; NULL marks vtables of unknown classes. */
+static std::map<void*, virtual_identity*> known;
+
+/*
+ * Open-addressed copy of the known map, which find() reads without locking.
+ * Entries are added in place, and plugin classes are replaced by tombstones
+ * in place, under known_mutex. Only growing the table publishes a fresh copy,
+ * which leaves the tombstones behind. A reader may still be probing a
+ * superseded copy, so those are kept for the life of the process; each copy
+ * is at least twice the size of the one before, so together they never take
+ * more memory than the live table.
+ */
+namespace {
+    // Marks the slot of a vtable that was removed; probes continue past it.
+    void *const TOMBSTONE = reinterpret_cast<void*>(uintptr_t(1));
+
+    struct vtable_table {
+        struct entry {
+            std::atomic<void*> vtable;
+            std::atomic<virtual_identity*> identity;
+        };
+
+        size_t capacity;
+        size_t count;
+        unsigned shift;
+        std::unique_ptr<entry[]> entries;
+
+        size_t slot(void *vtable) const {
+            return size_t((uint64_t(uintptr_t(vtable)) * 0x9E3779B97F4A7C15ULL) >> shift);
+        }
+
+        vtable_table(const std::map<void*, virtual_identity*> &items, size_t min_capacity)
+            : count(0)
+        {
+            // Leave room to add entries in place before the next copy.
+            unsigned bits = 6;
+            while ((size_t(1) << bits) < std::max(items.size() * 4, min_capacity))
+                bits++;
+            capacity = size_t(1) << bits;
+            shift = 64 - bits;
+            entries.reset(new entry[capacity]());
+
+            for (auto &item : items)
+                add(item.first, item.second);
+        }
+
+        void remove(void *vtable)
+        {
+            size_t i = slot(vtable);
+            for (; void *key = entries[i].vtable.load(std::memory_order_relaxed); i = (i + 1) & (capacity - 1))
+            {
+                if (key == vtable)
+                {
+                    // The slot stays counted, so the next copy drops it.
+                    entries[i].vtable.store(TOMBSTONE, std::memory_order_release);
+                    entries[i].identity.store(NULL, std::memory_order_release);
+                    return;
+                }
+            }
+        }
+
+        // Returns false if the table is too full and must be copied.
+        bool add(void *vtable, virtual_identity *identity)
+        {
+            size_t i = slot(vtable);
+            for (; void *key = entries[i].vtable.load(std::memory_order_relaxed); i = (i + 1) & (capacity - 1))
+            {
+                if (key == vtable)
+                {
+                    entries[i].identity.store(identity, std::memory_order_release);
+                    return true;
+                }
+            }
+
+            // Keep the load factor at or below one half.
+            if ((count + 1) * 2 > capacity)
+                return false;
+
+            entries[i].identity.store(identity, std::memory_order_relaxed);
+            entries[i].vtable.store(vtable, std::memory_order_release);
+            count++;
+            return true;
+        }
+
+        bool find(void *vtable, virtual_identity **identity) const
+        {
+            size_t i = slot(vtable);
+            for (; void *key = entries[i].vtable.load(std::memory_order_acquire); i = (i + 1) & (capacity - 1))
+            {
+                if (key == vtable)
+                {
+                    *identity = entries[i].identity.load(std::memory_order_acquire);
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+}
+
+static std::atomic<vtable_table*> known_table(NULL);
+static std::vector<std::unique_ptr<vtable_table>> known_tables;
+
+// Called with known_mutex held.
+static void publish_known_vtables()
+{
+    size_t min_capacity = known_tables.empty() ? 0 : known_tables.back()->capacity * 2;
+    known_tables.emplace_back(new vtable_table(known, min_capacity));
+    known_table.store(known_tables.back().get(), std::memory_order_release);
+}
+
+// Called with known_mutex held, after updating the known map.
+static void add_known_vtable(void *vtable, virtual_identity *identity)
+{
+    auto table = known_table.load(std::memory_order_relaxed);
+    if (!table || !table->add(vtable, identity))
+        publish_known_vtables();
+}
+
+// Record a vtable found in symbols.xml. Before Init has published the first
+// table, this runs single-threaded from the Init loop.
+static void register_vtable(void *vtable, virtual_identity *identity)
+{
+    if (!known_table.load(std::memory_order_relaxed))
+    {
+        known[vtable] = identity;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(*known_mutex);
+    known[vtable] = identity;
+    add_known_vtable(vtable, identity);
+}
 
 virtual_identity::~virtual_identity()
 {
@@ -271,8 +449,13 @@ virtual_identity::~virtual_identity()
     {
         name_lookup.erase(getOriginalName());
 
-        if (vtable_ptr)
+        if (vtable_ptr && known_mutex)
+        {
+            std::lock_guard<std::mutex> lock(*known_mutex);
             known.erase(vtable_ptr);
+            if (auto table = known_table.load(std::memory_order_relaxed))
+                table->remove(vtable_ptr);
+        }
     }
 }
 
@@ -285,7 +468,7 @@ void virtual_identity::doInit(Core *core)
 
     vtable_ptr = core->vinfo->getVTable(vtname);
     if (vtable_ptr)
-        known[vtable_ptr] = this;
+        register_vtable(vtable_ptr, this);
 }
 
 virtual_identity *virtual_identity::find(const std::string &name)
@@ -307,8 +490,12 @@ virtual_identity *virtual_identity::find(void *vtable)
     if (!vtable || !known_mutex)
         return NULL;
 
-    // Actually, a reader/writer lock would be sufficient,
-    // since the table is only written once per class.
+    virtual_identity *identity;
+    auto table = known_table.load(std::memory_order_acquire);
+    if (table && table->find(vtable, &identity))
+        return identity;
+
+    // First sighting of this vtable: resolve it by name and publish the result.
     std::lock_guard<std::mutex> lock(*known_mutex);
 
     std::map<void*, virtual_identity*>::iterator it = known.find(vtable);
@@ -316,7 +503,6 @@ virtual_identity *virtual_identity::find(void *vtable)
     if (it != known.end())
         return it->second;
 
-    // If using a reader/writer lock, re-grab as write here, and recheck
     Core &core = Core::getInstance();
     std::string name = core.p->doReadClassName(vtable);
 
@@ -338,6 +524,7 @@ virtual_identity *virtual_identity::find(void *vtable)
 
         known[vtable] = p;
         p->vtable_ptr = vtable;
+        add_known_vtable(vtable, p);
         return p;
     }
 
@@ -347,6 +534,7 @@ virtual_identity *virtual_identity::find(void *vtable)
     }
 
     known[vtable] = NULL;
+    add_known_vtable(vtable, NULL);
     return NULL;
 }
 
@@ -449,6 +637,28 @@ int DFHack::findEnumItem(const std::string &name, int size, const char *const *i
     return -1;
 }
 
+enum_key_index::enum_key_index(int size, const char *const *items)
+{
+    sorted.reserve(size);
+    for (int i = 0; i < size; i++) {
+        if (items[i])
+            sorted.emplace_back(items[i], i);
+    }
+    // ties are ordered by index, so find() returns the first match like findEnumItem
+    std::sort(sorted.begin(), sorted.end());
+}
+
+int enum_key_index::find(std::string_view name) const
+{
+    auto it = std::lower_bound(sorted.begin(), sorted.end(), name,
+        [](const std::pair<std::string_view, int> &item, std::string_view key) {
+            return item.first < key;
+        });
+    if (it == sorted.end() || it->first != name)
+        return -1;
+    return it->second;
+}
+
 void DFHack::flagarrayToString(std::vector<std::string> *pvec, const void *p,
                                int bytes, int base, int size, const char *const *items)
 {
@@ -290,7 +290,7 @@ static int dfhack_persistent_get_data_string(lua_State *L, get_data_fn get_data)
     if (!data.isValid())
         lua_pushnil(L);
     else
-        Lua::Push(L, data.val());
+        Lua::Push(L, data.get_str());
 
     return 1;
 }
@@ -448,6 +448,34 @@ static int dfhack_matinfo_find(lua_State *state)
     return 1;
 }
 
+static int dfhack_matinfo_findAll(lua_State *state)
+{
+    luaL_checktype(state, 1, LUA_TTABLE);
+
+    std::vector<string> tokens;
+    int count = lua_rawlen(state, 1);
+    tokens.reserve(count);
+    for (int i = 1; i <= count; i++)
+    {
+        lua_rawgeti(state, 1, i);
+        tokens.push_back(luaL_checkstring(state, -1));
+        lua_pop(state, 1);
+    }
+
+    std::vector<MaterialInfo> infos;
+    MaterialInfo::findAll(&infos, tokens);
+
+    lua_createtable(state, count, 0);
+    for (int i = 0; i < count; i++)
+    {
+        if (!infos[i].isValid())
+            continue;
+        Lua::Push(state, infos[i]);
+        lua_rawseti(state, -2, i+1);
+    }
+    return 1;
+}
+
 static bool decode_matinfo(lua_State *state, MaterialInfo *info, bool numpair = false)
 {
     int curtop = lua_gettop(state);
@@ -581,6 +609,7 @@ static int dfhack_matinfo_matches(lua_State *state)
 
 static const luaL_Reg dfhack_matinfo_funcs[] = {
     { "find", dfhack_matinfo_find },
+    { "findAll", dfhack_matinfo_findAll },
     { "decode", dfhack_matinfo_decode },
     { "getToken", dfhack_matinfo_getToken },
     { "toString", dfhack_matinfo_toString },
@@ -2057,6 +2086,7 @@ static const LuaWrapper::FunctionReg dfhack_units_module[] = {
     WRAPM(Units, isDanger),
     WRAPM(Units, isGreatDanger),
     WRAPM(Units, teleport),
+    WRAPM(Units, markUnitGridStale),
     WRAPM(Units, getGeneralRef),
     WRAPM(Units, getSpecificRef),
     WRAPM(Units, getContainer),
@@ -2184,6 +2214,54 @@ static int units_getUnitsInBox(lua_State *state)
     return 2;
 }
 
+// Wraps the optional Lua predicate at idx for the spatial queries
+template<class T>
+static std::function<bool(T*)> check_spatial_filter(lua_State *state, int idx)
+{
+    if (lua_isnoneornil(state, idx))
+        return nullptr;
+    luaL_checktype(state, idx, LUA_TFUNCTION);
+    return [state, idx](T *obj) {
+        lua_pushvalue(state, idx);
+        Lua::PushDFObject(state, obj);
+        lua_call(state, 1, 1);
+        bool ret = lua_toboolean(state, -1);
+        lua_pop(state, 1);
+        return ret;
+    };
+}
+
+static int units_getUnitsInRadius(lua_State *state)
+{
+    df::coord center;
+    Lua::CheckDFAssign(state, &center, 1);
+    int radius = luaL_checkint(state, 2);
+    auto filter = check_spatial_filter<df::unit>(state, 3);
+
+    std::vector<df::unit*> units;
+    Units::getUnitsInRadius(units, center, radius);
+    if (filter)
+        std::erase_if(units, [&](df::unit *unit) { return !filter(unit); });
+
+    Lua::PushVector(state, units);
+    return 1;
+}
+
+static int units_getNearestUnits(lua_State *state)
+{
+    df::coord center;
+    Lua::CheckDFAssign(state, &center, 1);
+    int count = luaL_optint(state, 2, 1);
+    auto filter = check_spatial_filter<df::unit>(state, 3);
+
+    std::vector<df::unit*> units;
+    if (count > 0)
+        Units::getNearestUnits(units, center, count, filter);
+
+    Lua::PushVector(state, units);
+    return 1;
+}
+
 static int units_getCitizens(lua_State *L) {
     bool exclude_residents = lua_toboolean(L, 1); // defaults to false
     bool include_insane = lua_toboolean(L, 2); // defaults to false
@@ -2225,6 +2303,8 @@ static const luaL_Reg dfhack_units_funcs[] = {
     { "getOuterContainerRef", units_getOuterContainerRef },
     { "getNoblePositions", units_getNoblePositions },
     { "getUnitsInBox", units_getUnitsInBox },
+    { "getUnitsInRadius", units_getUnitsInRadius },
+    { "getNearestUnits", units_getNearestUnits },
     { "getCitizens", units_getCitizens },
     { "getUnitsByNobleRole", units_getUnitsByNobleRole},
     { "getStressCutoffs", units_getStressCutoffs },
@@ -2390,10 +2470,60 @@ static int items_createItem(lua_State *state)
     return 1;
 }
 
+static int items_getItemsInBox(lua_State *state)
+{
+    df::coord pos1, pos2;
+    Lua::CheckDFAssign(state, &pos1, 1);
+    Lua::CheckDFAssign(state, &pos2, 2);
+    auto filter = check_spatial_filter<df::item>(state, 3);
+
+    std::vector<df::item*> items;
+    Items::getItemsInBox(items, pos1, pos2);
+    if (filter)
+        std::erase_if(items, [&](df::item *item) { return !filter(item); });
+
+    Lua::PushVector(state, items);
+    return 1;
+}
+
+static int items_getItemsInRadius(lua_State *state)
+{
+    df::coord center;
+    Lua::CheckDFAssign(state, &center, 1);
+    int radius = luaL_checkint(state, 2);
+    auto filter = check_spatial_filter<df::item>(state, 3);
+
+    std::vector<df::item*> items;
+    Items::getItemsInRadius(items, center, radius);
+    if (filter)
+        std::erase_if(items, [&](df::item *item) { return !filter(item); });
+
+    Lua::PushVector(state, items);
+    return 1;
+}
+
+static int items_getNearestItems(lua_State *state)
+{
+    df::coord center;
+    Lua::CheckDFAssign(state, &center, 1);
+    int count = luaL_optint(state, 2, 1);
+    auto filter = check_spatial_filter<df::item>(state, 3);
+
+    std::vector<df::item*> items;
+    if (count > 0)
+        Items::getNearestItems(items, center, count, filter);
+
+    Lua::PushVector(state, items);
+    return 1;
+}
+
 static const luaL_Reg dfhack_items_funcs[] = {
     { "getPosition", items_getPosition },
     { "getOuterContainerRef", items_getOuterContainerRef },
     { "getContainedItems", items_getContainedItems },
+    { "getItemsInBox", items_getItemsInBox },
+    { "getItemsInRadius", items_getItemsInRadius },
+    { "getNearestItems", items_getNearestItems },
     { "moveToBuilding", items_moveToBuilding },
     { "createItem", items_createItem },
     { NULL, NULL }
@@ -3391,14 +3521,18 @@ static void resetPerfCounters(bool ignorePauseState) {
     counters.reset(ignorePauseState);
 }
 
-static void recordRepeatRuntime(string name, uint32_t start_ms) {
+static uint64_t getPerfTimestamp() {
+    return PerfCounters::getTimestampNs();
+}
+
+static void recordRepeatRuntime(string name, uint64_t start_ns) {
     auto & counters = Core::getInstance().perf_counters;
-    counters.incCounter(counters.update_lua_per_repeat[name.c_str()], start_ms);
+    counters.incCounter(counters.update_lua_per_repeat[name.c_str()], start_ns);
 }
 
-static void recordZScreenRuntime(string name, uint32_t start_ms) {
+static void recordZScreenRuntime(string name, uint64_t start_ns) {
     auto & counters = Core::getInstance().perf_counters;
-    counters.incCounter(counters.zscreen_per_focus[name.c_str()], start_ms);
+    counters.incCounter(counters.zscreen_per_focus[name.c_str()], start_ns);
 }
 
 static uint32_t getUnpausedFps() {
@@ -3444,6 +3578,7 @@ static const LuaWrapper::FunctionReg dfhack_internal_module[] = {
     WRAP(setClipboardTextCp437),
     WRAP(setClipboardTextCp437Multiline),
     WRAP(resetPerfCounters),
+    WRAP(getPerfTimestamp),
     WRAP(recordRepeatRuntime),
     WRAP(recordZScreenRuntime),
     WRAP(getUnpausedFps),
@@ -4091,13 +4226,59 @@ static std::map<const char *, T> translate_event_types(const std::unordered_map<
     return out_map;
 }
 
-static std::map<const char *, std::map<string, uint32_t>> mapify(std::map<const char *, std::unordered_map<string, uint32_t>> in_map) {
+static std::map<const char *, uint32_t> to_ms(const std::map<const char *, PerfCounter> & in_map) {
+    std::map<const char *, uint32_t> out_map;
+    for (auto & [k, v] : in_map)
+        out_map[k] = v.getTotalMs();
+    return out_map;
+}
+
+static std::map<string, uint32_t> to_ms(const std::unordered_map<string, PerfCounter> & in_map) {
+    std::map<string, uint32_t> out_map;
+    for (auto & [k, v] : in_map)
+        out_map[k] = v.getTotalMs();
+    return out_map;
+}
+
+static std::map<const char *, std::map<string, uint32_t>> mapify(const std::map<const char *, std::unordered_map<string, PerfCounter>> & in_map) {
     std::map<const char *, std::map<string, uint32_t>> out_map;
-    for (auto [k, v] : in_map)
-        out_map[k].insert(v.begin(), v.end());
+    for (auto & [k, v] : in_map)
+        out_map[k] = to_ms(v);
     return out_map;
 }
 
+static void push_histogram(lua_State *L, const PerfCounter & counter) {
+    lua_createtable(L, 0, 6);
+    lua_pushinteger(L, counter.count);
+    lua_setfield(L, -2, "count");
+    lua_pushnumber(L, counter.total_ns / 1e6);
+    lua_setfield(L, -2, "total_ms");
+    lua_pushnumber(L, counter.getPercentileNs(50) / 1e6);
+    lua_setfield(L, -2, "p50_ms");
+    lua_pushnumber(L, counter.getPercentileNs(95) / 1e6);
+    lua_setfield(L, -2, "p95_ms");
+    lua_pushnumber(L, counter.getPercentileNs(99) / 1e6);
+    lua_setfield(L, -2, "p99_ms");
+    lua_pushnumber(L, counter.max_ns / 1e6);
+    lua_setfield(L, -2, "max_ms");
+}
+
+template<typename K>
+static void push_histograms(lua_State *L, const std::map<K, PerfCounter> & counters) {
+    lua_createtable(L, 0, counters.size());
+    for (auto & [name, counter] : counters) {
+        if (!counter.count)
+            continue;
+        Lua::Push(L, name);
+        push_histogram(L, counter);
+        lua_settable(L, -3);
+    }
+}
+
+static void push_histograms(lua_State *L, const std::unordered_map<string, PerfCounter> & counters) {
+    push_histograms(L, std::map<string, PerfCounter>(counters.begin(), counters.end()));
+}
+
 static int internal_getPerfCounters(lua_State *L) {
     auto & core = Core::getInstance();
     auto & counters = core.perf_counters;
@@ -4106,27 +4287,60 @@ static int internal_getPerfCounters(lua_State *L) {
     if (counters.getIgnorePauseState() || !World::ReadPauseState())
         elapsed_ms += core.p->getTickCount() - counters.baseline_elapsed_ms;
 
+    auto em_per_event = translate_event_types(counters.event_manager_event_total_ms);
+    auto em_per_plugin_per_event = translate_event_types(counters.event_manager_event_per_plugin_ms);
+
     std::map<const char *, uint32_t> summary;
     summary["unpaused_only"] = counters.getIgnorePauseState() ? 0 : 1;
     summary["elapsed_ms"] = elapsed_ms;
-    summary["total_update_ms"] = counters.total_update_ms;
-    summary["update_event_manager_ms"] = counters.update_event_manager_ms;
-    summary["update_plugin_ms"] = counters.update_plugin_ms;
-    summary["update_lua_ms"] = counters.update_lua_ms;
-    summary["total_keybinding_ms"] = counters.total_keybinding_ms;
-    summary["total_overlay_ms"] = counters.total_overlay_ms;
+    summary["total_update_ms"] = counters.total_update_ms.getTotalMs();
+    summary["update_event_manager_ms"] = counters.update_event_manager_ms.getTotalMs();
+    summary["update_plugin_ms"] = counters.update_plugin_ms.getTotalMs();
+    summary["update_lua_ms"] = counters.update_lua_ms.getTotalMs();
+    summary["total_keybinding_ms"] = counters.total_keybinding_ms.getTotalMs();
+    summary["total_overlay_ms"] = counters.total_overlay_ms.getTotalMs();
     summary["total_zscreen_ms"] = std::accumulate(
-        std::begin(counters.zscreen_per_focus), std::end(counters.zscreen_per_focus), 0,
-        [](const uint32_t prev, const std::pair<const std::string, uint32_t>& p){ return prev + p.second; });
+        std::begin(counters.zscreen_per_focus), std::end(counters.zscreen_per_focus), uint64_t(0),
+        [](const uint64_t prev, const std::pair<const std::string, PerfCounter>& p){ return prev + p.second.total_ns; }) / 1000000;
     Lua::Push(L, summary);
-    Lua::Push(L, translate_event_types(counters.event_manager_event_total_ms));
-    Lua::Push(L, mapify(translate_event_types(counters.event_manager_event_per_plugin_ms)));
-    Lua::Push(L, counters.update_per_plugin);
-    Lua::Push(L, counters.state_change_per_plugin);
-    Lua::Push(L, counters.update_lua_per_repeat);
-    Lua::Push(L, counters.overlay_per_widget);
-    Lua::Push(L, counters.zscreen_per_focus);
-    return 8;
+    Lua::Push(L, to_ms(em_per_event));
+    Lua::Push(L, mapify(em_per_plugin_per_event));
+    Lua::Push(L, to_ms(counters.update_per_plugin));
+    Lua::Push(L, to_ms(counters.state_change_per_plugin));
+    Lua::Push(L, to_ms(counters.update_lua_per_repeat));
+    Lua::Push(L, to_ms(counters.overlay_per_widget));
+    Lua::Push(L, to_ms(counters.zscreen_per_focus));
+
+    // latency histograms, keyed by the same names as the totals above
+    lua_createtable(L, 0, 8);
+    push_histograms(L, std::map<const char *, PerfCounter>{
+        {"total_update", counters.total_update_ms},
+        {"update_event_manager", counters.update_event_manager_ms},
+        {"update_plugin", counters.update_plugin_ms},
+        {"update_lua", counters.update_lua_ms},
+        {"total_keybinding", counters.total_keybinding_ms},
+        {"total_overlay", counters.total_overlay_ms},
+    });
+    lua_setfield(L, -2, "summary");
+    push_histograms(L, em_per_event);
+    lua_setfield(L, -2, "em_per_event");
+    lua_createtable(L, 0, em_per_plugin_per_event.size());
+    for (auto & [event_name, per_plugin] : em_per_plugin_per_event) {
+        push_histograms(L, per_plugin);
+        lua_setfield(L, -2, event_name);
+    }
+    lua_setfield(L, -2, "em_per_plugin_per_event");
+    push_histograms(L, counters.update_per_plugin);
+    lua_setfield(L, -2, "update_per_plugin");
+    push_histograms(L, counters.state_change_per_plugin);
+    lua_setfield(L, -2, "state_change_per_plugin");
+    push_histograms(L, counters.update_lua_per_repeat);
+    lua_setfield(L, -2, "update_lua_per_repeat");
+    push_histograms(L, counters.overlay_per_widget);
+    lua_setfield(L, -2, "overlay_per_widget");
+    push_histograms(L, counters.zscreen_per_focus);
+    lua_setfield(L, -2, "zscreen_per_focus");
+    return 9;
 }
 
 static int internal_getClipboardTextCp437Multiline(lua_State *L) {
@@ -1061,6 +1061,66 @@ bool DFHack::Lua::PushModulePublic(color_ostream &out, lua_State *state,
     return true;
 }
 
+DFHack::Lua::FunctionRef::FunctionRef(const char *module_name, const char *fn_name)
+    : module_name(module_name), fn_name(fn_name),
+      state(NULL), module_ref(LUA_NOREF), fn_ref(LUA_NOREF)
+{
+}
+
+bool DFHack::Lua::FunctionRef::push(color_ostream &out, lua_State *L)
+{
+    AssertCoreSuspend(L);
+
+    if (state != L)
+    {
+        reset();
+        lua_pushstring(L, module_name);
+        module_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        lua_pushstring(L, fn_name);
+        fn_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        state = L;
+    }
+
+    // Same as PushModule, with the name already interned
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &DFHACK_LOADED_TOKEN);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, module_ref);
+    lua_rawget(L, -2);
+    lua_remove(L, -2);
+
+    if (!lua_toboolean(L, -1))
+    {
+        lua_pop(L, 1);
+        if (!PushModule(out, L, module_name))
+        {
+            out.printerr("Failed to load %s Lua code\n", module_name);
+            return false;
+        }
+    }
+
+    if (!lua_istable(L, -1))
+    {
+        lua_pop(L, 1);
+        out.printerr("Failed to load %s Lua code\n", module_name);
+        return false;
+    }
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, fn_ref);
+    lua_rawget(L, -2);
+    lua_remove(L, -2);
+    return true;
+}
+
+void DFHack::Lua::FunctionRef::reset()
+{
+    if (!state)
+        return;
+
+    luaL_unref(state, LUA_REGISTRYINDEX, module_ref);
+    luaL_unref(state, LUA_REGISTRYINDEX, fn_ref);
+    state = NULL;
+    module_ref = fn_ref = LUA_NOREF;
+}
+
 bool DFHack::Lua::Require(color_ostream &out, lua_State *state,
                           const std::string &module, bool setglobal)
 {
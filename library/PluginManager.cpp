@@ -44,8 +44,12 @@ distribution.
 
 using namespace DFHack;
 
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <vector>
 #include <map>
 using namespace std;
@@ -231,10 +235,27 @@ bool Plugin::load(color_ostream &con)
     {
         RefAutolock lock(access);
         if(state == PS_LOADED)
-        {
             return true;
-        }
-        else if(state != PS_UNLOADED && state != PS_DELETED)
+    }
+    // enter suspend
+    CoreSuspender suspend;
+    return open(con) && init(con);
+}
+
+#define plugin_abort_load ClosePlugin(plug); RefAutolock lock(access); state = PS_UNLOADED
+#define plugin_check_symbol(sym) \
+    if (!LookupPlugin(plug, sym)) \
+    { \
+        con.printerr("Plugin %s: missing symbol: %s\n", name.c_str(), sym); \
+        plugin_abort_load; \
+        return false; \
+    }
+
+bool Plugin::open(color_ostream &con)
+{
+    {
+        RefAutolock lock(access);
+        if(state != PS_UNLOADED && state != PS_DELETED)
         {
             if (state == PS_BROKEN)
                 con.printerr("Plugin %s is broken - cannot be loaded\n", name.c_str());
@@ -242,8 +263,6 @@ bool Plugin::load(color_ostream &con)
         }
         state = PS_LOADING;
     }
-    // enter suspend
-    CoreSuspender suspend;
     // open the library, etc
     fprintf(stderr, "loading plugin %s\n", name.c_str());
     DFLibrary * plug = OpenPlugin(path.c_str());
@@ -262,15 +281,6 @@ bool Plugin::load(color_ostream &con)
             return false;
         }
     }
-    #define plugin_abort_load ClosePlugin(plug); RefAutolock lock(access); state = PS_UNLOADED
-    #define plugin_check_symbol(sym) \
-        if (!LookupPlugin(plug, sym)) \
-        { \
-            con.printerr("Plugin %s: missing symbol: %s\n", name.c_str(), sym); \
-            plugin_abort_load; \
-            return false; \
-        }
-
     plugin_check_symbol("plugin_name")
     plugin_check_symbol("plugin_version")
     plugin_check_symbol("plugin_abi_version")
@@ -287,7 +297,6 @@ bool Plugin::load(color_ostream &con)
     const char ** plug_version =(const char ** ) LookupPlugin(plug, "plugin_version");
     const int *plugin_abi_version = (int*) LookupPlugin(plug, "plugin_abi_version");
     const char ** plug_git_desc_ptr = (const char**) LookupPlugin(plug, "plugin_git_description");
-    Plugin **plug_self = (Plugin**)LookupPlugin(plug, "plugin_self");
     const char *dfhack_version = Version::dfhack_version();
     const char *dfhack_git_desc = Version::git_description();
     const char *plug_git_desc = plug_git_desc_ptr ? *plug_git_desc_ptr : "unknown";
@@ -324,8 +333,6 @@ bool Plugin::load(color_ostream &con)
         plugin_abort_load;
         return false;
     }
-    *plug_self = this;
-    plugin_init = (command_result (*)(color_ostream &, std::vector <PluginCommand> &)) LookupPlugin(plug, "plugin_init");
     std::vector<std::string>* plugin_globals = *((std::vector<std::string>**) LookupPlugin(plug, "plugin_globals"));
     if (plugin_globals->size())
     {
@@ -343,6 +350,18 @@ bool Plugin::load(color_ostream &con)
             return false;
         }
     }
+    plugin_lib = plug;
+    return true;
+}
+
+bool Plugin::init(color_ostream &con)
+{
+    DFLibrary * plug = plugin_lib;
+    const char ** plug_git_desc_ptr = (const char**) LookupPlugin(plug, "plugin_git_description");
+    const char *plug_git_desc = plug_git_desc_ptr ? *plug_git_desc_ptr : "unknown";
+    Plugin **plug_self = (Plugin**)LookupPlugin(plug, "plugin_self");
+    *plug_self = this;
+    plugin_init = (command_result (*)(color_ostream &, std::vector <PluginCommand> &)) LookupPlugin(plug, "plugin_init");
     plugin_status = (command_result (*)(color_ostream &, std::string &)) LookupPlugin(plug, "plugin_status");
     plugin_onupdate = (command_result (*)(color_ostream &)) LookupPlugin(plug, "plugin_onupdate");
     plugin_shutdown = (command_result (*)(color_ostream &)) LookupPlugin(plug, "plugin_shutdown");
@@ -355,7 +374,6 @@ bool Plugin::load(color_ostream &con)
     plugin_load_world_data = (command_result (*)(color_ostream &)) LookupPlugin(plug, "plugin_load_world_data");
     plugin_load_site_data = (command_result (*)(color_ostream &)) LookupPlugin(plug, "plugin_load_site_data");
     index_lua(plug);
-    plugin_lib = plug;
     commands.clear();
     if (plugin_init(con, commands) == CR_OK)
     {
@@ -951,17 +969,129 @@ bool PluginManager::load (const string &name)
     return p->load(core->getConsole());
 }
 
+namespace {
+    struct plugin_load_time
+    {
+        std::string name;
+        uint64_t open_ns = 0;
+        uint64_t init_ns = 0;
+    };
+}
+
+static void print_load_times(std::vector<plugin_load_time> &times, uint64_t total_ns, size_t num_threads)
+{
+    std::sort(times.begin(), times.end(), [](const plugin_load_time &a, const plugin_load_time &b) {
+        return a.open_ns + a.init_ns > b.open_ns + b.init_ns;
+    });
+    fprintf(stderr, "loaded %zu plugins in %.1f ms (%zu loader thread%s), slowest first:\n",
+        times.size(), total_ns / 1e6, num_threads, num_threads == 1 ? "" : "s");
+    fprintf(stderr, "  %10s %10s  %s\n", "open ms", "init ms", "plugin");
+    for (size_t i = 0; i < times.size(); ++i)
+        fprintf(stderr, "  %10.2f %10.2f  %s\n",
+            times[i].open_ns / 1e6, times[i].init_ns / 1e6, times[i].name.c_str());
+    fflush(stderr);
+}
+
 bool PluginManager::loadAll()
 {
     lock_guard<std::recursive_mutex> lock{*plugin_mutex};
     auto files = listPlugins();
+    // directory order is arbitrary; sort so the load order is reproducible
+    std::sort(files.begin(), files.end());
     bool ok = true;
     // load all plugins in hack/plugins
+    std::vector<Plugin *> pending;
     for (auto f = files.begin(); f != files.end(); ++f)
     {
-        if (!load(*f))
+        if (!(*this)[*f] && !addPlugin(*f))
+        {
+            ok = false;
+            continue;
+        }
+        Plugin *p = (*this)[*f];
+        if (!p)
+        {
+            Core::printerr("Plugin failed to register: %s\n", f->c_str());
             ok = false;
+        }
+        else if (p->getState() != Plugin::PS_LOADED)
+            pending.push_back(p);
     }
+    if (pending.empty())
+        return ok;
+
+    CoreSuspender suspend;
+    color_ostream &con = core->getConsole();
+    std::vector<plugin_load_time> times(pending.size());
+    for (size_t i = 0; i < pending.size(); ++i)
+        times[i].name = pending[i]->getName();
+    size_t num_threads = 1;
+    uint64_t start_ns = PerfCounters::getTimestampNs();
+
+    if (getenv("DFHACK_PARALLEL_PLUGIN_LOAD") && pending.size() > 1)
+    {
+        // Map and validate the libraries on a thread pool, then run
+        // plugin_init serially in sorted order. Output from open() is
+        // buffered per plugin and replayed in the same order, so the
+        // console reads as it would after a serial load.
+        std::vector<buffered_color_ostream> out(pending.size());
+        std::vector<char> opened(pending.size(), false);
+        std::atomic<size_t> next{0};
+        auto worker = [&] {
+            for (size_t i; (i = next++) < pending.size(); )
+            {
+                uint64_t open_start_ns = PerfCounters::getTimestampNs();
+                opened[i] = pending[i]->open(out[i]);
+                times[i].open_ns = PerfCounters::getTimestampNs() - open_start_ns;
+            }
+        };
+        size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < std::min(max_threads, pending.size()); ++t)
+        {
+            // the remaining threads pick up the work if we run out
+            try { threads.emplace_back(worker); }
+            catch (std::system_error &) { break; }
+        }
+        num_threads = threads.size() + 1;
+        worker();
+        for (auto &thread : threads)
+            thread.join();
+
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            for (auto &fragment : out[i].fragments())
+            {
+                con.color(fragment.first);
+                con << fragment.second;
+            }
+            con.reset_color();
+            if (!opened[i])
+            {
+                ok = false;
+                continue;
+            }
+            uint64_t init_start_ns = PerfCounters::getTimestampNs();
+            if (!pending[i]->init(con))
+                ok = false;
+            times[i].init_ns = PerfCounters::getTimestampNs() - init_start_ns;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            uint64_t open_start_ns = PerfCounters::getTimestampNs();
+            bool opened = pending[i]->open(con);
+            uint64_t init_start_ns = PerfCounters::getTimestampNs();
+            times[i].open_ns = init_start_ns - open_start_ns;
+            if (!opened || !pending[i]->init(con))
+                ok = false;
+            times[i].init_ns = PerfCounters::getTimestampNs() - init_start_ns;
+        }
+    }
+
+    print_load_times(times, PerfCounters::getTimestampNs() - start_ns, num_threads);
     return ok;
 }
 
@@ -1042,9 +1172,9 @@ void PluginManager::OnUpdate(color_ostream &out)
     for (auto it = begin(); it != end(); ++it) {
         auto & plugin_name = it->first;
         auto & plugin = it->second;
-        uint32_t start_ms = core.p->getTickCount();
+        uint64_t start_ns = PerfCounters::getTimestampNs();
         plugin->on_update(out);
-        counters.incCounter(counters.update_per_plugin[plugin_name], start_ms);
+        counters.incCounter(counters.update_per_plugin[plugin_name], start_ns);
     }
 }
 
@@ -1055,9 +1185,9 @@ void PluginManager::OnStateChange(color_ostream &out, state_change_event event)
     for (auto it = begin(); it != end(); ++it) {
         auto & plugin_name = it->first;
         auto & plugin = it->second;
-        uint32_t start_ms = core.p->getTickCount();
+        uint64_t start_ns = PerfCounters::getTimestampNs();
         plugin->on_state_change(out, event);
-        counters.incCounter(counters.state_change_per_plugin[plugin_name], start_ms);
+        counters.incCounter(counters.state_change_per_plugin[plugin_name], start_ns);
     }
 }
 
@@ -92,6 +92,8 @@ RemoteClient::RemoteClient(color_ostream *default_output)
     active = false;
     socket = new CActiveSocket();
     suspend_ready = false;
+    protocol_version = 1;
+    next_request_id = 0;
 
     if (!p_default_output)
     {
@@ -188,7 +190,7 @@ bool RemoteClient::connect(int port)
 
     RPCHandshakeHeader header;
     memcpy(header.magic, RPCHandshakeHeader::REQUEST_MAGIC, sizeof(header.magic));
-    header.version = 1;
+    header.version = 2;
 
     if (socket->Send((uint8*)&header, sizeof(header)) != sizeof(header))
     {
@@ -205,13 +207,16 @@ bool RemoteClient::connect(int port)
     }
 
     if (memcmp(header.magic, RPCHandshakeHeader::RESPONSE_MAGIC, sizeof(header.magic)) ||
-        header.version != 1)
+        header.version < 1 || header.version > 2)
     {
         default_output().printerr("Invalid handshake response.\n");
         socket->Close();
         return active = false;
     }
 
+    protocol_version = header.version;
+    next_request_id = 0;
+
     bind_call.name = "BindMethod";
     bind_call.p_client = this;
     bind_call.id = 0;
@@ -347,20 +352,38 @@ bool RemoteFunctionBase::bind(color_ostream &out, RemoteClient *client,
     return client->bind(out, this, name, plugin);
 }
 
-bool sendRemoteMessage(CSimpleSocket *socket, int16_t id, const MessageLite *msg, bool size_ready)
+static int encodedMessageSize(int size, const int32_t *request_id)
 {
-    int size = size_ready ? msg->GetCachedSize() : msg->ByteSize();
-    int fullsz = size + sizeof(RPCMessageHeader);
+    return sizeof(RPCMessageHeader) + (request_id ? sizeof(int32_t) : 0) + size;
+}
 
-    uint8_t *data = new uint8_t[fullsz];
+static void encodeRemoteMessage(uint8_t *data, int16_t id, int size,
+                                const MessageLite *msg, const int32_t *request_id)
+{
     RPCMessageHeader *hdr = (RPCMessageHeader*)data;
 
     hdr->id = id;
     hdr->size = size;
 
     uint8_t *pstart = data + sizeof(RPCMessageHeader);
+    if (request_id)
+    {
+        memcpy(pstart, request_id, sizeof(int32_t));
+        pstart += sizeof(int32_t);
+    }
+
     uint8_t *pend = msg->SerializeWithCachedSizesToArray(pstart);
     assert((pend - pstart) == size); (void)pend;
+}
+
+bool sendRemoteMessage(CSimpleSocket *socket, int16_t id, const MessageLite *msg, bool size_ready,
+                       const int32_t *request_id = NULL)
+{
+    int size = size_ready ? msg->GetCachedSize() : msg->ByteSize();
+    int fullsz = encodedMessageSize(size, request_id);
+
+    uint8_t *data = new uint8_t[fullsz];
+    encodeRemoteMessage(data, id, size, msg, request_id);
 
     int got = socket->Send(data, fullsz);
     delete[] data;
@@ -393,13 +416,22 @@ command_result RemoteFunctionBase::execute(color_ostream &out,
         return CR_LINK_FAILURE;
     }
 
-    if (!sendRemoteMessage(p_client->socket, id, input, true))
+    int32_t request_id = p_client->next_request_id++;
+    bool tagged = p_client->supports_batch();
+
+    if (!sendRemoteMessage(p_client->socket, id, input, true, tagged ? &request_id : NULL))
     {
         out.printerr("In call to %s::%s: I/O error in send.\n",
                      this->plugin.c_str(), this->name.c_str());
         return CR_LINK_FAILURE;
     }
 
+    return read_reply(out, output, request_id);
+}
+
+command_result RemoteFunctionBase::read_reply(color_ostream &out, message_type *output,
+                                              int32_t request_id)
+{
     color_ostream_proxy text_decoder(out);
     CoreTextNotification text_data;
 
@@ -417,6 +449,26 @@ command_result RemoteFunctionBase::execute(color_ostream &out,
 
         //out.print("Received %d:%d\n", header.id, header.size);
 
+        if (p_client->supports_batch() &&
+            (header.id == RPC_REPLY_RESULT || header.id == RPC_REPLY_FAIL))
+        {
+            int32_t reply_id;
+
+            if (!readFullBuffer(p_client->socket, &reply_id, sizeof(reply_id)))
+            {
+                out.printerr("In call to %s::%s: I/O error in receive request id.\n",
+                             this->plugin.c_str(), this->name.c_str());
+                return CR_LINK_FAILURE;
+            }
+
+            if (reply_id != request_id)
+            {
+                out.printerr("In call to %s::%s: got reply to request %d instead of %d.\n",
+                             this->plugin.c_str(), this->name.c_str(), reply_id, request_id);
+                return CR_LINK_FAILURE;
+            }
+        }
+
         if ((DFHack::DFHackReplyCode)header.id == RPC_REPLY_FAIL)
             return header.size == CR_OK ? CR_FAILURE : command_result(header.size);
 
@@ -464,3 +516,87 @@ command_result RemoteFunctionBase::execute(color_ostream &out,
         delete[] buf;
     }
 }
+
+command_result RemoteClient::call_batch(color_ostream &out, std::vector<RemoteCall> &calls)
+{
+    if (!active || !socket->IsSocketValid())
+    {
+        out.printerr("In batch call: client connection not valid.\n");
+        return CR_LINK_FAILURE;
+    }
+
+    for (auto &call : calls)
+    {
+        if (!call.function || !call.function->isValid() || call.function->p_client != this)
+        {
+            out.printerr("In batch call: function not bound to this connection.\n");
+            return CR_NOT_IMPLEMENTED;
+        }
+    }
+
+    if (!supports_batch())
+    {
+        for (auto &call : calls)
+        {
+            call.result = call.function->execute(out, call.input, call.output);
+            if (call.result == CR_LINK_FAILURE)
+                return CR_LINK_FAILURE;
+        }
+        return CR_OK;
+    }
+
+    std::vector<uint8_t> data;
+    size_t start = 0;
+
+    while (start < calls.size())
+    {
+        // Pack as many calls as the server accepts into one send
+        size_t end = start;
+        data.assign(sizeof(RPCMessageHeader), 0);
+
+        while (end < calls.size() && end - start < (size_t)RPCMessageHeader::MAX_BATCH_SIZE)
+        {
+            auto &call = calls[end];
+            int size = call.input->ByteSize();
+
+            if (size > RPCMessageHeader::MAX_MESSAGE_SIZE)
+            {
+                out.printerr("In call to %s::%s: message too large: %d.\n",
+                             call.function->plugin.c_str(), call.function->name.c_str(), size);
+                return CR_LINK_FAILURE;
+            }
+
+            int msg_size = encodedMessageSize(size, &call.request_id);
+            if (end > start && data.size() + msg_size > (size_t)RPCMessageHeader::MAX_MESSAGE_SIZE)
+                break;
+
+            call.request_id = next_request_id++;
+
+            size_t offset = data.size();
+            data.resize(offset + msg_size);
+            encodeRemoteMessage(&data[offset], call.function->id, size, call.input, &call.request_id);
+            end++;
+        }
+
+        RPCMessageHeader header;
+        header.id = RPC_REQUEST_BATCH;
+        header.size = int32_t(end - start);
+        memcpy(data.data(), &header, sizeof(header));
+
+        if (socket->Send(data.data(), data.size()) != (int32)data.size())
+        {
+            out.printerr("In batch call: I/O error in send.\n");
+            return CR_LINK_FAILURE;
+        }
+
+        for (; start < end; start++)
+        {
+            auto &call = calls[start];
+            call.result = call.function->read_reply(out, call.output, call.request_id);
+            if (call.result == CR_LINK_FAILURE)
+                return CR_LINK_FAILURE;
+        }
+    }
+
+    return CR_OK;
+}
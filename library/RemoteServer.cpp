@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
 */
 
 
+#include <algorithm>
 #include <stdarg.h>
 #include <errno.h>
 #include <stdio.h>
@@ -71,7 +72,8 @@ using google::protobuf::MessageLite;
 
 bool readFullBuffer(CSimpleSocket *socket, void *buf, int size);
 bool sendRemoteMessage(CSimpleSocket *socket, int16_t id,
-                        const ::google::protobuf::MessageLite *msg, bool size_ready);
+                        const ::google::protobuf::MessageLite *msg, bool size_ready,
+                        const int32_t *request_id = NULL);
 
 std::mutex ServerMain::access_{};
 bool ServerMain::blocked_{};
@@ -157,6 +159,7 @@ ServerConnection::ServerConnection(CActiveSocket *socket)
     : socket(socket), stream(this)
 {
     in_error = false;
+    protocol_version = 1;
 
     core_service = new CoreService();
     core_service->finalize(this, &functions);
@@ -208,19 +211,36 @@ ServerFunctionBase *ServerConnection::findFunction(color_ostream &out, const std
     return svc->getFunction(name);
 }
 
-void ServerConnection::connection_ostream::flush_proxy()
+// appends a complete message frame, as sendRemoteMessage would send it
+static void appendRemoteMessage(std::string &buf, int16_t id, const MessageLite *msg,
+                                bool size_ready, const int32_t *request_id = NULL)
 {
-    if (owner->in_error)
-    {
-        buffer.clear();
-        return;
-    }
-
-    if (buffer.empty())
-        return;
+    RPCMessageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.id = id;
+    header.size = size_ready ? msg->GetCachedSize() : msg->ByteSize();
+    buf.append((const char*)&header, sizeof(header));
+    if (request_id)
+        buf.append((const char*)request_id, sizeof(int32_t));
+    size_t start = buf.size();
+    buf.resize(start + header.size);
+    msg->SerializeWithCachedSizesToArray((uint8_t*)&buf[start]);
+}
 
-    CoreTextNotification msg;
+static void appendFailure(std::string &buf, command_result res, const int32_t *request_id)
+{
+    RPCMessageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.id = RPC_REPLY_FAIL;
+    header.size = res;
+    buf.append((const char*)&header, sizeof(header));
+    if (request_id)
+        buf.append((const char*)request_id, sizeof(int32_t));
+}
 
+static void makeTextNotification(std::list<buffered_color_ostream::fragment_type> &buffer,
+                                 CoreTextNotification &msg)
+{
     for (auto it = buffer.begin(); it != buffer.end(); ++it)
     {
         auto frag = msg.add_fragments();
@@ -230,6 +250,31 @@ void ServerConnection::connection_ostream::flush_proxy()
     }
 
     buffer.clear();
+}
+
+void ServerConnection::connection_ostream::appendText(std::string &buf)
+{
+    if (buffer.empty())
+        return;
+
+    CoreTextNotification msg;
+    makeTextNotification(buffer, msg);
+    appendRemoteMessage(buf, RPC_REPLY_TEXT, &msg, false);
+}
+
+void ServerConnection::connection_ostream::flush_proxy()
+{
+    if (owner->in_error)
+    {
+        buffer.clear();
+        return;
+    }
+
+    if (buffer.empty() || deferred)
+        return;
+
+    CoreTextNotification msg;
+    makeTextNotification(buffer, msg);
 
     if (!sendRemoteMessage(owner->socket, RPC_REPLY_TEXT, &msg, false))
     {
@@ -271,7 +316,7 @@ void ServerConnection::threadFn()
         }
 
         memcpy(header.magic, RPCHandshakeHeader::RESPONSE_MAGIC, sizeof(header.magic));
-        header.version = 1;
+        header.version = protocol_version = std::min(header.version, 2);
 
         if (socket->Send((uint8*)&header, sizeof(header)) != sizeof(header))
         {
@@ -297,109 +342,289 @@ void ServerConnection::threadFn()
         if ((DFHack::DFHackReplyCode)header.id == RPC_REQUEST_QUIT)
             break;
 
-        if (header.size < 0 || header.size > RPCMessageHeader::MAX_MESSAGE_SIZE)
+        if ((DFHack::DFHackReplyCode)header.id == RPC_REQUEST_BATCH && protocol_version >= 2)
         {
-            out.printerr("In RPC server: invalid received size %d.\n", header.size);
-            break;
-        }
+            if (header.size <= 0 || header.size > RPCMessageHeader::MAX_BATCH_SIZE)
+            {
+                out.printerr("In RPC server: invalid batch size %d.\n", header.size);
+                break;
+            }
 
-        std::unique_ptr<uint8_t[]> buf(new uint8_t[header.size]);
+            std::vector<PendingCall> batch(header.size);
+            int64_t total_size = 0;
+            bool ok = true;
 
-        if (!readFullBuffer(socket, buf.get(), header.size))
-        {
-            out.printerr("In RPC server: I/O error in receive %d bytes of data.\n", header.size);
-            break;
+            for (auto &call : batch)
+            {
+                RPCMessageHeader call_header;
+
+                if (!readFullBuffer(socket, &call_header, sizeof(call_header)))
+                {
+                    out.printerr("In RPC server: I/O error in receive header.\n");
+                    ok = false;
+                    break;
+                }
+
+                if (call_header.id < 0)
+                {
+                    out.printerr("In RPC server: invalid call id %d in batch.\n", call_header.id);
+                    ok = false;
+                    break;
+                }
+
+                if (!readCall(out, call_header, call))
+                {
+                    ok = false;
+                    break;
+                }
+
+                total_size += call.size;
+                if (total_size > RPCMessageHeader::MAX_MESSAGE_SIZE)
+                {
+                    out.printerr("In RPC server: batch data too large.\n");
+                    ok = false;
+                    break;
+                }
+            }
+
+            if (!ok)
+                break;
+
+            BlockGuard lock;
+
+            if (!runBatch(out, batch))
+                break;
+
+            continue;
         }
 
-        //out.print("Handling %d:%d\n", header.id, header.size);
+        PendingCall call;
+
+        if (!readCall(out, header, call))
+            break;
 
-        // Find and call the function
-        int in_size = header.size;
         BlockGuard lock;
 
-        ServerFunctionBase *fn = vector_get(functions, header.id);
-        MessageLite *reply = NULL;
-        command_result res = CR_FAILURE;
+        if (!runCall(out, call))
+            break;
+    }
+
+    std::cerr << "Shutting down client connection." << endl;
+}
+
+bool ServerConnection::readCall(color_ostream &out, const RPCMessageHeader &header, PendingCall &call)
+{
+    call.id = header.id;
+    call.size = header.size;
+
+    if (protocol_version >= 2 &&
+        !readFullBuffer(socket, &call.request_id, sizeof(call.request_id)))
+    {
+        out.printerr("In RPC server: I/O error in receive request id.\n");
+        return false;
+    }
+
+    if (header.size < 0 || header.size > RPCMessageHeader::MAX_MESSAGE_SIZE)
+    {
+        out.printerr("In RPC server: invalid received size %d.\n", header.size);
+        return false;
+    }
+
+    call.data.reset(new uint8_t[header.size]);
+
+    if (!readFullBuffer(socket, call.data.get(), header.size))
+    {
+        out.printerr("In RPC server: I/O error in receive %d bytes of data.\n", header.size);
+        return false;
+    }
+
+    return true;
+}
+
+bool ServerConnection::needsSuspend(const PendingCall &call)
+{
+    ServerFunctionBase *fn = vector_get(functions, call.id);
+    return fn && !(fn->flags & SF_DONT_SUSPEND);
+}
+
+command_result ServerConnection::executeCall(PendingCall &call, ServerFunctionBase *&fn, MessageLite *&reply)
+{
+    //out.print("Handling %d:%d\n", call.id, call.size);
+
+    // Find and call the function
+    fn = vector_get(functions, call.id);
+    reply = NULL;
+    command_result res = CR_FAILURE;
 
-        if (!fn)
+    if (!fn)
+    {
+        stream.printerr("RPC call of invalid id %d\n", call.id);
+    }
+    else
+    {
+        if (((fn->flags & SF_ALLOW_REMOTE) != SF_ALLOW_REMOTE) && strcmp(socket->GetClientAddr(), "127.0.0.1") != 0)
+        {
+            stream.printerr("In call to %s: forbidden host: %s\n", fn->name, socket->GetClientAddr());
+        }
+        else if (!fn->in()->ParseFromArray(call.data.get(), call.size))
         {
-            stream.printerr("RPC call of invalid id %d\n", header.id);
+            stream.printerr("In call to %s: could not decode input args.\n", fn->name);
         }
         else
         {
-            if (((fn->flags & SF_ALLOW_REMOTE) != SF_ALLOW_REMOTE) && strcmp(socket->GetClientAddr(), "127.0.0.1") != 0)
-            {
-                stream.printerr("In call to %s: forbidden host: %s\n", fn->name, socket->GetClientAddr());
-            }
-            else if (!fn->in()->ParseFromArray(buf.get(), header.size))
+            call.data.reset();
+
+            reply = fn->out();
+
+            if (fn->flags & SF_DONT_SUSPEND)
             {
-                stream.printerr("In call to %s: could not decode input args.\n", fn->name);
+                res = fn->execute(stream);
             }
             else
             {
-                buf.reset();
-
-                reply = fn->out();
-
-                if (fn->flags & SF_DONT_SUSPEND)
-                {
-                    res = fn->execute(stream);
-                }
-                else
-                {
-                    CoreSuspender suspend;
-                    res = fn->execute(stream);
-                }
+                CoreSuspender suspend;
+                res = fn->execute(stream);
             }
         }
+    }
 
-        // Flush all text output
-        if (in_error)
-            break;
+    return res;
+}
+
+int ServerConnection::checkReplySize(ServerFunctionBase *fn, MessageLite *reply, command_result &res)
+{
+    int out_size = (reply ? reply->ByteSize() : 0);
+
+    if (out_size > RPCMessageHeader::MAX_MESSAGE_SIZE)
+    {
+        stream.printerr("In call to %s: reply too large: %d.\n",
+                            (fn ? fn->name : "UNKNOWN"), out_size);
+        res = CR_LINK_FAILURE;
+    }
+
+    return out_size;
+}
+
+void ServerConnection::finishCall(ServerFunctionBase *fn, int in_size, int out_size)
+{
+    // Cleanup
+    if (fn)
+    {
+        fn->reset((fn->flags & SF_CALLED_ONCE) ||
+                  (out_size > 128*1024 || in_size > 32*1024));
+    }
+}
+
+bool ServerConnection::runCall(color_ostream &out, PendingCall &call)
+{
+    int in_size = call.size;
+    ServerFunctionBase *fn;
+    MessageLite *reply;
+    command_result res = executeCall(call, fn, reply);
+
+    // Flush all text output
+    if (in_error)
+        return false;
 
-        //out.print("Answer %d:%d\n", res, reply);
+    //out.print("Answer %d:%d\n", res, reply);
 
-        // Send reply
-        int out_size = (reply ? reply->ByteSize() : 0);
+    // Send reply
+    int out_size = checkReplySize(fn, reply, res);
+
+    stream.flush();
+
+    const int32_t *request_id = (protocol_version >= 2) ? &call.request_id : NULL;
+
+    if (res == CR_OK && reply)
+    {
+        if (!sendRemoteMessage(socket, RPC_REPLY_RESULT, reply, true, request_id))
+        {
+            out.printerr("In RPC server: I/O error in send result.\n");
+            return false;
+        }
+    }
+    else
+    {
+        std::string data;
+        appendFailure(data, res, request_id);
 
-        if (out_size > RPCMessageHeader::MAX_MESSAGE_SIZE)
+        if (socket->Send((const uint8*)data.data(), data.size()) != (int32)data.size())
         {
-            stream.printerr("In call to %s: reply too large: %d.\n",
-                                (fn ? fn->name : "UNKNOWN"), out_size);
-            res = CR_LINK_FAILURE;
+            out.printerr("In RPC server: I/O error in send failure code.\n");
+            return false;
         }
+    }
 
-        stream.flush();
+    finishCall(fn, in_size, out_size);
 
-        if (res == CR_OK && reply)
+    return true;
+}
+
+bool ServerConnection::runBatch(color_ostream &out, std::vector<PendingCall> &batch)
+{
+    // Replies and text output are encoded into a buffer while the calls run
+    // and only written to the socket with the core resumed, so a client that
+    // is slow to read cannot stall the game. Consecutive calls share one
+    // suspend; SF_DONT_SUSPEND calls run resumed, as they would on their own.
+    std::string replies;
+    CoreSuspender suspend(std::defer_lock);
+    bool ok = true;
+
+    auto send_replies = [&]() {
+        if (suspend.owns_lock())
+            suspend.unlock();
+        if (!replies.empty() &&
+            socket->Send((const uint8*)replies.data(), replies.size()) != (int32)replies.size())
         {
-            if (!sendRemoteMessage(socket, RPC_REPLY_RESULT, reply, true))
-            {
-                out.printerr("In RPC server: I/O error in send result.\n");
-                break;
-            }
+            out.printerr("In RPC server: I/O error in send batch replies.\n");
+            ok = false;
         }
+        replies.clear();
+    };
+
+    stream.deferred = true;
+
+    for (auto &call : batch)
+    {
+        bool need_suspend = needsSuspend(call);
+        if (need_suspend && !suspend.owns_lock())
+            suspend.lock();
+        else if (!need_suspend && suspend.owns_lock())
+            suspend.unlock();
+
+        int in_size = call.size;
+        ServerFunctionBase *fn;
+        MessageLite *reply;
+        command_result res = executeCall(call, fn, reply);
+        int out_size = checkReplySize(fn, reply, res);
+
+        const int32_t *request_id = &call.request_id;
+
+        stream.appendText(replies);
+        if (res == CR_OK && reply)
+            appendRemoteMessage(replies, RPC_REPLY_RESULT, reply, true, request_id);
         else
-        {
-            header.id = RPC_REPLY_FAIL;
-            header.size = res;
+            appendFailure(replies, res, request_id);
 
-            if (socket->Send((uint8_t*)&header, sizeof(header)) != sizeof(header))
-            {
-                out.printerr("In RPC server: I/O error in send failure code.\n");
-                break;
-            }
-        }
+        finishCall(fn, in_size, out_size);
 
-        // Cleanup
-        if (fn)
+        // don't let a batch of large replies pile up in memory
+        if (replies.size() > size_t(RPCMessageHeader::MAX_MESSAGE_SIZE))
         {
-            fn->reset((fn->flags & SF_CALLED_ONCE) ||
-                      (out_size > 128*1024 || in_size > 32*1024));
+            send_replies();
+            if (!ok)
+                break;
         }
     }
 
-    std::cerr << "Shutting down client connection." << endl;
+    stream.deferred = false;
+
+    if (ok)
+        send_replies();
+    else if (suspend.owns_lock())
+        suspend.unlock();
+
+    return ok && !in_error;
 }
 
 namespace {
@@ -47,16 +47,74 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "Console.h"
 #include "RemoteClient.h"
+#include "BasicApi.pb.h"
 
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <sstream>
 
 #include <memory>
+#include <vector>
 
 using namespace DFHack;
 using namespace dfproto;
 
+// Times round trips of a small suspending call, first one call at a time and
+// then in batches, and prints calls per second for each.
+static command_result run_benchmark(RemoteClient &client, color_ostream &out, int count, int batch_size)
+{
+    if (count <= 0 || batch_size <= 0)
+        return CR_WRONG_USAGE;
+
+    RemoteFunction<EmptyMessage,GetWorldInfoOut> world_call;
+
+    if (!world_call.bind(&client, "GetWorldInfo"))
+    {
+        out.printerr("No GetWorldInfo protocol function found.\n");
+        return CR_NOT_IMPLEMENTED;
+    }
+
+    typedef std::chrono::steady_clock bench_clock;
+    auto report = [&](const char *name, bench_clock::time_point start) {
+        double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+        out.print("%-12s %8d calls in %9.3f ms (%.0f calls/s)\n", name, count,
+                  seconds * 1000, seconds > 0 ? count / seconds : 0.0);
+    };
+
+    auto start = bench_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        if (world_call() == CR_LINK_FAILURE)
+            return CR_LINK_FAILURE;
+    }
+    report("sequential", start);
+
+    if (!client.supports_batch())
+    {
+        out.print("The server does not support batched calls.\n");
+        return CR_OK;
+    }
+
+    EmptyMessage input;
+    std::vector<GetWorldInfoOut> outputs(batch_size);
+    std::vector<RemoteCall> calls;
+
+    start = bench_clock::now();
+    for (int done = 0; done < count; done += batch_size)
+    {
+        calls.clear();
+        for (int i = 0; i < batch_size && done + i < count; i++)
+            calls.emplace_back(&world_call, &input, &outputs[i]);
+
+        if (client.call_batch(out, calls) == CR_LINK_FAILURE)
+            return CR_LINK_FAILURE;
+    }
+    report("batched", start);
+
+    return CR_OK;
+}
+
 int main (int argc, char *argv[])
 {
     Console out;
@@ -89,7 +147,21 @@ int main (int argc, char *argv[])
 
     command_result rv;
 
-    if (strcmp(argv[1], "--lua") == 0)
+    if (strcmp(argv[1], "--benchmark") == 0)
+    {
+        int count = (argc > 2) ? atoi(argv[2]) : 1000;
+        int batch_size = (argc > 3) ? atoi(argv[3]) : 64;
+
+        rv = run_benchmark(client, out, count, batch_size);
+
+        if (rv == CR_WRONG_USAGE)
+        {
+            out.shutdown();
+            fprintf(stderr, "Usage: dfhack-run --benchmark [calls] [batch size]\n");
+            return 2;
+        }
+    }
+    else if (strcmp(argv[1], "--lua") == 0)
     {
         if (argc <= 3)
         {
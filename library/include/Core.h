@@ -101,30 +101,59 @@ namespace DFHack
         SC_UNPAUSED = 8
     };
 
+    // Accumulated runtime of a single timed code path. Each sample is also
+    // recorded in a fixed-bucket latency histogram so that rare spikes are not
+    // hidden by the total.
+    class DFHACK_EXPORT PerfCounter
+    {
+    public:
+        // log-linear buckets: SUB_BUCKETS per power of two microseconds.
+        // bucket 0 holds everything under 1us, the last bucket everything
+        // over ~2^27us (about 2 minutes).
+        static const size_t SUB_BUCKETS = 4;
+        static const size_t NUM_OCTAVES = 28;
+        static const size_t NUM_BUCKETS = 1 + NUM_OCTAVES * SUB_BUCKETS;
+
+        uint64_t total_ns = 0;
+        uint64_t max_ns = 0;
+        uint32_t count = 0;
+        uint32_t buckets[NUM_BUCKETS] = {};
+
+        void record(uint64_t elapsed_ns);
+
+        uint32_t getTotalMs() const { return uint32_t(total_ns / 1000000); }
+        // returns the upper bound of the bucket that holds the given
+        // percentile (0-100), clamped to the largest recorded sample
+        uint64_t getPercentileNs(double pct) const;
+    };
+
     class DFHACK_EXPORT PerfCounters
     {
     public:
         uint32_t baseline_elapsed_ms;
         uint32_t elapsed_ms;
-        uint32_t total_update_ms;
-        uint32_t update_event_manager_ms;
-        uint32_t update_plugin_ms;
-        uint32_t update_lua_ms;
-        uint32_t total_keybinding_ms;
-        uint32_t total_overlay_ms;
-        std::unordered_map<int32_t, uint32_t> event_manager_event_total_ms;
-        std::unordered_map<int32_t, std::unordered_map<std::string, uint32_t>> event_manager_event_per_plugin_ms;
-        std::unordered_map<std::string, uint32_t> update_per_plugin;
-        std::unordered_map<std::string, uint32_t> state_change_per_plugin;
-        std::unordered_map<std::string, uint32_t> update_lua_per_repeat;
-        std::unordered_map<std::string, uint32_t> overlay_per_widget;
-        std::unordered_map<std::string, uint32_t> zscreen_per_focus;
+        PerfCounter total_update_ms;
+        PerfCounter update_event_manager_ms;
+        PerfCounter update_plugin_ms;
+        PerfCounter update_lua_ms;
+        PerfCounter total_keybinding_ms;
+        PerfCounter total_overlay_ms;
+        std::unordered_map<int32_t, PerfCounter> event_manager_event_total_ms;
+        std::unordered_map<int32_t, std::unordered_map<std::string, PerfCounter>> event_manager_event_per_plugin_ms;
+        std::unordered_map<std::string, PerfCounter> update_per_plugin;
+        std::unordered_map<std::string, PerfCounter> state_change_per_plugin;
+        std::unordered_map<std::string, PerfCounter> update_lua_per_repeat;
+        std::unordered_map<std::string, PerfCounter> overlay_per_widget;
+        std::unordered_map<std::string, PerfCounter> zscreen_per_focus;
 
         void reset(bool ignorePauseState = false);
         bool getIgnorePauseState();
 
+        // monotonic high resolution timestamp to pass to incCounter
+        static uint64_t getTimestampNs();
+
         // noop if game is paused and getIgnorePauseState() returns false
-        void incCounter(uint32_t &perf_counter, uint32_t baseline_ms);
+        void incCounter(PerfCounter &perf_counter, uint64_t baseline_ns);
 
         void registerTick(uint32_t baseline_ms);
         uint32_t getUnpausedFps();
@@ -28,6 +28,7 @@ distribution.
 #include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -294,8 +295,16 @@ namespace DFHack
         mutable std::vector<const struct_identity*> children;
         bool has_children;
 
+        // Pre-order numbers of this class and of its last descendant,
+        // assigned once by compound_identity::Init; -1 for classes
+        // registered later by plugins.
+        mutable int class_first, class_last;
+
         const struct_field_info *fields;
 
+        friend class compound_identity;
+        void numberSubtree(int &counter) const;
+
     protected:
         virtual void doInit(Core *core);
 
@@ -365,8 +374,6 @@ namespace DFHack
     class MemoryPatcher;
 
     class DFHACK_EXPORT virtual_identity : public struct_identity {
-        static std::map<void*, virtual_identity*> known;
-
         const char *original_name;
 
         mutable void *vtable_ptr;
@@ -723,16 +730,45 @@ namespace DFHack {
 
     DFHACK_EXPORT int findEnumItem(const std::string &name, int size, const char *const *items);
 
+    /**
+     * Enum key table sorted by name, for lookups by binary search.
+     */
+    class DFHACK_EXPORT enum_key_index {
+        std::vector<std::pair<std::string_view, int>> sorted;
+    public:
+        enum_key_index(int size, const char *const *items);
+        // Index of the first item with this key, or -1 if none.
+        int find(std::string_view name) const;
+    };
+
+    /**
+     * Return the key index of an enum, built on first use.
+     */
+    template<class T>
+    inline const enum_key_index &get_enum_key_index() {
+        typedef df::enum_traits<T> traits;
+        if constexpr (traits::is_complex) {
+            static const enum_key_index index(int(traits::complex.size()), traits::key_table);
+            return index;
+        } else {
+            static const enum_key_index index(traits::last_item_value-traits::first_item_value+1,
+                                              traits::key_table);
+            return index;
+        }
+    }
+
     /**
      * Find an enum item by key string. Returns success code.
      */
     template<class T>
-    inline bool find_enum_item(T *var, const std::string &name) {
+    inline bool find_enum_item(T *var, std::string_view name) {
         typedef df::enum_traits<T> traits;
-        int size = traits::last_item_value-traits::first_item_value+1;
-        int idx = findEnumItem(name, size, traits::key_table);
+        int idx = get_enum_key_index<T>().find(name);
         if (idx < 0) return false;
-        *var = T(traits::first_item_value+idx);
+        if constexpr (traits::is_complex)
+            *var = T(traits::complex.index_value_map[idx]);
+        else
+            *var = T(traits::first_item_value+idx);
         return true;
     }
 
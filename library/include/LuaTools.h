@@ -467,6 +467,75 @@ namespace DFHack {namespace Lua {
         StackUnwinder &operator -- () { top--; return *this; }
     };
 
+    /**
+     * Handle to a public function of a module, for C++ code that calls it
+     * every frame. The module and function names are interned in the registry
+     * on first use, so a call costs three raw table lookups instead of two
+     * string hashes and a require() check. The function is looked up in the
+     * loaded module table on every call, so reload() is picked up without
+     * invalidating the handle. All methods require the core to be suspended;
+     * call reset() before the owning plugin is unloaded.
+     */
+    class DFHACK_EXPORT FunctionRef {
+        const char *module_name;
+        const char *fn_name;
+        lua_State *state;
+        int module_ref;
+        int fn_ref;
+
+    public:
+        FunctionRef(const char *module_name, const char *fn_name);
+
+        const char *getModuleName() const { return module_name; }
+        const char *getName() const { return fn_name; }
+
+        /**
+         * Push the function, loading the module if necessary. On failure,
+         * prints an error and leaves the stack as is.
+         */
+        bool push(color_ostream &out, lua_State *state);
+
+        /**
+         * Release the registry references.
+         */
+        void reset();
+
+        /**
+         * Call the function via SafeCall with nargs values pushed by push_args,
+         * then hand the nres results to res_fn. Leaves the stack as is.
+         */
+        template<typename ArgFn, typename ResFn>
+        bool invoke(color_ostream &out, lua_State *L, int nargs, int nres,
+                    ArgFn &&push_args, ResFn &&res_fn)
+        {
+            StackUnwinder top(L);
+
+            if (!lua_checkstack(L, 1 + nargs) || !push(out, L))
+                return false;
+
+            push_args(L);
+
+            if (!SafeCall(out, L, nargs, nres)) {
+                out.printerr("Failed Lua call to '%s.%s'\n", module_name, fn_name);
+                return false;
+            }
+
+            res_fn(L);
+            return true;
+        }
+
+        /**
+         * Call the function with the given arguments, discarding any results.
+         */
+        template<typename... aT>
+        bool call(color_ostream &out, lua_State *L, const aT&... args)
+        {
+            return invoke(out, L, sizeof...(aT), 0,
+                [&](lua_State *L) { (Lua::Push(L, args), ...); },
+                [](lua_State *) {});
+        }
+    };
+
     /**
      * Namespace for the common lua interpreter state.
      * All accesses must be done under CoreSuspender.
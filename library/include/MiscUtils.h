@@ -283,6 +283,108 @@ CT *binsearch_in_vector(const std::vector<CT*> &vec, FT CT::*field, FT value)
     return idx < 0 ? NULL : vec[idx];
 }
 
+/*
+ * Hash table from id to position in a vector of objects sorted by id,
+ * such as world->items.all. Ids are mostly consecutive, so the low bits
+ * of the id are the hash.
+ *
+ * The table is built lazily and is never trusted blindly: a hit must
+ * point at an object with the right id, and a miss is confirmed by
+ * binary search. Once the vector has changed (size or last id differ),
+ * lookups count as stale and the table is rebuilt when enough of them
+ * have piled up to pay for it. Not thread-safe.
+ */
+template <typename CT>
+class IdIndex
+{
+public:
+    CT *find(const std::vector<CT*> &vec, int32_t id)
+    {
+        if (CT *obj = probe(vec, id))
+            return obj;
+
+        CT *obj = binsearch_in_vector(vec, &CT::id, id);
+        if ((obj || !isCurrent(vec)) && ++stale_lookups >= rebuildThreshold(vec))
+            rebuild(vec);
+        return obj;
+    }
+
+    // Appends the object for each id to out, or NULL if it does not exist.
+    void resolve(const std::vector<CT*> &vec, const std::vector<int32_t> &ids, std::vector<CT*> &out)
+    {
+        // a batch big enough to pay for the rebuild gets it up front
+        if (!isCurrent(vec) && stale_lookups + ids.size() >= rebuildThreshold(vec))
+            rebuild(vec);
+        out.reserve(out.size() + ids.size());
+        for (int32_t id : ids)
+            out.push_back(find(vec, id));
+    }
+
+    void clear()
+    {
+        slots.clear();
+        built_size = 0;
+        built_last = -1;
+        stale_lookups = 0;
+    }
+
+private:
+    struct Slot { int32_t id; uint32_t index; }; // id -1 marks an empty slot
+
+    std::vector<Slot> slots;
+    size_t built_size = 0;
+    int32_t built_last = -1;
+    size_t stale_lookups = 0;
+
+    static size_t rebuildThreshold(const std::vector<CT*> &vec)
+    {
+        return std::max<size_t>(32, vec.size() / 16);
+    }
+
+    bool isCurrent(const std::vector<CT*> &vec) const
+    {
+        return !slots.empty() && vec.size() == built_size &&
+            (vec.empty() ? built_last == -1 : vec.back()->id == built_last);
+    }
+
+    void rebuild(const std::vector<CT*> &vec)
+    {
+        size_t capacity = 16;
+        while (capacity < vec.size() * 2)
+            capacity <<= 1;
+        slots.assign(capacity, Slot{ -1, 0 });
+
+        const size_t mask = capacity - 1;
+        for (size_t i = 0; i < vec.size(); i++)
+        {
+            size_t s = size_t(uint32_t(vec[i]->id)) & mask;
+            while (slots[s].id != -1)
+                s = (s + 1) & mask;
+            slots[s] = Slot{ vec[i]->id, uint32_t(i) };
+        }
+
+        built_size = vec.size();
+        built_last = vec.empty() ? -1 : vec.back()->id;
+        stale_lookups = 0;
+    }
+
+    CT *probe(const std::vector<CT*> &vec, int32_t id) const
+    {
+        if (slots.empty() || id < 0)
+            return NULL;
+
+        const size_t mask = slots.size() - 1;
+        for (size_t s = size_t(uint32_t(id)) & mask; slots[s].id != -1; s = (s + 1) & mask)
+        {
+            if (slots[s].id != id)
+                continue;
+            size_t idx = slots[s].index;
+            return (idx < vec.size() && vec[idx]->id == id) ? vec[idx] : NULL;
+        }
+        return NULL;
+    }
+};
+
 /*
  * List
  */
@@ -225,6 +225,13 @@ namespace DFHack
         void index_lua(DFLibrary *lib);
         void reset_lua();
 
+        // load() is split in two so PluginManager::loadAll can open libraries
+        // concurrently. open() maps and validates the library and touches no
+        // shared state; init() runs plugin_init and must be called serially,
+        // with the core suspended.
+        bool open(color_ostream &out);
+        bool init(color_ostream &out);
+
         bool *plugin_is_enabled;
         std::vector<std::string>* plugin_globals;
         command_result (*plugin_init)(color_ostream &, std::vector <PluginCommand> &);
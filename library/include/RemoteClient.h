@@ -44,7 +44,8 @@ namespace  DFHack
         RPC_REPLY_RESULT = -1,
         RPC_REPLY_FAIL = -2,
         RPC_REPLY_TEXT = -3,
-        RPC_REQUEST_QUIT = -4
+        RPC_REQUEST_QUIT = -4,
+        RPC_REQUEST_BATCH = -5
     };
 
     struct RPCHandshakeHeader {
@@ -57,6 +58,7 @@ namespace  DFHack
 
     struct RPCMessageHeader {
         static const int MAX_MESSAGE_SIZE = 64*1048576;
+        static const int MAX_BATCH_SIZE = 1024;
 
         int16_t id;
         int32_t size;
@@ -68,7 +70,8 @@ namespace  DFHack
      *
      *   Client initiates connection by sending the handshake
      *   request header. The server responds with the response
-     *   magic. Currently both versions must be 1.
+     *   magic. The server answers with the lower of the client's
+     *   version and its own; version 1 servers always answer 1.
      *
      * 2. Interaction
      *
@@ -92,6 +95,26 @@ namespace  DFHack
      *   of the function if it succeeded, or RPC_REPLY_FAIL with the
      *   error code if it did not.
      *
+     *   In protocol version 2, every call message and every
+     *   RPC_REPLY_RESULT or RPC_REPLY_FAIL message carries a 4-byte
+     *   request id right after the header (not counted in size).
+     *   The server echoes the id of the call it is answering, so the
+     *   client may send several calls before reading the replies.
+     *   Replies always come back in the order the calls were sent.
+     *
+     *   Version 2 also adds RPC_REQUEST_BATCH: a header whose size
+     *   field holds the number of call messages that immediately
+     *   follow it (at most MAX_BATCH_SIZE, with payloads adding up
+     *   to at most MAX_MESSAGE_SIZE). The server reads the whole
+     *   batch, then runs the calls in order, sharing one CoreSuspender
+     *   between consecutive calls that need it. Replies are sent in
+     *   order once the core is resumed.
+     *
+     *   Pipelining and batching only save round trips and suspends.
+     *   The server still reads and runs the calls of a connection one
+     *   at a time, and there is no separate path that runs read-only
+     *   calls concurrently.
+     *
      * 3. Disconnect
      *
      *   The client terminates the connection by sending an
@@ -156,6 +179,7 @@ namespace  DFHack
 
         inline color_ostream &default_ostream();
         command_result execute(color_ostream &out, const message_type *input, message_type *output);
+        command_result read_reply(color_ostream &out, message_type *output, int32_t request_id);
 
         std::string name, plugin;
         RemoteClient *p_client;
@@ -212,6 +236,22 @@ namespace  DFHack
         }
     };
 
+    // One entry of a RemoteClient::call_batch request.
+    struct RemoteCall {
+        RemoteFunctionBase *function;
+        const RPCFunctionBase::message_type *input;
+        RPCFunctionBase::message_type *output;
+
+        command_result result = CR_NOT_IMPLEMENTED;
+        int32_t request_id = -1;
+
+        RemoteCall(RemoteFunctionBase *function,
+                   const RPCFunctionBase::message_type *input,
+                   RPCFunctionBase::message_type *output)
+            : function(function), input(input), output(output)
+        {}
+    };
+
     class DFHACK_EXPORT RemoteClient
     {
         friend class RemoteFunctionBase;
@@ -242,8 +282,22 @@ namespace  DFHack
         int suspend_game();
         int resume_game();
 
+        // True if the server understands request ids and batches.
+        bool supports_batch() const { return protocol_version >= 2; }
+
+        // Sends all calls up front and runs them on the server under a
+        // single suspend, then fills in each output and result. Falls back
+        // to one call at a time on servers that speak protocol version 1.
+        // Returns CR_LINK_FAILURE on I/O errors, otherwise CR_OK.
+        command_result call_batch(color_ostream &out, std::vector<RemoteCall> &calls);
+        command_result call_batch(std::vector<RemoteCall> &calls) {
+            return call_batch(default_output(), calls);
+        }
+
     private:
         bool active, delete_output;
+        int protocol_version;
+        int32_t next_request_id;
         CActiveSocket *socket;
         color_ostream *p_default_output;
 
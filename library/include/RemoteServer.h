@@ -29,6 +29,7 @@ distribution.
 #include "Core.h"
 
 #include <future>
+#include <memory>
 
 class CPassiveSocket;
 class CActiveSocket;
@@ -224,9 +225,23 @@ namespace  DFHack
 
         public:
             connection_ostream(ServerConnection *owner) : owner(owner) {}
+
+            // while set, flushing keeps the text buffered for appendText
+            bool deferred = false;
+            // moves buffered text into buf as an RPC_REPLY_TEXT message
+            void appendText(std::string &buf);
+        };
+
+        // A call read off the socket, waiting to be executed
+        struct PendingCall {
+            int16_t id = 0;
+            int32_t request_id = 0;
+            int32_t size = 0;
+            std::unique_ptr<uint8_t[]> data;
         };
 
         bool in_error;
+        int protocol_version;
         CActiveSocket *socket;
         connection_ostream stream;
 
@@ -236,6 +251,15 @@ namespace  DFHack
         std::map<std::string, RPCService*> plugin_services;
 
         void threadFn();
+        bool readCall(color_ostream &out, const RPCMessageHeader &header, PendingCall &call);
+        command_result executeCall(PendingCall &call, ServerFunctionBase *&fn,
+                                   ::google::protobuf::MessageLite *&reply);
+        int checkReplySize(ServerFunctionBase *fn, ::google::protobuf::MessageLite *reply,
+                           command_result &res);
+        void finishCall(ServerFunctionBase *fn, int in_size, int out_size);
+        bool runCall(color_ostream &out, PendingCall &call);
+        bool runBatch(color_ostream &out, std::vector<PendingCall> &batch);
+        bool needsSuspend(const PendingCall &call);
         ServerConnection(CActiveSocket* socket);
         ~ServerConnection();
 
@@ -123,6 +123,11 @@ DFHACK_EXPORT std::string getName(df::building* building);
  */
 DFHACK_EXPORT df::building *findAtTile(df::coord pos);
 
+/**
+ * Look up many buildings by id, appending NULL for missing ones.
+ */
+DFHACK_EXPORT void findBuildingsByID(const std::vector<int32_t> &ids, std::vector<df::building*> &buildings);
+
 /**
  * Find civzones located at the specified tile.
  */
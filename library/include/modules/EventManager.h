@@ -9,8 +9,11 @@
 
 #include "df/unit_inventory_item.h"
 
+#include <type_traits>
+
 namespace df {
     struct construction;
+    struct job;
     struct unit;
     struct unit_wound;
 }
@@ -123,6 +126,65 @@ namespace DFHack {
         DFHACK_EXPORT int32_t registerTick(EventHandler handler, int32_t when, bool absolute=false);
         DFHACK_EXPORT void unregister(EventType::EventType e, EventHandler handler);
         DFHACK_EXPORT void unregisterAll(Plugin* plugin);
+
+        // The argument type each event hands to its listeners. Typed listeners
+        // receive this directly instead of a void* they have to cast back.
+        template<EventType::EventType E> struct EventPayload;
+#define EVENT_PAYLOAD(event, payload_type) \
+        template<> struct EventPayload<EventType::event> { typedef payload_type type; };
+        EVENT_PAYLOAD(TICK, int32_t)                        // current tick
+        EVENT_PAYLOAD(JOB_INITIATED, df::job*)
+        EVENT_PAYLOAD(JOB_STARTED, df::job*)
+        EVENT_PAYLOAD(JOB_COMPLETED, df::job*)              // copy of the job; freed after dispatch
+        EVENT_PAYLOAD(UNIT_NEW_ACTIVE, int32_t)             // unit id
+        EVENT_PAYLOAD(UNIT_DEATH, int32_t)                  // unit id
+        EVENT_PAYLOAD(ITEM_CREATED, int32_t)                // item id
+        EVENT_PAYLOAD(BUILDING, int32_t)                    // building id
+        EVENT_PAYLOAD(CONSTRUCTION, df::construction*)
+        EVENT_PAYLOAD(SYNDROME, SyndromeData*)
+        EVENT_PAYLOAD(INVASION, int32_t)                    // invasion id
+        EVENT_PAYLOAD(INVENTORY_CHANGE, InventoryChangeData*)
+        EVENT_PAYLOAD(REPORT, int32_t)                      // report id
+        EVENT_PAYLOAD(UNIT_ATTACK, UnitAttackData*)
+        EVENT_PAYLOAD(UNLOAD, void*)                        // always null
+        EVENT_PAYLOAD(INTERACTION, InteractionData*)
+#undef EVENT_PAYLOAD
+
+        // Payloads passed by pointer (and everything they point to) are only
+        // valid for the duration of the call.
+        template<EventType::EventType E>
+        using typed_callback_t = void (*)(color_ostream&, typename EventPayload<E>::type);
+
+        namespace detail {
+            template<EventType::EventType E, typed_callback_t<E> Handler>
+            void typedTrampoline(color_ostream &out, void *ptr) {
+                typedef typename EventPayload<E>::type payload_t;
+                if constexpr (std::is_pointer_v<payload_t>)
+                    Handler(out, static_cast<payload_t>(ptr));
+                else
+                    Handler(out, static_cast<payload_t>(intptr_t(ptr)));
+            }
+        }
+
+        // Wraps a typed callback in an EventHandler. The payload type is checked
+        // at compile time and the same callback always yields an equal handler,
+        // so the result can be passed to unregister() as well.
+        template<EventType::EventType E, typed_callback_t<E> Handler>
+        EventHandler makeHandler(Plugin* plugin, int32_t freq) {
+            return EventHandler(plugin, detail::typedTrampoline<E, Handler>, freq);
+        }
+
+        // e.g. registerListener<EventType::JOB_COMPLETED, onJobCompleted>(plugin_self, 0);
+        // use registerTick(makeHandler<EventType::TICK, callback>(...), when) for ticks.
+        template<EventType::EventType E, typed_callback_t<E> Handler>
+        void registerListener(Plugin* plugin, int32_t freq) {
+            static_assert(E != EventType::TICK, "use registerTick for TICK events");
+            registerListener(E, makeHandler<E, Handler>(plugin, freq));
+        }
+        template<EventType::EventType E, typed_callback_t<E> Handler>
+        void unregister(Plugin* plugin, int32_t freq) {
+            unregister(E, makeHandler<E, Handler>(plugin, freq));
+        }
         void manageEvents(color_ostream& out);
         void onStateChange(color_ostream& out, state_change_event event);
     }
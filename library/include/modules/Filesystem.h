@@ -48,6 +48,7 @@ SOFTWARE.
 #pragma once
 #include "Export.h"
 #include <map>
+#include <string>
 #include <vector>
 
 #ifndef _WIN32
@@ -168,5 +169,29 @@ namespace DFHack {
         // paths returned in files
         DFHACK_EXPORT int listdir_recursive (std::string dir, std::map<std::string, bool> &files,
             int depth = 10, bool include_prefix = true);
+
+        // Read-only view of a whole file mapped into memory. The mapping is
+        // released when the object goes out of scope.
+        class DFHACK_EXPORT MappedFile {
+        public:
+            explicit MappedFile (const std::string &path);
+            ~MappedFile ();
+            MappedFile (const MappedFile &) = delete;
+            MappedFile &operator= (const MappedFile &) = delete;
+
+            // true if the file exists and could be mapped (empty files map to no data)
+            bool isOpen () const { return opened; }
+            const uint8_t *data () const { return view; }
+            size_t size () const { return length; }
+
+        private:
+            const uint8_t *view = nullptr;
+            size_t length = 0;
+            bool opened = false;
+#ifdef _WIN32
+            HANDLE file = INVALID_HANDLE_VALUE;
+            HANDLE mapping = NULL;
+#endif
+        };
     }
 }
@@ -35,6 +35,9 @@ distribution.
 
 #include "df/announcement_type.h"
 #include "df/report_zoom_type.h"
+#include "df/tile_designation.h"
+#include "df/tile_occupancy.h"
+#include "df/tiletype.h"
 #include "df/unit_report_type.h"
 
 namespace df {
@@ -43,6 +46,7 @@ namespace df {
     struct building_stockpilest;
     struct job;
     struct item;
+    struct map_block;
     struct markup_text_boxst;
     struct plant;
     struct report;
@@ -72,6 +76,7 @@ namespace DFHack
         DFHACK_EXPORT std::vector<std::string> getFocusStrings(df::viewscreen *top);
         DFHACK_EXPORT bool matchFocusString(std::string focus_string, df::viewscreen *top = NULL);
         void clearFocusStringCache();
+        void clearViewportSnapshot();
 
         // Full-screen item details view
         DFHACK_EXPORT bool item_details_hotkey(df::viewscreen *top);
@@ -183,6 +188,40 @@ namespace DFHack
 
         DFHACK_EXPORT DwarfmodeDims getDwarfmodeViewDims();
 
+        struct ViewportTile {
+            df::map_block *block = NULL; // NULL if the tile is outside the map
+            df::tiletype tiletype = df::tiletype::Void;
+            df::tile_designation designation;
+            df::tile_occupancy occupancy;
+
+            bool isValid() const { return block != NULL; }
+            bool isVisible() const { return block && !designation.bits.hidden; }
+        };
+
+        // A copy of the map tiles shown in the dwarfmode viewport, for overlays
+        // that paint every visible map tile every frame. It is filled a block
+        // at a time the first time it is requested after each core update (or
+        // after the view moves), and then shared by every caller in that frame.
+        struct DFHACK_EXPORT ViewportSnapshot {
+            int x1 = 0, y1 = 0; // screen position of the top left map tile
+            int width = 0, height = 0;
+            df::coord origin; // map position of the top left map tile
+            std::vector<ViewportTile> tiles; // row-major, width * height
+
+            // x and y are screen coordinates; NULL if outside the viewport
+            const ViewportTile *get(int x, int y) const {
+                x -= x1; y -= y1;
+                if (x < 0 || y < 0 || x >= width || y >= height)
+                    return NULL;
+                return &tiles[x + y * width];
+            }
+            df::coord getMapPos(int x, int y) const {
+                return df::coord(origin.x + x - x1, origin.y + y - y1, origin.z);
+            }
+        };
+
+        DFHACK_EXPORT const ViewportSnapshot &getViewportSnapshot();
+
         DFHACK_EXPORT void resetDwarfmodeView(bool pause = false);
         DFHACK_EXPORT bool revealInDwarfmodeMap(int32_t x, int32_t y, int32_t z, bool center = false, bool highlight = false);
         DFHACK_EXPORT inline bool revealInDwarfmodeMap(df::coord pos, bool center = false, bool highlight = false) { return revealInDwarfmodeMap(pos.x, pos.y, pos.z, center, highlight); };
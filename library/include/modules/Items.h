@@ -40,6 +40,9 @@ distribution.
 #include "df/specific_ref.h"
 #include "df/unit_inventory_item.h"
 
+#include <functional>
+#include <vector>
+
 namespace df {
     struct body_part_raw;
     struct building_actual;
@@ -117,8 +120,13 @@ DFHACK_EXPORT bool isCasteMaterial(df::item_type itype);
 DFHACK_EXPORT int getSubtypeCount(df::item_type itype);
 DFHACK_EXPORT df::itemdef *getSubtypeDef(df::item_type itype, int subtype);
 
-/// Look for a particular item by ID
+/// Look for a particular item by ID. This may rebuild the shared id index,
+/// which is not locked, so it must only be called with the core suspended.
 DFHACK_EXPORT df::item * findItemByID(int32_t id);
+/// Look up many items by ID, appending NULL for missing ones. Faster than
+/// df::item::find in a loop once the id table is built. Also needs the core
+/// suspended.
+DFHACK_EXPORT void findItemsByID(const std::vector<int32_t> &ids, std::vector<df::item*> &items);
 
 /// Retrieve refs
 DFHACK_EXPORT df::general_ref *getGeneralRef(df::item *item, df::general_ref_type type);
@@ -145,6 +153,13 @@ DFHACK_EXPORT df::unit *getHolderUnit(df::item *item);
 /// Returns the true position of the item.
 DFHACK_EXPORT df::coord getPosition(df::item *item);
 
+/// Items lying loose on the ground, found through the item lists of the map blocks.
+/// Distances count max(|dx|, |dy|) + |dz|; the nearest items come first.
+DFHACK_EXPORT void getItemsInBox(std::vector<df::item*> &items, df::coord a, df::coord b);
+DFHACK_EXPORT void getItemsInRadius(std::vector<df::item*> &items, df::coord center, int radius);
+DFHACK_EXPORT void getNearestItems(std::vector<df::item*> &items, df::coord center, size_t count,
+    std::function<bool(df::item*)> filter = nullptr);
+
 /// Returns the title of a codex or "tool", either as the codex title or as the title of the
 /// first page or writing it has that has a non blank title. An empty string is returned if
 /// no title is found (which is the case for everything that isn't a "book").
@@ -34,8 +34,13 @@ distribution.
 #include "df/tile_designation.h"
 #include "df/tile_occupancy.h"
 
+#include <algorithm>
+#include <atomic>
 #include <bitset>
 #include <cstring>
+#include <exception>
+#include <thread>
+#include <vector>
 #include <stdint.h>
 
 namespace df {
@@ -421,7 +426,13 @@ class DFHACK_EXPORT MapCache
     }
 
     /// get the map block at a *block* coord. Block coord = tile coord / 16
-    Block *BlockAt(DFCoord blockcoord);
+    Block *BlockAt(DFCoord blockcoord)
+    {
+        // consecutive tile accesses usually hit the same block
+        if (last_block && blockcoord == last_bcoord)
+            return last_block;
+        return lookupBlock(blockcoord);
+    }
     /// get the map block at a tile coord.
     Block *BlockAtTile(DFCoord coord) {
         return BlockAt(df::coord(coord.x>>4,coord.y>>4,coord.z));
@@ -436,6 +447,23 @@ class DFHACK_EXPORT MapCache
     /// delete the block from memory
     void discardBlock(Block *block);
 
+    /// call fn(Block *) for every valid block with z in [z_begin, z_end),
+    /// in z/y/x order. Whole-map scans should use this together with the
+    /// Block accessors instead of the per-tile MapCache accessors.
+    template<typename Fn>
+    void forEachBlock(Fn &&fn, uint32_t z_begin = 0, uint32_t z_end = UINT32_MAX)
+    {
+        z_end = std::min(z_end, z_max);
+        for (uint32_t z = z_begin; z < z_end; z++)
+            for (uint32_t y = 0; y < y_bmax; y++)
+                for (uint32_t x = 0; x < x_bmax; x++)
+                {
+                    Block *b = lookupBlock(DFCoord(x, y, z));
+                    if (b && b->is_valid())
+                        fn(b);
+                }
+    }
+
     df::tiletype baseTiletypeAt (DFCoord tilecoord)
     {
         Block *b = BlockAtTile(tilecoord);
@@ -583,12 +611,13 @@ class DFHACK_EXPORT MapCache
 
     void trash()
     {
-        std::map<DFCoord, Block *>::iterator p;
-        for(p = blocks.begin(); p != blocks.end(); p++)
+        for (auto &level : block_index)
         {
-            delete p->second;
+            for (Block *b : level)
+                delete b;
+            level.clear();
         }
-        blocks.clear();
+        last_block = NULL;
     }
 
     uint32_t maxBlockX() { return x_bmax; }
@@ -608,6 +637,8 @@ private:
 
     static const BiomeInfo biome_stub;
 
+    Block *lookupBlock(DFCoord blockcoord);
+
     bool valid;
     bool validgeo;
     uint32_t x_bmax;
@@ -617,6 +648,68 @@ private:
     uint32_t z_max;
     std::vector<BiomeInfo> biomes;
     std::map<df::coord2d, df::world_region_details*> region_details;
-    std::map<DFCoord, Block *> blocks;
+    // dense x/y block index per z-level; a level is allocated on first use
+    std::vector<std::vector<Block *>> block_index;
+    Block *last_block;
+    DFCoord last_bcoord;
 };
+
+/**
+ * Runs kernel(Block *, Accum &) over every valid map block on a pool of
+ * worker threads and returns the merged accumulator.
+ *
+ * The map is split into z-levels that workers pick up one at a time. Each
+ * worker has its own MapCache and its own Accum, and drops its cached blocks
+ * after every z-level, so memory use does not grow with map size. When all
+ * workers are done, the per-worker accumulators are combined with
+ * merge(Accum &into, const Accum &from) in worker order.
+ *
+ * The caller must hold a CoreSuspender for the whole call. The kernel may
+ * only read game data and must not touch state shared between workers.
+ * num_threads = 0 means one worker per hardware thread.
+ */
+template<typename Accum, typename Kernel, typename Merge>
+Accum parallelScanBlocks(Kernel &&kernel, Merge &&merge, unsigned num_threads = 0)
+{
+    uint32_t x_max = 0, y_max = 0, z_max = 0;
+    Maps::getSize(x_max, y_max, z_max);
+
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::max(1u, std::min<unsigned>(num_threads, z_max));
+
+    std::vector<Accum> accums(num_threads);
+    std::vector<std::exception_ptr> errors(num_threads);
+    std::atomic<uint32_t> next_z(0);
+
+    auto worker = [&](unsigned idx) {
+        try {
+            MapCache map;
+            Accum &accum = accums[idx];
+            for (uint32_t z = next_z++; z < z_max; z = next_z++)
+            {
+                map.forEachBlock([&](Block *b) { kernel(b, accum); }, z, z + 1);
+                map.trash();
+            }
+        } catch (...) {
+            errors[idx] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (unsigned i = 1; i < num_threads; i++)
+        threads.emplace_back(worker, i);
+    worker(0);
+    for (auto &thread : threads)
+        thread.join();
+
+    for (auto &error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    for (unsigned i = 1; i < num_threads; i++)
+        merge(accums[0], accums[i]);
+    return std::move(accums[0]);
+}
 }
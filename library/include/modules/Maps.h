@@ -40,9 +40,20 @@ distribution.
 #include "df/block_flags.h"
 #include "df/feature_type.h"
 #include "df/flow_type.h"
+#include "df/map_block.h"
+#include "df/tile_bitmask.h"
+#include "df/tile_designation.h"
 #include "df/tile_dig_designation.h"
+#include "df/tile_occupancy.h"
 #include "df/tiletype.h"
 
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
 namespace df {
     struct block_square_event;
     struct block_square_event_designation_priorityst;
@@ -352,6 +363,477 @@ namespace DFHack
         inline df::tile_designation *getTileDesignation(df::coord pos) { return getTileDesignation(pos.x, pos.y, pos.z); }
         inline df::tile_occupancy *getTileOccupancy(df::coord pos) { return getTileOccupancy(pos.x, pos.y, pos.z); }
 
+        /**
+         * Block scanning kernels.
+         *
+         * getTileMask evaluates pred(tiletype, designation, occupancy) for all
+         * 256 tiles of a block and returns the tiles where it holds. There is
+         * no early exit and the inner loop walks the contiguous y axis of the
+         * block arrays, so simple predicates on designation and occupancy bits
+         * get vectorized by the compiler. Combine masks with &=, |= and -=.
+         */
+        template<typename Pred>
+        inline df::tile_bitmask getTileMask(const df::map_block *block, Pred pred)
+        {
+            uint16_t rows[16] = {};
+            for (int x = 0; x < 16; x++)
+                for (int y = 0; y < 16; y++)
+                    rows[y] |= uint16_t(pred(block->tiletype[x][y], block->designation[x][y],
+                                             block->occupancy[x][y]) ? 1 : 0) << x;
+            df::tile_bitmask mask;
+            for (int y = 0; y < 16; y++)
+                mask.bits[y] = rows[y];
+            return mask;
+        }
+
+        inline int countTiles(const df::tile_bitmask &mask)
+        {
+            int count = 0;
+            for (int y = 0; y < 16; y++)
+                count += std::popcount(mask.bits[y]);
+            return count;
+        }
+
+        inline bool allTiles(const df::tile_bitmask &mask)
+        {
+            for (int y = 0; y < 16; y++)
+                if (mask.bits[y] != 0xFFFF)
+                    return false;
+            return true;
+        }
+
+        template<typename Pred>
+        inline int countTiles(const df::map_block *block, Pred pred) { return countTiles(getTileMask(block, pred)); }
+        template<typename Pred>
+        inline bool anyTile(const df::map_block *block, Pred pred) {
+            auto mask = getTileMask(block, pred);
+            return mask.has_assignments();
+        }
+        template<typename Pred>
+        inline bool allTiles(const df::map_block *block, Pred pred) { return allTiles(getTileMask(block, pred)); }
+
+        // Calls fn(x, y) with the block-local coordinates of every tile set in mask.
+        template<typename Fn>
+        inline void forEachTile(const df::tile_bitmask &mask, Fn fn)
+        {
+            for (int y = 0; y < 16; y++)
+                for (uint16_t row = mask.bits[y]; row; row &= row - 1)
+                    fn(std::countr_zero(row), y);
+        }
+
+        /**
+         * Scanline flood fill over map tiles.
+         *
+         * run() visits the tiles connected to the seeds for which pred(pos)
+         * holds and calls action(pos) once for each of them. Tiles are taken
+         * in horizontal spans, and pred is evaluated at most once per tile,
+         * so it must not depend on what action does. The visited set is one
+         * bitmask per map block. If action returns bool, returning false
+         * stops the fill.
+         *
+         * Seeds are accepted without testing pred. addSeed() may also be
+         * called from pred or action, e.g. to follow a ramp to another level.
+         * expandFrom() tests the neighbours of a tile as if it had been
+         * accepted, without marking it visited or calling action for it, so
+         * a link can be followed again after its far end was rejected.
+         */
+        class DFHACK_EXPORT FloodFill
+        {
+        public:
+            enum Connectivity {
+                ORTHOGONAL,     // 4 neighbours on the same z-level
+                DIAGONAL,       // 8 neighbours on the same z-level
+                ORTHOGONAL_3D,  // ORTHOGONAL plus the tiles directly above and below
+                DIAGONAL_3D,    // DIAGONAL plus the tiles directly above and below
+            };
+
+            explicit FloodFill(Connectivity connectivity = ORTHOGONAL);
+
+            void addSeed(df::coord pos);
+            void expandFrom(df::coord pos);
+            // whether pos was a seed or has been tested by pred
+            bool isVisited(df::coord pos) const;
+            // number of tiles action has been called for
+            size_t count() const { return accepted; }
+
+            template<typename Pred, typename Action>
+            size_t run(Pred pred, Action action);
+
+        private:
+            struct Span { int16_t x1, x2, y, z; };
+
+            Connectivity connectivity;
+            int32_t x_max, y_max, z_max;
+            std::unordered_map<df::coord, df::tile_bitmask> visited; // key is block coordinate
+            df::coord last_block;
+            df::tile_bitmask *last_mask = nullptr;
+            std::vector<df::coord> seeds;
+            std::vector<df::coord> sources;
+            std::vector<Span> spans;
+            size_t accepted = 0;
+
+            df::tile_bitmask &blockMask(df::coord block);
+
+            // returns false if pos was already visited
+            bool markVisited(int32_t x, int32_t y, int32_t z)
+            {
+                df::coord block(x >> 4, y >> 4, z);
+                if (!last_mask || block != last_block)
+                {
+                    last_mask = &blockMask(block);
+                    last_block = block;
+                }
+                uint16_t &row = last_mask->bits[y & 15];
+                uint16_t bit = uint16_t(1) << (x & 15);
+                if (row & bit)
+                    return false;
+                row |= bit;
+                return true;
+            }
+        };
+
+        template<typename Pred, typename Action>
+        size_t FloodFill::run(Pred pred, Action action)
+        {
+            const bool diagonal = connectivity == DIAGONAL || connectivity == DIAGONAL_3D;
+            const bool vertical = connectivity == ORTHOGONAL_3D || connectivity == DIAGONAL_3D;
+
+            // grow an accepted tile into the widest span of accepted tiles on its row
+            auto push_span = [&](int32_t x, int32_t y, int32_t z) {
+                int32_t x1 = x, x2 = x;
+                while (x1 > 0 && markVisited(x1 - 1, y, z) && pred(df::coord(x1 - 1, y, z)))
+                    --x1;
+                while (x2 < x_max - 1 && markVisited(x2 + 1, y, z) && pred(df::coord(x2 + 1, y, z)))
+                    ++x2;
+                spans.push_back({ int16_t(x1), int16_t(x2), int16_t(y), int16_t(z) });
+                return x2;
+            };
+            // test the unvisited tiles of a row and push the spans that they start
+            auto scan_row = [&](int32_t x1, int32_t x2, int32_t y, int32_t z) {
+                if (y < 0 || y >= y_max || z < 0 || z >= z_max)
+                    return;
+                x1 = std::max(x1, 0);
+                x2 = std::min(x2, x_max - 1);
+                for (int32_t x = x1; x <= x2; x++)
+                    if (markVisited(x, y, z) && pred(df::coord(x, y, z)))
+                        x = push_span(x, y, z);
+            };
+
+            const int32_t d = diagonal ? 1 : 0;
+            while (!seeds.empty() || !sources.empty() || !spans.empty())
+            {
+                if (!seeds.empty())
+                {
+                    df::coord seed = seeds.back();
+                    seeds.pop_back();
+                    push_span(seed.x, seed.y, seed.z);
+                    continue;
+                }
+                if (!sources.empty())
+                {
+                    df::coord src = sources.back();
+                    sources.pop_back();
+                    scan_row(src.x - 1, src.x - 1, src.y, src.z);
+                    scan_row(src.x + 1, src.x + 1, src.y, src.z);
+                    scan_row(src.x - d, src.x + d, src.y - 1, src.z);
+                    scan_row(src.x - d, src.x + d, src.y + 1, src.z);
+                    if (vertical)
+                    {
+                        scan_row(src.x, src.x, src.y, src.z - 1);
+                        scan_row(src.x, src.x, src.y, src.z + 1);
+                    }
+                    continue;
+                }
+
+                Span span = spans.back();
+                spans.pop_back();
+                for (int32_t x = span.x1; x <= span.x2; x++)
+                {
+                    accepted++;
+                    if constexpr (std::is_same_v<std::invoke_result_t<Action &, df::coord>, bool>)
+                    {
+                        if (!action(df::coord(x, span.y, span.z)))
+                        {
+                            seeds.clear();
+                            sources.clear();
+                            spans.clear();
+                            return accepted;
+                        }
+                    }
+                    else
+                        action(df::coord(x, span.y, span.z));
+                }
+
+                scan_row(span.x1 - d, span.x2 + d, span.y - 1, span.z);
+                scan_row(span.x1 - d, span.x2 + d, span.y + 1, span.z);
+                if (vertical)
+                {
+                    scan_row(span.x1, span.x2, span.y, span.z - 1);
+                    scan_row(span.x1, span.x2, span.y, span.z + 1);
+                }
+            }
+            return accepted;
+        }
+
+        /**
+         * Values bucketed by the map block they are in, for box, radius and
+         * nearest-neighbour queries over the current map.
+         *
+         * Distances are max(|dx|, |dy|) + |dz|, as used to pick the closest
+         * item for a job. The grid does not remember where its values are;
+         * remove() and move() take the position the value was inserted at.
+         * Positions off the map are not stored.
+         */
+        template<typename T>
+        class SpatialGrid
+        {
+        public:
+            SpatialGrid() { reset(); }
+
+            // size the grid to the current map and drop all values
+            void reset()
+            {
+                uint32_t x_bmax = 0, y_bmax = 0, z_max = 0;
+                if (IsValid())
+                    getSize(x_bmax, y_bmax, z_max);
+                x_blocks = int32_t(x_bmax);
+                y_blocks = int32_t(y_bmax);
+                z_levels = int32_t(z_max);
+                cells.assign(size_t(x_blocks) * y_blocks * z_levels, Cell());
+                level_count.assign(z_levels, 0);
+                count = 0;
+            }
+
+            // drop all values, keeping the grid sized to the map
+            void clear()
+            {
+                const size_t level_cells = size_t(x_blocks) * y_blocks;
+                for (int32_t z = 0; z < z_levels && count; z++)
+                {
+                    if (!level_count[z])
+                        continue;
+                    for (size_t i = z * level_cells; i < (z + 1) * level_cells; i++)
+                        cells[i].clear();
+                    count -= level_count[z];
+                    level_count[z] = 0;
+                }
+            }
+
+            size_t size() const { return count; }
+
+            bool contains(df::coord pos) const
+            {
+                return pos.x >= 0 && pos.y >= 0 && pos.z >= 0 &&
+                    (pos.x >> 4) < x_blocks && (pos.y >> 4) < y_blocks && pos.z < z_levels;
+            }
+
+            static int distance(df::coord a, df::coord b)
+            {
+                return std::max(std::abs(a.x - b.x), std::abs(a.y - b.y)) + std::abs(a.z - b.z);
+            }
+
+            bool insert(const T &value, df::coord pos)
+            {
+                if (!contains(pos))
+                    return false;
+                cellAt(pos).push_back({ value, pos });
+                level_count[pos.z]++;
+                count++;
+                return true;
+            }
+
+            bool remove(const T &value, df::coord pos)
+            {
+                if (!contains(pos))
+                    return false;
+                Cell &cell = cellAt(pos);
+                for (auto &entry : cell)
+                {
+                    if (entry.pos == pos && entry.value == value)
+                    {
+                        entry = cell.back();
+                        cell.pop_back();
+                        level_count[pos.z]--;
+                        count--;
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void move(const T &value, df::coord from, df::coord to)
+            {
+                if (contains(from) && contains(to) && &cellAt(from) == &cellAt(to))
+                {
+                    for (auto &entry : cellAt(from))
+                    {
+                        if (entry.pos == from && entry.value == value)
+                        {
+                            entry.pos = to;
+                            return;
+                        }
+                    }
+                }
+                remove(value, from);
+                insert(value, to);
+            }
+
+            // calls fn(value, pos) for every value in the box; corners may be given in any order
+            template<typename Fn>
+            void forEachInBox(df::coord a, df::coord b, Fn fn) const
+            {
+                forEachInRange(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z),
+                               std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z), fn);
+            }
+
+            // calls fn(value, pos) for every value within radius of center
+            template<typename Fn>
+            void forEachInRadius(df::coord center, int radius, Fn fn) const
+            {
+                if (radius < 0)
+                    return;
+                forEachInRange(center.x - radius, center.y - radius, center.z - radius,
+                               center.x + radius, center.y + radius, center.z + radius,
+                    [&](const T &value, df::coord pos) {
+                        if (distance(center, pos) <= radius)
+                            fn(value, pos);
+                    });
+            }
+
+            /**
+             * Appends the up to k values nearest to center for which
+             * pred(value, pos) holds, nearest first, and returns how many
+             * were found. Ties go to the smaller value when T is ordered.
+             * Levels and block rings are searched outwards from center
+             * until they are further away than the k-th best match.
+             */
+            template<typename Pred>
+            size_t nearest(df::coord center, size_t k, std::vector<std::pair<T, df::coord>> &out, Pred pred) const
+            {
+                if (!k || !count || !contains(center))
+                    return 0;
+
+                std::vector<Match> best; // max-heap on closer(), so the worst match is in front
+                auto full_beyond = [&](int bound) {
+                    return best.size() == k && bound > best.front().dist;
+                };
+                auto visit = [&](const Cell &cell) {
+                    for (auto &entry : cell)
+                    {
+                        Match match{ distance(center, entry.pos), &entry };
+                        if (best.size() == k && !closer(match, best.front()))
+                            continue;
+                        if (!pred(entry.value, entry.pos))
+                            continue;
+                        if (best.size() == k)
+                        {
+                            std::pop_heap(best.begin(), best.end(), closer);
+                            best.pop_back();
+                        }
+                        best.push_back(match);
+                        std::push_heap(best.begin(), best.end(), closer);
+                    }
+                };
+
+                const int32_t cbx = center.x >> 4, cby = center.y >> 4;
+                const int32_t max_ring = std::max({ cbx, x_blocks - 1 - cbx, cby, y_blocks - 1 - cby });
+                for (int32_t dz = 0; dz < z_levels && !full_beyond(dz); dz++)
+                {
+                    for (int32_t z : { center.z - dz, center.z + dz })
+                    {
+                        if (z < 0 || z >= z_levels || !level_count[z])
+                            continue;
+                        // a block r rings out is at least (r-1)*16+1 tiles away
+                        for (int32_t r = 0; r <= max_ring && !full_beyond(dz + (r ? (r - 1) * 16 + 1 : 0)); r++)
+                            forEachRingCell(cbx, cby, z, r, visit);
+                        if (!dz)
+                            break;
+                    }
+                }
+
+                std::sort_heap(best.begin(), best.end(), closer);
+                for (auto &match : best)
+                    out.emplace_back(match.entry->value, match.entry->pos);
+                return best.size();
+            }
+
+            size_t nearest(df::coord center, size_t k, std::vector<std::pair<T, df::coord>> &out) const
+            {
+                return nearest(center, k, out, [](const T &, df::coord) { return true; });
+            }
+
+        private:
+            struct Entry { T value; df::coord pos; };
+            typedef std::vector<Entry> Cell;
+            struct Match { int dist; const Entry *entry; };
+
+            int32_t x_blocks = 0, y_blocks = 0, z_levels = 0;
+            std::vector<Cell> cells; // z-major, then y, then x
+            std::vector<size_t> level_count;
+            size_t count = 0;
+
+            static bool closer(const Match &a, const Match &b)
+            {
+                if (a.dist != b.dist)
+                    return a.dist < b.dist;
+                if constexpr (requires(const T &x, const T &y) { x < y; })
+                    return a.entry->value < b.entry->value;
+                else
+                    return false;
+            }
+
+            const Cell &cellAt(int32_t bx, int32_t by, int32_t z) const
+            {
+                return cells[(size_t(z) * y_blocks + by) * x_blocks + bx];
+            }
+            Cell &cellAt(df::coord pos)
+            {
+                return cells[(size_t(pos.z) * y_blocks + (pos.y >> 4)) * x_blocks + (pos.x >> 4)];
+            }
+
+            template<typename Fn>
+            void forEachInRange(int32_t x1, int32_t y1, int32_t z1,
+                                int32_t x2, int32_t y2, int32_t z2, Fn &&fn) const
+            {
+                x1 = std::max(x1, 0);
+                y1 = std::max(y1, 0);
+                z1 = std::max(z1, 0);
+                x2 = std::min(x2, x_blocks * 16 - 1);
+                y2 = std::min(y2, y_blocks * 16 - 1);
+                z2 = std::min(z2, z_levels - 1);
+                for (int32_t z = z1; z <= z2; z++)
+                {
+                    if (!level_count[z])
+                        continue;
+                    for (int32_t by = y1 >> 4; by <= y2 >> 4; by++)
+                        for (int32_t bx = x1 >> 4; bx <= x2 >> 4; bx++)
+                            for (auto &entry : cellAt(bx, by, z))
+                                if (entry.pos.x >= x1 && entry.pos.x <= x2 &&
+                                    entry.pos.y >= y1 && entry.pos.y <= y2)
+                                    fn(entry.value, entry.pos);
+                }
+            }
+
+            // visits the cells whose block offset from (cbx, cby) has a Chebyshev length of r
+            template<typename Fn>
+            void forEachRingCell(int32_t cbx, int32_t cby, int32_t z, int32_t r, Fn &&fn) const
+            {
+                for (int32_t by = std::max(cby - r, 0); by <= std::min(cby + r, y_blocks - 1); by++)
+                {
+                    if (by == cby - r || by == cby + r)
+                    {
+                        for (int32_t bx = std::max(cbx - r, 0); bx <= std::min(cbx + r, x_blocks - 1); bx++)
+                            fn(cellAt(bx, by, z));
+                        continue;
+                    }
+                    if (cbx - r >= 0)
+                        fn(cellAt(cbx - r, by, z));
+                    if (r && cbx + r < x_blocks)
+                        fn(cellAt(cbx + r, by, z));
+                }
+            }
+        };
+
         /**
          * Returns biome info about the specified world region.
          */
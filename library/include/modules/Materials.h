@@ -127,6 +127,10 @@ namespace DFHack
         bool findPlant(const std::string &token, const std::string &subtoken);
         bool findCreature(const std::string &token, const std::string &subtoken);
 
+        // Looks up a whole list of tokens, as find() would for each of them.
+        // out is resized to match tokens; returns the number of successful lookups.
+        static size_t findAll(std::vector<MaterialInfo> *out, const std::vector<std::string> &tokens);
+
         bool findProduct(df::material *material, const std::string &name);
         bool findProduct(const MaterialInfo &info, const std::string &name) {
             return findProduct(info.material, name);
@@ -83,7 +83,7 @@ namespace DFHack
         void set_bool(int i, bool value) {
             set_int(i, value ? 1 : 0);
         }
-        const std::string & get_str() {
+        const std::string & get_str() const {
             static const std::string empty;
             return isValid() ? val() : empty;
         }
@@ -41,6 +41,7 @@ distribution.
 #include "df/unit_action.h"
 #include "df/unit_action_type_group.h"
 
+#include <functional>
 #include <ranges>
 
 namespace df
@@ -156,9 +157,22 @@ DFHACK_EXPORT bool isGreatDanger(df::unit* unit);
 // found. Call repeatedly do get all units in a specified box (uses tile coords)
 DFHACK_EXPORT int32_t getNumUnits();
 DFHACK_EXPORT df::unit *getUnit(const int32_t index);
+// Look up many units by id, appending NULL for missing ones
+DFHACK_EXPORT void findUnitsByID(const std::vector<int32_t> &ids, std::vector<df::unit*> &units);
+// Units inside the box, in world->units.all order
 DFHACK_EXPORT bool getUnitsInBox(std::vector<df::unit*> &units,
     int16_t x1, int16_t y1, int16_t z1,
     int16_t x2, int16_t y2, int16_t z2);
+// Units at most radius tiles from center, counting max(|dx|, |dy|) + |dz|,
+// in world->units.all order
+DFHACK_EXPORT bool getUnitsInRadius(std::vector<df::unit*> &units, df::coord center, int radius);
+// Up to count units nearest to center that pass filter, nearest first
+DFHACK_EXPORT bool getNearestUnits(std::vector<df::unit*> &units, df::coord center, size_t count,
+    std::function<bool(df::unit*)> filter = nullptr);
+// The box, radius and nearest queries share a position index that is
+// refreshed once per update. Code that moves a unit other than through
+// teleport should call this before querying again in the same update.
+DFHACK_EXPORT void markUnitGridStale();
 DFHACK_EXPORT bool getUnitsByNobleRole(std::vector<df::unit *> &units, std::string noble);
 DFHACK_EXPORT df::unit *getUnitByNobleRole(std::string noble);
 
@@ -35,6 +35,7 @@ distribution.
 #include "Module.h"
 #include "modules/Persistence.h"
 #include <ostream>
+#include <vector>
 
 #include "DataDefs.h"
 
@@ -122,6 +123,23 @@ namespace DFHack
         // Create or delete block data associated with the given persistent data item
         DFHACK_EXPORT df::tile_bitmask *getPersistentTilemask(PersistentDataItem &item, df::map_block *block, bool create = false);
         DFHACK_EXPORT bool deletePersistentTilemask(PersistentDataItem &item, df::map_block *block);
+
+        // The tilemasks of all blocks overlapping a rectangle of one z-level,
+        // looked up once so that overlays can test tiles without going back
+        // to the block events for each one.
+        struct DFHACK_EXPORT PersistentTilemaskArea {
+            df::coord min_block; // block coordinates of the top left block
+            int width = 0, height = 0; // in blocks
+            std::vector<df::tile_bitmask*> masks; // NULL for blocks without a mask
+
+            // NULL if pos is outside the area or its block has no mask
+            df::tile_bitmask *get(const df::coord &pos) const;
+            bool getassignment(const df::coord &pos) const;
+        };
+
+        // Fills area with the masks for the map tiles between min and max (inclusive, on min.z)
+        DFHACK_EXPORT void getPersistentTilemasks(PersistentTilemaskArea *area, PersistentDataItem &item,
+                                                  const df::coord &min, const df::coord &max);
     }
 }
 #endif
@@ -1082,16 +1082,16 @@ function ZScreen:onIdle()
     end
 end
 
-local function record_zscreen_runtime(self, start_ms)
-    dfhack.internal.recordZScreenRuntime(self.focus_path or 'unknown', start_ms)
+local function record_zscreen_runtime(self, start_ns)
+    dfhack.internal.recordZScreenRuntime(self.focus_path or 'unknown', start_ns)
 end
 
 ---@param dc gui.Painter
 function ZScreen:render(dc)
     self:renderParent()
-    local now_ms = dfhack.getTickCount()
+    local now_ns = dfhack.internal.getPerfTimestamp()
     ZScreen.super.render(self, dc)
-    record_zscreen_runtime(self, now_ms)
+    record_zscreen_runtime(self, now_ns)
 end
 
 ---@return boolean
@@ -1101,7 +1101,7 @@ function ZScreen:hasFocus()
 end
 
 function ZScreen:onInput(keys)
-    local now_ms = dfhack.getTickCount()
+    local now_ns = dfhack.internal.getPerfTimestamp()
     local has_mouse = self:isMouseOver()
     if not self:hasFocus() then
         if has_mouse and
@@ -1110,7 +1110,7 @@ function ZScreen:onInput(keys)
                  keys.CONTEXT_SCROLL_PAGEUP or keys.CONTEXT_SCROLL_PAGEDOWN) then
             self:raise()
         else
-            record_zscreen_runtime(self, now_ms)
+            record_zscreen_runtime(self, now_ns)
             self:sendInputToParent(keys)
             return true
         end
@@ -1120,7 +1120,7 @@ function ZScreen:onInput(keys)
         -- noop
     elseif self.pass_mouse_clicks and keys._MOUSE_L and not has_mouse then
         self.defocused = self.defocusable
-        record_zscreen_runtime(self, now_ms)
+        record_zscreen_runtime(self, now_ns)
         self:sendInputToParent(keys)
         return true
     elseif keys.LEAVESCREEN or keys._MOUSE_R then
@@ -1144,12 +1144,12 @@ function ZScreen:onInput(keys)
             passit = require('gui.dwarfmode').getMapKey(keys)
         end
         if passit then
-            record_zscreen_runtime(self, now_ms)
+            record_zscreen_runtime(self, now_ns)
             self:sendInputToParent(keys)
             return true
         end
     end
-    record_zscreen_runtime(self, now_ms)
+    record_zscreen_runtime(self, now_ns)
     return true
 end
 
@@ -27,9 +27,9 @@ end
 function scheduleEvery(name, time, timeUnits, func)
     cancel(name)
     local function helper()
-        local now_ms = dfhack.getTickCount()
+        local now_ns = dfhack.internal.getPerfTimestamp()
         func()
-        dfhack.internal.recordRepeatRuntime(name, now_ms)
+        dfhack.internal.recordRepeatRuntime(name, now_ns)
 
         if repeating[name] then
             repeating[name] = dfhack.timeout(time, timeUnits, helper)
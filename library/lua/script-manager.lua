@@ -232,9 +232,43 @@ local function print_sorted_timers(in_timers, width, rel1_ms, desc1, rel2_ms, de
     print(format_relative_time(width, 'all subtimers', sum, rel1_ms, desc1, rel2_ms, desc2))
 end
 
+local function print_latencies(title, histograms, width)
+    local sorted = {}
+    for name,hist in pairs(histograms) do
+        table.insert(sorted, {name=name, hist=hist})
+    end
+    if #sorted == 0 then return end
+    table.sort(sorted, function(a, b) return a.hist.max_ms > b.hist.max_ms end)
+    print()
+    print()
+    print(title)
+    print(('-'):rep(#title))
+    print()
+    local fmt = '%' .. tostring(width) .. 's %10s %10s %10s %10s %10s'
+    print(fmt:format('', 'calls', 'p50 ms', 'p95 ms', 'p99 ms', 'max ms'))
+    fmt = '%' .. tostring(width) .. 's %10d %10.3f %10.3f %10.3f %10.3f'
+    for _, elem in ipairs(sorted) do
+        local hist = elem.hist
+        print(fmt:format(elem.name, hist.count, hist.p50_ms, hist.p95_ms, hist.p99_ms, hist.max_ms))
+    end
+end
+
+local function print_latency_details(histograms)
+    print_latencies('Update latency', histograms.summary, 25)
+    print_latencies('Event manager latency per event type', histograms.em_per_event, 25)
+    for k,v in pairs(histograms.em_per_plugin_per_event) do
+        print_latencies(('Event manager %s event latency per plugin'):format(k), v, 25)
+    end
+    print_latencies('Update latency per plugin', histograms.update_per_plugin, 25)
+    print_latencies('State change latency per plugin', histograms.state_change_per_plugin, 25)
+    print_latencies('Lua timer latency', histograms.update_lua_per_repeat, 45)
+    print_latencies('Overlay latency', histograms.overlay_per_widget, 45)
+    print_latencies('ZScreen latency', histograms.zscreen_per_focus, 45)
+end
+
 function print_timers()
     local summary, em_per_event, em_per_plugin_per_event, update_per_plugin, state_change_per_plugin,
-        update_lua_per_repeat, overlay_per_widget, zscreen_per_focus = dfhack.internal.getPerfCounters()
+        update_lua_per_repeat, overlay_per_widget, zscreen_per_focus, histograms = dfhack.internal.getPerfCounters()
 
     local elapsed = summary.elapsed_ms
     local total_update_time = summary.total_update_ms
@@ -338,6 +372,8 @@ function print_timers()
         print()
         print_sorted_timers(zscreen_per_focus, 45, total_zscreen_time, 'zscreen', elapsed, 'elapsed')
     end
+
+    print_latency_details(histograms)
 end
 
 return _ENV
@@ -38,6 +38,7 @@ distribution.
 #include "modules/Buildings.h"
 #include "modules/Maps.h"
 #include "modules/Job.h"
+#include "modules/Items.h"
 
 #include "df/building_axle_horizontalst.h"
 #include "df/building_bars_floorst.h"
@@ -405,6 +406,13 @@ bool Buildings::setOwner(df::building_civzonest *bld, df::unit *unit)
     return true;
 }
 
+static IdIndex<df::building> building_id_index;
+
+void Buildings::findBuildingsByID(const std::vector<int32_t> &ids, std::vector<df::building*> &buildings)
+{
+    building_id_index.resolve(world->buildings.all, ids, buildings);
+}
+
 df::building *Buildings::findAtTile(df::coord pos)
 {
     auto occ = Maps::getTileOccupancy(pos);
@@ -1676,8 +1684,8 @@ StockpileIterator& StockpileIterator::operator++() {
         }
 
         // If the current item isn't properly stored, move on to the next.
-        item = df::item::find(block->items[current]);
-        if (!item->flags.bits.on_ground) {
+        item = Items::findItemByID(block->items[current]);
+        if (!item || !item->flags.bits.on_ground) {
             continue;
         }
 
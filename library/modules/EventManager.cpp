@@ -40,6 +40,7 @@
 #include <algorithm>
 #include <cstring>
 #include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -67,11 +68,44 @@ static multimap<int32_t, EventHandler> tickQueue;
 static multimap<Plugin*, EventHandler> handlers[EventType::EVENT_MAX];
 static int32_t eventLastTick[EventType::EVENT_MAX];
 
+//flat copies of handlers[], rebuilt only when a listener is added or removed.
+//managers hold a reference to the current list while they dispatch, so
+//callbacks can register or unregister listeners without invalidating it.
+typedef vector<EventHandler> dispatch_list;
+static shared_ptr<const dispatch_list> dispatchLists[EventType::EVENT_MAX];
+//lowest requested frequency per event, cached alongside the dispatch list
+static int32_t dispatchFreq[EventType::EVENT_MAX];
+
 static const int32_t ticksPerYear = 403200;
 
+static void rebuildDispatch(EventType::EventType e) {
+    //tick handlers are called from tickQueue and the TICK manager runs every
+    //tick, so there is no list to keep for them
+    if (e == EventType::TICK) {
+        dispatchFreq[e] = 1;
+        return;
+    }
+    auto list = make_shared<dispatch_list>();
+    list->reserve(handlers[e].size());
+    int32_t freq = -100;
+    for (auto &[_,handle] : handlers[e]) {
+        list->push_back(handle);
+        if (handle.freq < freq || freq == -100)
+            freq = handle.freq;
+    }
+    dispatchLists[e] = std::move(list);
+    dispatchFreq[e] = freq;
+}
+
+static shared_ptr<const dispatch_list> getListeners(EventType::EventType e) {
+    static const shared_ptr<const dispatch_list> empty = make_shared<dispatch_list>();
+    return dispatchLists[e] ? dispatchLists[e] : empty;
+}
+
 void DFHack::EventManager::registerListener(EventType::EventType e, EventHandler handler) {
     DEBUG(log).print("registering handler %p from plugin %s for event %d\n", handler.eventHandler, !handler.plugin ? "<null>" : handler.plugin->getName().c_str(), e);
     handlers[e].insert(pair<Plugin*, EventHandler>(handler.plugin, handler));
+    rebuildDispatch(e);
 }
 
 int32_t DFHack::EventManager::registerTick(EventHandler handler, int32_t when, bool absolute) {
@@ -88,6 +122,7 @@ int32_t DFHack::EventManager::registerTick(EventHandler handler, int32_t when, b
     tickQueue.insert(pair<int32_t, EventHandler>(handler.freq, handler));
     DEBUG(log).print("registering handler %p from plugin %s for event TICK\n", handler.eventHandler, !handler.plugin ? "<null>" : handler.plugin->getName().c_str());
     handlers[EventType::TICK].insert(pair<Plugin*,EventHandler>(handler.plugin,handler));
+    rebuildDispatch(EventType::TICK);
     return when;
 }
 
@@ -117,6 +152,7 @@ void DFHack::EventManager::unregister(EventType::EventType e, EventHandler handl
         if ( e == EventType::TICK )
             removeFromTickQueue(handler);
     }
+    rebuildDispatch(e);
 }
 
 void DFHack::EventManager::unregisterAll(Plugin* plugin) {
@@ -127,8 +163,9 @@ void DFHack::EventManager::unregisterAll(Plugin* plugin) {
 
         removeFromTickQueue((*i).second);
     }
-    for (auto &handler : handlers) {
-        handler.erase(plugin);
+    for ( size_t e = 0; e < EventType::EVENT_MAX; e++ ) {
+        if ( handlers[e].erase(plugin) )
+            rebuildDispatch((EventType::EventType)e);
     }
 }
 
@@ -204,14 +241,29 @@ std::array<eventManager_t,EventType::EVENT_MAX> compileManagerArray() {
     return managers;
 }
 
-//job initiated
+//manageEvents pass counter, used to refresh shared per-pass state at most once
+static uint32_t eventPass = 0;
+
+//job initiated, job started, job completed
+//all three managers share one snapshot of world->jobs.list, keyed by job id
+namespace {
+    struct JobRecord {
+        df::job* job;             //live job; only valid during the pass it was seen in
+        df::job* snapshot;        //deep copy, only kept while there are JOB_COMPLETED listeners
+        int32_t completion_timer;
+        uint32_t flags;
+        uint64_t contents;        //hash of the rest of what the snapshot copies
+        bool has_worker;
+        uint32_t seen;            //last pass this job was found in the job list
+    };
+}
+static unordered_map<int32_t, JobRecord> jobSnapshot;
+static uint32_t jobSnapshotPass = 0;
+static int32_t jobSnapshotTick = -1;
 static int32_t lastJobId = -1;
-
-//job started
-static unordered_set<int32_t> startedJobs;
-
-//job completed
-static unordered_map<int32_t, df::job*> prevJobs;
+static vector<int32_t> pendingInitiatedJobs;
+static vector<int32_t> pendingStartedJobs;
+static vector<df::job*> pendingCompletedJobs;
 
 //active units
 static unordered_set<int32_t> activeUnits;
@@ -248,6 +300,18 @@ static int32_t nextInvasion;
 //equipment change
 //static unordered_map<int32_t, vector<df::unit_inventory_item> > equipmentLog;
 static unordered_map<int32_t, vector<InventoryItem>> equipmentLog;
+//per-pass payload arena; events hold indices into it until they are dispatched
+namespace {
+    struct PendingInventoryChange {
+        int32_t unitId;
+        int32_t item_old; //-1 if none
+        int32_t item_new; //-1 if none
+    };
+}
+static vector<InventoryItem> inventoryArena;
+static vector<PendingInventoryChange> inventoryPickups;
+static vector<PendingInventoryChange> inventoryDrops;
+static vector<PendingInventoryChange> inventoryChanges;
 
 //report
 static int32_t lastReport;
@@ -272,10 +336,179 @@ struct hash_pair {
 static void run_handler(color_ostream& out, EventType::EventType eventType, const EventHandler & handle, void * arg) {
     auto &core = Core::getInstance();
     auto &counters = core.perf_counters;
-    uint32_t start_ms = core.p->getTickCount();
+    uint64_t start_ns = PerfCounters::getTimestampNs();
     const char * plugin_name = !handle.plugin ? "<null>" : handle.plugin->getName().c_str();
     handle.eventHandler(out, arg);
-    counters.incCounter(counters.event_manager_event_per_plugin_ms[eventType][plugin_name], start_ms);
+    counters.incCounter(counters.event_manager_event_per_plugin_ms[eventType][plugin_name], start_ns);
+}
+
+static void clearJobSnapshot() {
+    for (auto &[_,record] : jobSnapshot) {
+        if (record.snapshot)
+            Job::deleteJobStruct(record.snapshot, true);
+    }
+    jobSnapshot.clear();
+    for (auto job : pendingCompletedJobs) {
+        Job::deleteJobStruct(job, true);
+    }
+    pendingCompletedJobs.clear();
+    pendingInitiatedJobs.clear();
+    pendingStartedJobs.clear();
+    jobSnapshotTick = -1;
+    lastJobId = -1;
+}
+
+// Hashes the job fields that JOB_COMPLETED handlers look at: where and what
+// the job is, and which items and refs it holds, so that swapping an item or
+// a ref for another one also counts as a change.
+static uint64_t hashJobContents(df::job* job) {
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&](uint64_t value) {
+        hash = (hash ^ value) * 1099511628211ULL;
+    };
+    mix(uint64_t(job->job_type));
+    mix(uint64_t(uint16_t(job->pos.x)) | uint64_t(uint16_t(job->pos.y)) << 16 | uint64_t(uint16_t(job->pos.z)) << 32);
+    mix(uint64_t(uint16_t(job->mat_type)) << 32 | uint32_t(job->mat_index));
+    mix(uint64_t(uint32_t(job->item_subtype)));
+    mix(job->items.size());
+    for (auto ref : job->items) {
+        mix(ref->item ? uint32_t(ref->item->id) : uint32_t(-1));
+        mix(uint64_t(uint32_t(ref->role)) << 32 | uint32_t(ref->job_item_idx));
+    }
+    mix(job->general_refs.size());
+    for (auto ref : job->general_refs)
+        mix(uint64_t(uint32_t(ref->getType())) << 32 | uint32_t(ref->getID()));
+    mix(job->specific_refs.size());
+    mix(job->job_items.elements.size());
+    return hash;
+}
+
+static void updateJobRecord(JobRecord &record, df::job* job, bool keep_snapshot) {
+    int32_t timer = job->completion_timer;
+    uint32_t flags = job->flags.whole;
+    bool changed = record.completion_timer != timer || record.flags != flags;
+
+    record.job = job;
+    record.completion_timer = timer;
+    record.flags = flags;
+
+    if (!keep_snapshot) {
+        if (record.snapshot) {
+            Job::deleteJobStruct(record.snapshot, true);
+            record.snapshot = nullptr;
+        }
+        return;
+    }
+    uint64_t contents = hashJobContents(job);
+    changed = changed || record.contents != contents;
+    record.contents = contents;
+    if (record.snapshot && !changed)
+        return;
+    if (record.snapshot)
+        Job::deleteJobStruct(record.snapshot, true);
+    record.snapshot = Job::cloneJobStruct(job, true);
+}
+
+// Walks world->jobs.list once per manageEvents pass and diffs it against the
+// previous snapshot. Deltas are queued for whichever of the job event managers
+// have listeners, so managers with different frequencies all see every change.
+// Deep copies of jobs are only refreshed when a job's timer, flags or content
+// hash changes.
+static void refreshJobSnapshot() {
+    if (jobSnapshotPass == eventPass)
+        return;
+    jobSnapshotPass = eventPass;
+
+    bool want_initiated = !handlers[EventType::JOB_INITIATED].empty();
+    bool want_started = !handlers[EventType::JOB_STARTED].empty();
+    bool want_completed = !handlers[EventType::JOB_COMPLETED].empty();
+
+    //drop deltas nobody is listening for anymore
+    if (!want_initiated)
+        pendingInitiatedJobs.clear();
+    if (!want_started)
+        pendingStartedJobs.clear();
+    if (!want_completed) {
+        for (auto job : pendingCompletedJobs) {
+            Job::deleteJobStruct(job, true);
+        }
+        pendingCompletedJobs.clear();
+    }
+
+    int32_t tick = df::global::world->frame_counter;
+    //the first pass after a map load only seeds the snapshot
+    bool seeding = lastJobId == -1;
+    //if a job vanished within a tick, it was cancelled by the user or a plugin: not completed
+    bool ticked = !seeding && tick > jobSnapshotTick;
+    jobSnapshotTick = tick;
+
+    size_t num_seen = 0;
+    for (df::job_list_link* link = &df::global::world->jobs.list; link != nullptr; link = link->next) {
+        df::job* job = link->item;
+        if (!job)
+            continue;
+        ++num_seen;
+        int32_t id = job->id;
+        bool has_worker = Job::getWorker(job) != nullptr;
+
+        auto it = jobSnapshot.find(id);
+        if (it == jobSnapshot.end()) {
+            JobRecord &record = jobSnapshot.emplace(id, JobRecord{}).first->second;
+            updateJobRecord(record, job, want_completed);
+            record.has_worker = has_worker;
+            record.seen = eventPass;
+            if (want_initiated && !seeding && id > lastJobId)
+                pendingInitiatedJobs.push_back(id);
+            if (want_started && has_worker)
+                pendingStartedJobs.push_back(id);
+            continue;
+        }
+
+        JobRecord &record = it->second;
+        record.seen = eventPass;
+        if (want_started && has_worker && !record.has_worker)
+            pendingStartedJobs.push_back(id);
+        record.has_worker = has_worker;
+
+        //could have just finished if it's a repeat job
+        //still false positive if cancelled at EXACTLY the right time, but experiments show this doesn't happen
+        if (want_completed && ticked && record.snapshot
+                && record.snapshot->flags.bits.repeat
+                && record.completion_timer == 0 && job->completion_timer == -1) {
+            pendingCompletedJobs.push_back(record.snapshot);
+            record.snapshot = nullptr;
+        }
+        updateJobRecord(record, job, want_completed);
+    }
+
+    if (df::global::job_next_id)
+        lastJobId = *df::global::job_next_id - 1;
+
+    //nothing can have disappeared if every known job was seen again
+    if (num_seen == jobSnapshot.size())
+        return;
+
+    for (auto it = jobSnapshot.begin(); it != jobSnapshot.end(); ) {
+        JobRecord &record = it->second;
+        if (record.seen == eventPass) {
+            ++it;
+            continue;
+        }
+        //recently finished or cancelled job
+        df::job* job0 = record.snapshot;
+        if (job0 && ticked && !job0->flags.bits.repeat && job0->completion_timer == 0)
+            pendingCompletedJobs.push_back(job0);
+        else if (job0)
+            Job::deleteJobStruct(job0, true);
+        it = jobSnapshot.erase(it);
+    }
+}
+
+static df::job* getSnapshotJob(int32_t id) {
+    auto it = jobSnapshot.find(id);
+    if (it == jobSnapshot.end() || it->second.seen != jobSnapshotPass)
+        return nullptr;
+    return it->second.job;
 }
 
 void DFHack::EventManager::onStateChange(color_ostream& out, state_change_event event) {
@@ -290,12 +523,7 @@ void DFHack::EventManager::onStateChange(color_ostream& out, state_change_event
         //out.print("Registered listeners.\n %d", __LINE__);
     }
     if ( event == DFHack::SC_MAP_UNLOADED ) {
-        lastJobId = -1;
-        startedJobs.clear();
-        for (auto &prevJob : prevJobs) {
-            Job::deleteJobStruct(prevJob.second, true);
-        }
-        prevJobs.clear();
+        clearJobSnapshot();
         tickQueue.clear();
         livingUnits.clear();
         buildings.clear();
@@ -308,8 +536,8 @@ void DFHack::EventManager::onStateChange(color_ostream& out, state_change_event
         lastReportUnitAttack = -1;
         gameLoaded = false;
 
-        multimap<Plugin*,EventHandler> copy(handlers[EventType::UNLOAD].begin(), handlers[EventType::UNLOAD].end());
-        for (auto &[_,handle] : copy) {
+        auto listeners = getListeners(EventType::UNLOAD);
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for map unloaded state change event\n");
             run_handler(out, EventType::UNLOAD, handle, nullptr);
         }
@@ -400,6 +628,7 @@ void DFHack::EventManager::manageEvents(color_ostream& out) {
 
     CoreSuspender suspender;
 
+    eventPass++;
     int32_t tick = df::global::world->frame_counter;
     TRACE(log,out).print("processing events at tick %d\n", tick);
 
@@ -408,21 +637,15 @@ void DFHack::EventManager::manageEvents(color_ostream& out) {
     for ( size_t a = 0; a < EventType::EVENT_MAX; a++ ) {
         if ( handlers[a].empty() )
             continue;
-        int32_t eventFrequency = -100;
-        if ( a != EventType::TICK )
-            for (auto &[_,handle] : handlers[a]) {
-                if (handle.freq < eventFrequency || eventFrequency == -100 )
-                    eventFrequency = handle.freq;
-            }
-        else eventFrequency = 1;
+        int32_t eventFrequency = dispatchFreq[a];
 
         if ( tick >= eventLastTick[a] && tick - eventLastTick[a] < eventFrequency )
             continue;
 
-        uint32_t start_ms = core.p->getTickCount();
+        uint64_t start_ns = PerfCounters::getTimestampNs();
         eventManager[a](out);
         eventLastTick[a] = tick;
-        counters.incCounter(counters.event_manager_event_total_ms[a], start_ms);
+        counters.incCounter(counters.event_manager_event_total_ms[a], start_ns);
     }
 }
 
@@ -434,7 +657,7 @@ static void manageTickEvent(color_ostream& out) {
     while ( !tickQueue.empty() ) {
         if ( tick < (*tickQueue.begin()).first )
             break;
-        EventHandler &handle = (*tickQueue.begin()).second;
+        EventHandler handle = (*tickQueue.begin()).second;
         tickQueue.erase(tickQueue.begin());
         DEBUG(log,out).print("calling handler for tick event\n");
         run_handler(out, EventType::TICK, handle, (void*)intptr_t(tick));
@@ -448,8 +671,8 @@ static void manageTickEvent(color_ostream& out) {
             a++;
             continue;
         }
-        a = handlers[EventType::TICK].erase(a);
         toRemove.erase(handle);
+        a = handlers[EventType::TICK].erase(a);
         if ( toRemove.empty() )
             break;
     }
@@ -460,63 +683,48 @@ static void manageJobInitiatedEvent(color_ostream& out) {
         return;
     if (!df::global::job_next_id)
         return;
-    if ( lastJobId == -1 ) {
-        lastJobId = *df::global::job_next_id - 1;
-        return;
-    }
 
-    if ( lastJobId+1 == *df::global::job_next_id ) {
+    refreshJobSnapshot();
+    if (pendingInitiatedJobs.empty())
         return; //no new jobs
-    }
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::JOB_INITIATED].begin(), handlers[EventType::JOB_INITIATED].end());
 
-    for ( df::job_list_link* link = &df::global::world->jobs.list; link != nullptr; link = link->next ) {
-        if ( link->item == nullptr )
+    auto listeners = getListeners(EventType::JOB_INITIATED);
+    vector<int32_t> initiated;
+    initiated.swap(pendingInitiatedJobs);
+    for (int32_t id : initiated) {
+        df::job* job = getSnapshotJob(id);
+        if (!job)
             continue;
-        if ( link->item->id <= lastJobId )
-            continue;
-        for (auto &[_,handle] : copy) {
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for job initiated event\n");
-            run_handler(out, EventType::JOB_INITIATED, handle, (void*)link->item);
+            run_handler(out, EventType::JOB_INITIATED, handle, (void*)job);
         }
     }
-
-    lastJobId = *df::global::job_next_id - 1;
 }
 
 static void manageJobStartedEvent(color_ostream& out) {
     if (!df::global::world)
         return;
 
-    // iterate event handler callbacks
-    multimap<Plugin*, EventHandler> copy(handlers[EventType::JOB_STARTED].begin(), handlers[EventType::JOB_STARTED].end());
-
-    unordered_set<int32_t> newStartedJobs;
+    refreshJobSnapshot();
+    if (pendingStartedJobs.empty())
+        return;
 
-    for (df::job_list_link* link = &df::global::world->jobs.list; link->next != nullptr; link = link->next) {
-        df::job* job = link->next->item;
+    // iterate event handler callbacks
+    auto listeners = getListeners(EventType::JOB_STARTED);
+    vector<int32_t> started;
+    started.swap(pendingStartedJobs);
+    for (int32_t id : started) {
+        df::job* job = getSnapshotJob(id);
         if (!job || !Job::getWorker(job))
             continue;
-
-        int32_t j_id = job->id;
-        newStartedJobs.emplace(j_id);
-        if (!startedJobs.count(j_id)) {
-            for (auto &[_,handle] : copy) {
-                DEBUG(log,out).print("calling handler for job started event\n");
-                run_handler(out, EventType::JOB_STARTED, handle, job);
-            }
+        for (auto &handle : *listeners) {
+            DEBUG(log,out).print("calling handler for job started event\n");
+            run_handler(out, EventType::JOB_STARTED, handle, job);
         }
     }
-
-    startedJobs = newStartedJobs;
 }
 
-//helper function for manageJobCompletedEvent
-//static int32_t getWorkerID(df::job* job) {
-//    auto ref = findRef(job->general_refs, general_ref_type::UNIT_WORKER);
-//    return ref ? ref->getID() : -1;
-//}
-
 /*
 TODO: consider checking item creation / experience gain just in case
 */
@@ -524,129 +732,19 @@ static void manageJobCompletedEvent(color_ostream& out) {
     if (!df::global::world)
         return;
 
-    int32_t tick0 = eventLastTick[EventType::JOB_COMPLETED];
-    int32_t tick1 = df::global::world->frame_counter;
-
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::JOB_COMPLETED].begin(), handlers[EventType::JOB_COMPLETED].end());
-    unordered_map<int32_t, df::job*> nowJobs;
-    for ( df::job_list_link* link = &df::global::world->jobs.list; link != nullptr; link = link->next ) {
-        if ( link->item == nullptr )
-            continue;
-        nowJobs.emplace(link->item->id, link->item);
-    }
-
-#if 0
-    //testing info on job initiation/completion
-    //newly allocated jobs
-    for ( auto j = nowJobs.begin(); j != nowJobs.end(); j++ ) {
-        if ( prevJobs.find((*j).first) != prevJobs.end() )
-            continue;
-
-        df::job& job1 = *(*j).second;
-        out.print("new job\n"
-            "  location         : 0x%X\n"
-            "  id               : %d\n"
-            "  type             : %d %s\n"
-            "  working          : %d\n"
-            "  completion_timer : %d\n"
-            "  workerID         : %d\n"
-            "  time             : %d -> %d\n"
-            "\n", job1.list_link->item, job1.id, job1.job_type, ENUM_ATTR(job_type, caption, job1.job_type), job1.flags.bits.working, job1.completion_timer, getWorkerID(&job1), tick0, tick1);
-    }
-    for ( auto i = prevJobs.begin(); i != prevJobs.end(); i++ ) {
-        df::job& job0 = *(*i).second;
-        auto j = nowJobs.find((*i).first);
-        if ( j == nowJobs.end() ) {
-            out.print("job deallocated\n"
-                "  location         : 0x%X\n"
-                "  id               : %d\n"
-                "  type             : %d %s\n"
-                "  working          : %d\n"
-                "  completion_timer : %d\n"
-                "  workerID         : %d\n"
-                "  time             : %d -> %d\n"
-                ,job0.list_link == NULL ? 0 : job0.list_link->item, job0.id, job0.job_type, ENUM_ATTR(job_type, caption, job0.job_type), job0.flags.bits.working, job0.completion_timer, getWorkerID(&job0), tick0, tick1);
-            continue;
-        }
-        df::job& job1 = *(*j).second;
-
-        if ( job0.flags.bits.working == job1.flags.bits.working &&
-               (job0.completion_timer == job1.completion_timer || (job1.completion_timer > 0 && job0.completion_timer-1 == job1.completion_timer)) &&
-               getWorkerID(&job0) == getWorkerID(&job1) )
-            continue;
-
-        out.print("job change\n"
-            "  location         : 0x%X -> 0x%X\n"
-            "  id               : %d -> %d\n"
-            "  type             : %d -> %d\n"
-            "  type             : %s -> %s\n"
-            "  working          : %d -> %d\n"
-            "  completion timer : %d -> %d\n"
-            "  workerID         : %d -> %d\n"
-            "  time             : %d -> %d\n"
-            "\n",
-            job0.list_link->item, job1.list_link->item,
-            job0.id, job1.id,
-            job0.job_type, job1.job_type,
-            ENUM_ATTR(job_type, caption, job0.job_type), ENUM_ATTR(job_type, caption, job1.job_type),
-            job0.flags.bits.working, job1.flags.bits.working,
-            job0.completion_timer, job1.completion_timer,
-            getWorkerID(&job0), getWorkerID(&job1),
-            tick0, tick1
-        );
-    }
-#endif
-
-    for (auto &prevJob : prevJobs) {
-        //if it happened within a tick, must have been cancelled by the user or a plugin: not completed
-        if ( tick1 <= tick0 )
-            continue;
-
-        if ( nowJobs.find(prevJob.first) != nowJobs.end() ) {
-            //could have just finished if it's a repeat job
-            df::job& job0 = *prevJob.second;
-            if ( !job0.flags.bits.repeat )
-                continue;
-            df::job& job1 = *nowJobs[prevJob.first];
-            if ( job0.completion_timer != 0 )
-                continue;
-            if ( job1.completion_timer != -1 )
-                continue;
-
-            //still false positive if cancelled at EXACTLY the right time, but experiments show this doesn't happen
-            for (auto &[_,handle] : copy) {
-                DEBUG(log,out).print("calling handler for repeated job completed event\n");
-                run_handler(out, EventType::JOB_COMPLETED, handle, (void*) &job0);
-            }
-            continue;
-        }
-
-        //recently finished or cancelled job
-        df::job& job0 = *prevJob.second;
-        if ( job0.flags.bits.repeat || job0.completion_timer != 0 )
-            continue;
+    refreshJobSnapshot();
+    if (pendingCompletedJobs.empty())
+        return;
 
-        for (auto &[_,handle] : copy) {
+    auto listeners = getListeners(EventType::JOB_COMPLETED);
+    vector<df::job*> completed;
+    completed.swap(pendingCompletedJobs);
+    for (df::job* job0 : completed) {
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for job completed event\n");
-            run_handler(out, EventType::JOB_COMPLETED, handle, (void*) &job0);
+            run_handler(out, EventType::JOB_COMPLETED, handle, (void*)job0);
         }
-    }
-
-    //erase old jobs, copy over possibly altered jobs
-    for (auto &[_,prev_job] : prevJobs) {
-        Job::deleteJobStruct(prev_job, true);
-    }
-    prevJobs.clear();
-
-    //create new jobs
-    for (auto &[_,now_job] : nowJobs) {
-        /*map<int32_t, df::job*>::iterator i = prevJobs.find((*j).first);
-        if ( i != prevJobs.end() ) {
-            continue;
-        }*/
-
-        df::job* newJob = Job::cloneJobStruct(now_job, true);
-        prevJobs.emplace(newJob->id, newJob);
+        Job::deleteJobStruct(job0, true);
     }
 }
 
@@ -654,7 +752,7 @@ static void manageNewUnitActiveEvent(color_ostream& out) {
     if (!df::global::world)
         return;
 
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::UNIT_NEW_ACTIVE].begin(), handlers[EventType::UNIT_NEW_ACTIVE].end());
+    auto listeners = getListeners(EventType::UNIT_NEW_ACTIVE);
     // iterate event handler callbacks
     vector<int32_t> new_active_unit_ids;
     for (df::unit* unit : df::global::world->units.active) {
@@ -664,7 +762,7 @@ static void manageNewUnitActiveEvent(color_ostream& out) {
         }
     }
     for (int32_t unit_id : new_active_unit_ids) {
-        for (auto &[_,handle] : copy) {
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for new unit event\n");
             run_handler(out, EventType::UNIT_NEW_ACTIVE, handle, (void*) intptr_t(unit_id)); // intptr_t() avoids cast from smaller type warning
         }
@@ -675,7 +773,7 @@ static void manageNewUnitActiveEvent(color_ostream& out) {
 static void manageUnitDeathEvent(color_ostream& out) {
     if (!df::global::world)
         return;
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::UNIT_DEATH].begin(), handlers[EventType::UNIT_DEATH].end());
+    auto listeners = getListeners(EventType::UNIT_DEATH);
     vector<int32_t> dead_unit_ids;
     for (auto unit : df::global::world->units.all) {
         //if ( unit->counters.death_id == -1 ) {
@@ -692,7 +790,7 @@ static void manageUnitDeathEvent(color_ostream& out) {
     }
 
     for (int32_t unit_id : dead_unit_ids) {
-        for (auto &[_,handle] : copy) {
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for unit death event\n");
             run_handler(out, EventType::UNIT_DEATH, handle, (void*)intptr_t(unit_id));
         }
@@ -708,7 +806,7 @@ static void manageItemCreationEvent(color_ostream& out) {
         return;
     }
 
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::ITEM_CREATED].begin(), handlers[EventType::ITEM_CREATED].end());
+    auto listeners = getListeners(EventType::ITEM_CREATED);
     size_t index = df::item::binsearch_index(df::global::world->items.all, nextItem, false);
     if ( index != 0 ) index--;
 
@@ -735,7 +833,7 @@ static void manageItemCreationEvent(color_ostream& out) {
 
     // handle all created items
     for (int32_t item_id : created_items) {
-        for (auto &[_,handle] : copy) {
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for item created event\n");
             run_handler(out, EventType::ITEM_CREATED, handle, (void*)intptr_t(item_id));
         }
@@ -753,7 +851,7 @@ static void manageBuildingEvent(color_ostream& out) {
      * TODO: could be faster
      * consider looking at jobs: building creation / destruction
      **/
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::BUILDING].begin(), handlers[EventType::BUILDING].end());
+    auto listeners = getListeners(EventType::BUILDING);
     //first alert people about new buildings
     vector<int32_t> new_buildings;
     for ( int32_t a = nextBuilding; a < *df::global::building_next_id; a++ ) {
@@ -778,7 +876,7 @@ static void manageBuildingEvent(color_ostream& out) {
             continue;
         }
 
-        for (auto &[_,handle] : copy) {
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for destroyed building event\n");
             run_handler(out, EventType::BUILDING, handle, (void*)intptr_t(id));
         }
@@ -787,7 +885,7 @@ static void manageBuildingEvent(color_ostream& out) {
 
     //alert people about newly created buildings
     std::for_each(new_buildings.begin(), new_buildings.end(), [&](int32_t building){
-        for (auto &[_,handle] : copy) {
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for created building event\n");
             run_handler(out, EventType::BUILDING, handle, (void*)intptr_t(building));
         }
@@ -799,7 +897,7 @@ static void manageConstructionEvent(color_ostream& out) {
         return;
     //unordered_set<df::construction*> constructionsNow(df::global::world->event.constructions.begin(), df::global::world->event.constructions.end());
 
-    multimap<Plugin*, EventHandler> copy(handlers[EventType::CONSTRUCTION].begin(), handlers[EventType::CONSTRUCTION].end());
+    auto listeners = getListeners(EventType::CONSTRUCTION);
 
     unordered_set<df::construction> next_construction_set; // will be swapped with constructions
     next_construction_set.reserve(constructions.bucket_count());
@@ -824,7 +922,7 @@ static void manageConstructionEvent(color_ostream& out) {
     // now next_construction_set contains all the constructions that were removed (not found in df::global::world->event.constructions)
     for (auto& construction : next_construction_set) {
         // handle construction removed event
-        for (const auto &[_,handle]: copy) {
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for destroyed construction event\n");
             run_handler(out, EventType::CONSTRUCTION, handle, (void*) &construction);
         }
@@ -832,7 +930,7 @@ static void manageConstructionEvent(color_ostream& out) {
 
     // now handle all the new constructions
     for (auto& construction : new_constructions) {
-        for (const auto &[_,handle]: copy) {
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for created construction event\n");
             run_handler(out, EventType::CONSTRUCTION, handle, (void*) &construction);
         }
@@ -842,7 +940,7 @@ static void manageConstructionEvent(color_ostream& out) {
 static void manageSyndromeEvent(color_ostream& out) {
     if (!df::global::world)
         return;
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::SYNDROME].begin(), handlers[EventType::SYNDROME].end());
+    auto listeners = getListeners(EventType::SYNDROME);
     int32_t highestTime = -1;
 
     std::vector<SyndromeData> new_syndrome_data;
@@ -864,7 +962,7 @@ static void manageSyndromeEvent(color_ostream& out) {
         }
     }
     for (auto& data : new_syndrome_data) {
-        for (auto &[_,handle] : copy) {
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for syndrome event\n");
             run_handler(out, EventType::SYNDROME, handle, (void*)&data);
         }
@@ -876,125 +974,113 @@ static void manageSyndromeEvent(color_ostream& out) {
 static void manageInvasionEvent(color_ostream& out) {
     if (!df::global::plotinfo)
         return;
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::INVASION].begin(), handlers[EventType::INVASION].end());
+    auto listeners = getListeners(EventType::INVASION);
 
     if ( df::global::plotinfo->invasions.next_id <= nextInvasion )
         return;
     nextInvasion = df::global::plotinfo->invasions.next_id;
 
-    for (auto &[_,handle] : copy) {
+    for (auto &handle : *listeners) {
         DEBUG(log,out).print("calling handler for invasion event\n");
         run_handler(out, EventType::INVASION, handle, (void*)intptr_t(nextInvasion-1));
     }
 }
 
-static void manageEquipmentEvent(color_ostream& out) {
-    if (!df::global::world)
-        return;
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::INVENTORY_CHANGE].begin(), handlers[EventType::INVENTORY_CHANGE].end());
+static const InventoryItem* findInventoryItem(const vector<InventoryItem>& items, int32_t itemId) {
+    for (auto &item : items) {
+        if (item.itemId == itemId)
+            return &item;
+    }
+    return nullptr;
+}
 
-    unordered_map<int32_t, InventoryItem> itemIdToInventoryItem;
-    unordered_set<int32_t> currentlyEquipped;
+static bool isEquipped(df::unit* unit, int32_t itemId) {
+    for (auto dfitem : unit->inventory) {
+        if (dfitem->item->id == itemId)
+            return true;
+    }
+    return false;
+}
 
-    vector<InventoryChangeData> equipment_pickups;
-    vector<InventoryChangeData> equipment_drops;
-    vector<InventoryChangeData> equipment_changes;
+static int32_t allocInventoryItem(const InventoryItem& item) {
+    inventoryArena.push_back(item);
+    return int32_t(inventoryArena.size() - 1);
+}
 
+static void dispatchInventoryChanges(color_ostream& out, const dispatch_list& listeners, const vector<PendingInventoryChange>& changes, const char* what) {
+    for (auto &change : changes) {
+        InventoryChangeData data(change.unitId,
+            change.item_old < 0 ? nullptr : &inventoryArena[change.item_old],
+            change.item_new < 0 ? nullptr : &inventoryArena[change.item_new]);
+        for (auto &handle : listeners) {
+            DEBUG(log,out).print("calling handler for %sinventory change event\n", what);
+            run_handler(out, EventType::INVENTORY_CHANGE, handle, (void*) &data);
+        }
+    }
+}
 
-    // This vector stores the pointers to newly created changed items
-    // needed as the stack allocated temporary (in the loop) is lost when we go to
-    // handle the event calls, so we move that data to the heap if its needed,
-    // and then once we are done we delete everything.
-    vector<InventoryItem*> changed_items;
+static void manageEquipmentEvent(color_ostream& out) {
+    if (!df::global::world)
+        return;
+    auto listeners = getListeners(EventType::INVENTORY_CHANGE);
+    static const vector<InventoryItem> noEquipment;
 
+    // Changed items are copied into the arena while scanning and the events
+    // refer to them by index, so the arena can grow freely until dispatch.
+    // Everything is cleared (but keeps its capacity) once handlers have run.
     for (auto unit : df::global::world->units.all) {
-        itemIdToInventoryItem.clear();
-        currentlyEquipped.clear();
         /*if ( unit->flags1.bits.inactive )
             continue;
         */
 
         auto oldEquipment = equipmentLog.find(unit->id);
-        bool hadEquipment = oldEquipment != equipmentLog.end();
-        vector<InventoryItem>* temp;
-        if ( hadEquipment ) {
-            temp = &((*oldEquipment).second);
-        } else {
-            temp = new vector<InventoryItem>;
-        }
-        //vector<InventoryItem>& v = (*oldEquipment).second;
-        vector<InventoryItem>& v = *temp;
-        for (auto & i : v) {
-            itemIdToInventoryItem[i.itemId] = i;
-        }
-        for ( size_t b = 0; b < unit->inventory.size(); b++ ) {
-            df::unit_inventory_item* dfitem_new = unit->inventory[b];
-            currentlyEquipped.insert(dfitem_new->item->id);
+        const vector<InventoryItem>& v = oldEquipment != equipmentLog.end() ? oldEquipment->second : noEquipment;
+        for (auto dfitem_new : unit->inventory) {
             InventoryItem item_new(dfitem_new->item->id, *dfitem_new);
-            auto c = itemIdToInventoryItem.find(dfitem_new->item->id);
-            if ( c == itemIdToInventoryItem.end() ) {
+            const InventoryItem* item_old = findInventoryItem(v, item_new.itemId);
+            if ( !item_old ) {
                 //new item equipped (probably just picked up)
-                changed_items.emplace_back(new InventoryItem(item_new));
-                equipment_pickups.emplace_back(unit->id, nullptr, changed_items.back());
+                inventoryPickups.push_back({unit->id, -1, allocInventoryItem(item_new)});
                 continue;
             }
-            InventoryItem item_old = c->second;
 
-            df::unit_inventory_item& item0 = item_old.item;
-            df::unit_inventory_item& item1 = item_new.item;
+            const df::unit_inventory_item& item0 = item_old->item;
+            const df::unit_inventory_item& item1 = item_new.item;
             if ( item0.mode == item1.mode && item0.body_part_id == item1.body_part_id && item0.wound_id == item1.wound_id )
                 continue;
             //some sort of change in how it's equipped
-            changed_items.emplace_back(new InventoryItem(item_new));
-            InventoryItem* item_new_ptr = changed_items.back();
-            changed_items.emplace_back(new InventoryItem(item_old));
-            InventoryItem* item_old_ptr = changed_items.back();
-            equipment_changes.emplace_back(unit->id, item_old_ptr, item_new_ptr);
+            int32_t new_idx = allocInventoryItem(item_new);
+            int32_t old_idx = allocInventoryItem(*item_old);
+            inventoryChanges.push_back({unit->id, old_idx, new_idx});
         }
         //check for dropped items
-        for (auto i : v) {
-            if ( currentlyEquipped.find(i.itemId) != currentlyEquipped.end() )
+        for (auto &i : v) {
+            if ( isEquipped(unit, i.itemId) )
                 continue;
             //TODO: delete ptr if invalid
-            changed_items.emplace_back(new InventoryItem(i));
-            equipment_drops.emplace_back(unit->id, changed_items.back(), nullptr);
+            inventoryDrops.push_back({unit->id, allocInventoryItem(i), -1});
         }
-        if ( !hadEquipment )
-            delete temp;
 
         //update equipment
-        vector<InventoryItem>& equipment = equipmentLog[unit->id];
+        if ( v.empty() && unit->inventory.empty() )
+            continue;
+        vector<InventoryItem>& equipment = oldEquipment != equipmentLog.end() ? oldEquipment->second : equipmentLog[unit->id];
         equipment.clear();
         for (auto dfitem : unit->inventory) {
-            InventoryItem item(dfitem->item->id, *dfitem);
-            equipment.push_back(item);
+            equipment.emplace_back(dfitem->item->id, *dfitem);
         }
     }
 
     // now handle events
-    std::for_each(equipment_pickups.begin(), equipment_pickups.end(), [&](InventoryChangeData& data) {
-        for (auto &[_, handle] : copy) {
-            DEBUG(log,out).print("calling handler for new item equipped inventory change event\n");
-            run_handler(out, EventType::INVENTORY_CHANGE, handle, (void*) &data);
-        }
-    });
-    std::for_each(equipment_drops.begin(), equipment_drops.end(), [&](InventoryChangeData& data) {
-        for (auto &[_, handle] : copy) {
-            DEBUG(log,out).print("calling handler for dropped item inventory change event\n");
-            run_handler(out, EventType::INVENTORY_CHANGE, handle, (void*) &data);
-        }
-    });
-    std::for_each(equipment_changes.begin(), equipment_changes.end(), [&](InventoryChangeData& data) {
-        for (auto &[_, handle] : copy) {
-            DEBUG(log,out).print("calling handler for inventory change event\n");
-            run_handler(out, EventType::INVENTORY_CHANGE, handle, (void*) &data);
-        }
-    });
-
-    // clean up changed items list
-    std::for_each(changed_items.begin(), changed_items.end(), [](InventoryItem* p){
-        delete p;
-    });
+    dispatchInventoryChanges(out, *listeners, inventoryPickups, "new item equipped ");
+    dispatchInventoryChanges(out, *listeners, inventoryDrops, "dropped item ");
+    dispatchInventoryChanges(out, *listeners, inventoryChanges, "");
+
+    // reset the per-pass arena
+    inventoryPickups.clear();
+    inventoryDrops.clear();
+    inventoryChanges.clear();
+    inventoryArena.clear();
 }
 
 static void updateReportToRelevantUnits() {
@@ -1021,7 +1107,7 @@ static void updateReportToRelevantUnits() {
 static void manageReportEvent(color_ostream& out) {
     if (!df::global::world)
         return;
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::REPORT].begin(), handlers[EventType::REPORT].end());
+    auto listeners = getListeners(EventType::REPORT);
     std::vector<df::report*>& reports = df::global::world->status.reports;
     size_t idx = df::report::binsearch_index(reports, lastReport, false);
     // returns the index to the key equal to or greater than the key provided
@@ -1032,7 +1118,7 @@ static void manageReportEvent(color_ostream& out) {
 
     for ( ; idx < reports.size(); idx++ ) {
         df::report* report = reports[idx];
-        for (auto &[_,handle] : copy) {
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for report event\n");
             run_handler(out, EventType::REPORT, handle, (void*)intptr_t(report->id));
         }
@@ -1052,13 +1138,18 @@ static df::unit_wound* getWound(df::unit* attacker, df::unit* defender) {
 static void manageUnitAttackEvent(color_ostream& out) {
     if (!df::global::world)
         return;
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::UNIT_ATTACK].begin(), handlers[EventType::UNIT_ATTACK].end());
+    auto listeners = getListeners(EventType::UNIT_ATTACK);
     std::vector<df::report*>& reports = df::global::world->status.reports;
     size_t idx = df::report::binsearch_index(reports, lastReportUnitAttack, false);
     // returns the index to the key equal to or greater than the key provided
     idx = reports[idx]->id == lastReportUnitAttack ? idx + 1 : idx; // we need the index after (where the new stuff is)
 
-    std::set<int32_t> strikeReports;
+    //scratch state reused between passes so busy combat doesn't churn the allocator
+    static vector<int32_t> strikeReports;
+    static unordered_set<std::pair<int32_t, int32_t>, hash_pair> already_done;
+    strikeReports.clear();
+    already_done.clear();
+    //report ids are increasing, so this stays sorted and unique
     for ( ; idx < reports.size(); idx++ ) {
         df::report* report = reports[idx];
         lastReportUnitAttack = report->id;
@@ -1066,29 +1157,17 @@ static void manageUnitAttackEvent(color_ostream& out) {
             continue;
         df::announcement_type type = report->type;
         if ( type == df::announcement_type::COMBAT_STRIKE_DETAILS ) {
-            strikeReports.insert(report->id);
+            strikeReports.push_back(report->id);
         }
     }
 
     if ( strikeReports.empty() )
         return;
     updateReportToRelevantUnits();
-    unordered_set<std::pair<int32_t, int32_t>, hash_pair> already_done;
     for (int reportId : strikeReports) {
         df::report* report = df::report::find(reportId);
         if ( !report )
             continue; //TODO: error
-        std::string reportStr = report->text;
-        for ( int32_t b = reportId+1; ; b++ ) {
-            df::report* report2 = df::report::find(b);
-            if ( !report2 )
-                break;
-            if ( report2->type != df::announcement_type::COMBAT_STRIKE_DETAILS )
-                break;
-            if ( !report2->flags.bits.continuation )
-                break;
-            reportStr += report2->text;
-        }
 
         std::vector<int32_t>& relevantUnits = reportToRelevantUnits[report->id];
         if ( relevantUnits.size() != 2 ) {
@@ -1109,7 +1188,7 @@ static void manageUnitAttackEvent(color_ostream& out) {
             data.wound = wound1->id;
 
             already_done.emplace(unit1->id, unit2->id);
-            for (auto &[_,handle] : copy) {
+            for (auto &handle : *listeners) {
                 DEBUG(log,out).print("calling handler for unit1 attack unit attack event\n");
                 run_handler(out, EventType::UNIT_ATTACK, handle, (void*)&data);
             }
@@ -1121,7 +1200,7 @@ static void manageUnitAttackEvent(color_ostream& out) {
             data.wound = wound2->id;
 
             already_done.emplace(unit1->id, unit2->id);
-            for (auto &[_,handle] : copy) {
+            for (auto &handle : *listeners) {
                 DEBUG(log,out).print("calling handler for unit2 attack unit attack event\n");
                 run_handler(out, EventType::UNIT_ATTACK, handle, (void*)&data);
             }
@@ -1133,7 +1212,7 @@ static void manageUnitAttackEvent(color_ostream& out) {
             data.wound = -1;
 
             already_done.emplace(unit1->id, unit2->id);
-            for (auto &[_,handle] : copy) {
+            for (auto &handle : *listeners) {
                 DEBUG(log,out).print("calling handler for unit1 killed unit attack event\n");
                 run_handler(out, EventType::UNIT_ATTACK, handle, (void*)&data);
             }
@@ -1145,7 +1224,7 @@ static void manageUnitAttackEvent(color_ostream& out) {
             data.wound = -1;
 
             already_done.emplace(unit1->id, unit2->id);
-            for (auto &[_,handle] : copy) {
+            for (auto &handle : *listeners) {
                 DEBUG(log,out).print("calling handler for unit2 killed unit attack event\n");
                 run_handler(out, EventType::UNIT_ATTACK, handle, (void*)&data);
             }
@@ -1154,6 +1233,18 @@ static void manageUnitAttackEvent(color_ostream& out) {
         if ( !wound1 && !wound2 ) {
             //if ( unit1->flags1.bits.inactive || unit2->flags1.bits.inactive )
             //    continue;
+            //only assemble the full report text when it's actually needed
+            std::string reportStr = report->text;
+            for ( int32_t b = reportId+1; ; b++ ) {
+                df::report* report2 = df::report::find(b);
+                if ( !report2 )
+                    break;
+                if ( report2->type != df::announcement_type::COMBAT_STRIKE_DETAILS )
+                    break;
+                if ( !report2->flags.bits.continuation )
+                    break;
+                reportStr += report2->text;
+            }
             if ( reportStr.find("severed part") )
                 continue;
             if ( Once::doOnce("EventManager neither wound") ) {
@@ -1195,9 +1286,10 @@ static std::string getVerb(df::unit* unit, const std::string &reportStr) {
     return "";
 }
 
-static InteractionData getAttacker(color_ostream& out, df::report* attackEvent, df::unit* lastAttacker, df::report* defendEvent, vector<df::unit*>& relevantUnits) {
-    vector<df::unit*> attackers = relevantUnits;
-    vector<df::unit*> defenders = relevantUnits;
+static InteractionData getAttacker(color_ostream& out, df::report* attackEvent, df::unit* lastAttacker, df::report* defendEvent, const vector<df::unit*>& relevantUnits) {
+    //relevantUnits holds at most a few units, so these are cheap to copy
+    vector<df::unit*> attackers(relevantUnits);
+    vector<df::unit*> defenders(relevantUnits);
 
     //find valid interactions: TODO
     /*map<int32_t,vector<df::interaction*> > validInteractions;
@@ -1310,15 +1402,13 @@ static InteractionData getAttacker(color_ostream& out, df::report* attackEvent,
     return result;
 }
 
-static vector<df::unit*> gatherRelevantUnits(color_ostream& out, df::report* r1, df::report* r2) {
-    vector<df::report*> reports;
+static void gatherRelevantUnits(color_ostream& out, df::report* r1, df::report* r2, vector<df::unit*>& result) {
+    result.clear();
     if ( r1 == r2 ) r2 = nullptr;
-    if ( r1 ) reports.push_back(r1);
-    if ( r2 ) reports.push_back(r2);
-    vector<df::unit*> result;
-    unordered_set<int32_t> ids;
 //out.print("%s,%d\n",__FILE__,__LINE__);
-    for (auto report : reports) {
+    for (auto report : {r1, r2}) {
+        if ( !report )
+            continue;
 //out.print("%s,%d\n",__FILE__,__LINE__);
         vector<int32_t>& units = reportToRelevantUnits[report->id];
         if ( units.size() > 2 ) {
@@ -1326,20 +1416,19 @@ static vector<df::unit*> gatherRelevantUnits(color_ostream& out, df::report* r1,
                 out.print("%s,%d: too many relevant units. On report\n \'%s\'\n", __FILE__, __LINE__, report->text.c_str());
             }
         }
-        for (int & unit_id : units)
-            if (ids.find(unit_id) == ids.end() ) {
-                ids.insert(unit_id);
-                result.push_back(df::unit::find(unit_id));
-            }
+        for (int32_t unit_id : units) {
+            df::unit* unit = df::unit::find(unit_id);
+            if ( std::find(result.begin(), result.end(), unit) == result.end() )
+                result.push_back(unit);
+        }
     }
 //out.print("%s,%d\n",__FILE__,__LINE__);
-    return result;
 }
 
 static void manageInteractionEvent(color_ostream& out) {
     if (!df::global::world)
         return;
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::INTERACTION].begin(), handlers[EventType::INTERACTION].end());
+    auto listeners = getListeners(EventType::INTERACTION);
     std::vector<df::report*>& reports = df::global::world->status.reports;
     size_t a = df::report::binsearch_index(reports, lastReportInteraction, false);
     while (a < reports.size() && reports[a]->id <= lastReportInteraction) {
@@ -1351,7 +1440,12 @@ static void manageInteractionEvent(color_ostream& out) {
     df::report* lastAttackEvent = nullptr;
     df::unit* lastAttacker = nullptr;
     //df::unit* lastDefender = NULL;
-    unordered_map<int32_t,unordered_set<int32_t> > history;
+    //scratch state reused between passes; there are only ever a handful of
+    //interactions per pass, so flat vectors beat node-based containers here
+    static vector<std::pair<int32_t,int32_t>> history;
+    static vector<df::unit*> relevantUnits;
+    static vector<df::unit*> relevant_units;
+    history.clear();
     for ( ; a < reports.size(); a++ ) {
         df::report* report = reports[a];
         lastReportInteraction = report->id;
@@ -1366,7 +1460,7 @@ static void manageInteractionEvent(color_ostream& out) {
             lastAttacker = nullptr;
             //lastDefender = NULL;
         }
-        vector<df::unit*> relevantUnits = gatherRelevantUnits(out, lastAttackEvent, report);
+        gatherRelevantUnits(out, lastAttackEvent, report, relevantUnits);
         InteractionData data = getAttacker(out, lastAttackEvent, lastAttacker, attack ? nullptr : report, relevantUnits);
         if ( data.attacker < 0 )
             continue;
@@ -1375,7 +1469,7 @@ static void manageInteractionEvent(color_ostream& out) {
         //    continue; //lazy way of preventing duplicates
         if ( attack && a+1 < reports.size() && reports[a+1]->type == df::announcement_type::INTERACTION_TARGET ) {
 //out.print("%s,%d\n",__FILE__,__LINE__);
-            vector<df::unit*> relevant_units = gatherRelevantUnits(out, lastAttackEvent, reports[a + 1]);
+            gatherRelevantUnits(out, lastAttackEvent, reports[a + 1], relevant_units);
             InteractionData data2 = getAttacker(out, lastAttackEvent, lastAttacker, reports[a+1], relevant_units);
             if ( data.attacker == data2.attacker && (data.defender == -1 || data.defender == data2.defender) ) {
 //out.print("%s,%d\n",__FILE__,__LINE__);
@@ -1386,24 +1480,19 @@ static void manageInteractionEvent(color_ostream& out) {
         {
 #define HISTORY_ITEM 1
 #if HISTORY_ITEM
-            unordered_set<int32_t>& b = history[data.attacker];
-            if ( b.find(data.defender) != b.end() )
-                continue;
-            history[data.attacker].insert(data.defender);
-            //b.insert(data.defender);
+            auto key = std::make_pair(data.attacker, data.defender);
 #else
-            unordered_set<int32_t>& b = history[data.attackReport];
-            if ( b.find(data.defendReport) != b.end() )
-                continue;
-            history[data.attackReport].insert(data.defendReport);
-            //b.insert(data.defendReport);
+            auto key = std::make_pair(data.attackReport, data.defendReport);
 #endif
+            if ( std::find(history.begin(), history.end(), key) != history.end() )
+                continue;
+            history.push_back(key);
         }
 //out.print("%s,%d\n",__FILE__,__LINE__);
         lastAttacker = df::unit::find(data.attacker);
         //lastDefender = df::unit::find(data.defender);
         //fire event
-        for (auto &[_,handle] : copy) {
+        for (auto &handle : *listeners) {
             DEBUG(log,out).print("calling handler for interaction event\n");
             run_handler(out, EventType::INTERACTION, handle, (void*)&data);
         }
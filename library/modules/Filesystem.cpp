@@ -50,6 +50,10 @@ SOFTWARE.
 
 #include "modules/Filesystem.h"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 using namespace DFHack;
 
 static bool initialized = false;
@@ -282,3 +286,70 @@ int Filesystem::listdir_recursive (std::string dir, std::map<std::string, bool>
         dir.resize(dir.size()-1);
     return listdir_recursive_impl(dir, "", files, depth, include_prefix);
 }
+
+Filesystem::MappedFile::MappedFile (const std::string &path)
+{
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size))
+        return;
+
+    length = size_t(file_size.QuadPart);
+    if (length == 0)
+    {
+        opened = true;
+        return;
+    }
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping)
+        view = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    opened = (view != nullptr);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    STAT_STRUCT info;
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+    {
+        length = size_t(info.st_size);
+        if (length == 0)
+            opened = true;
+        else
+        {
+            void *ptr = ::mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr != MAP_FAILED)
+            {
+                view = (const uint8_t *)ptr;
+                opened = true;
+            }
+        }
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+#endif
+    if (!opened)
+        length = 0;
+}
+
+Filesystem::MappedFile::~MappedFile ()
+{
+#ifdef _WIN32
+    if (view)
+        UnmapViewOfFile(view);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+#else
+    if (view)
+        ::munmap((void *)view, length);
+#endif
+}
@@ -98,6 +98,7 @@ distribution.
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
 
 using std::string;
 using std::vector;
@@ -2699,6 +2700,70 @@ Gui::DwarfmodeDims Gui::getDwarfmodeViewDims()
     return GUI_HOOK_TOP(Gui::Hooks::dwarfmode_view_dims)();
 }
 
+static Gui::ViewportSnapshot viewport_snapshot;
+static bool viewport_snapshot_stale = true;
+
+void Gui::clearViewportSnapshot()
+{
+    viewport_snapshot_stale = true;
+}
+
+static void fillViewportSnapshot(Gui::ViewportSnapshot &snap)
+{
+    snap.tiles.assign(snap.width * snap.height, Gui::ViewportTile());
+    if (!Maps::IsValid() || snap.tiles.empty())
+        return;
+
+    int x_min = snap.origin.x, x_max = snap.origin.x + snap.width - 1;
+    int y_min = snap.origin.y, y_max = snap.origin.y + snap.height - 1;
+
+    // one block lookup per visible block, then straight copies of its tile rows
+    for (int by = y_min >> 4; by <= y_max >> 4; by++) {
+        for (int bx = x_min >> 4; bx <= x_max >> 4; bx++) {
+            df::map_block *block = Maps::getBlock(bx, by, snap.origin.z);
+            if (!block)
+                continue;
+
+            int tx1 = std::max(x_min, bx * 16), tx2 = std::min(x_max, bx * 16 + 15);
+            int ty1 = std::max(y_min, by * 16), ty2 = std::min(y_max, by * 16 + 15);
+            for (int y = ty1; y <= ty2; y++) {
+                Gui::ViewportTile *row = &snap.tiles[(y - y_min) * snap.width];
+                for (int x = tx1; x <= tx2; x++) {
+                    Gui::ViewportTile &tile = row[x - x_min];
+                    tile.block = block;
+                    tile.tiletype = block->tiletype[x & 15][y & 15];
+                    tile.designation = block->designation[x & 15][y & 15];
+                    tile.occupancy = block->occupancy[x & 15][y & 15];
+                }
+            }
+        }
+    }
+}
+
+const Gui::ViewportSnapshot &Gui::getViewportSnapshot()
+{
+    auto &snap = viewport_snapshot;
+    auto dims = getDwarfmodeViewDims();
+    df::coord view = getViewportPos();
+    df::coord origin(view.x + dims.map_x1, view.y + dims.map_y1, view.z);
+    int width = std::max(0, dims.map_x2 - dims.map_x1 + 1);
+    int height = std::max(0, dims.map_y2 - dims.map_y1 + 1);
+
+    if (!viewport_snapshot_stale && snap.origin == origin &&
+            snap.x1 == dims.map_x1 && snap.y1 == dims.map_y1 &&
+            snap.width == width && snap.height == height)
+        return snap;
+
+    snap.x1 = dims.map_x1;
+    snap.y1 = dims.map_y1;
+    snap.width = width;
+    snap.height = height;
+    snap.origin = origin;
+    fillViewportSnapshot(snap);
+    viewport_snapshot_stale = false;
+    return snap;
+}
+
 static void unfollow() {
     if (!plotinfo)
         return;
@@ -34,6 +34,7 @@ distribution.
 
 #include "modules/Job.h"
 #include "modules/MapCache.h"
+#include "modules/Maps.h"
 #include "modules/Materials.h"
 #include "modules/Items.h"
 #include "modules/Translation.h"
@@ -105,7 +106,9 @@ distribution.
 #include "df/world_site.h"
 #include "df/written_content.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <functional>
 #include <map>
 #include <sstream>
 #include <string>
@@ -522,11 +525,18 @@ bool ItemTypeInfo::matches(const df::job_item &jitem, MaterialInfo *mat,
            bits_match(jitem.flags3.whole, item_ok3.whole, item_mask3.whole);
 }
 
+static IdIndex<df::item> item_index;
+
 df::item * Items::findItemByID(int32_t id)
 {
     if (id < 0)
         return 0;
-    return df::item::find(id);
+    return item_index.find(world->items.all, id);
+}
+
+void Items::findItemsByID(const std::vector<int32_t> &ids, std::vector<df::item*> &items)
+{
+    item_index.resolve(world->items.all, ids, items);
 }
 
 df::general_ref *Items::getGeneralRef(df::item *item, df::general_ref_type type)
@@ -671,6 +681,100 @@ df::unit *Items::getHolderUnit(df::item * item)
     return ref ? ref->getUnit() : NULL;
 }
 
+// Calls fn(item) for the items on the ground in the box, using the item
+// lists that DF keeps in each map block.
+template<typename Fn>
+static void forEachGroundItemInRange(int32_t x1, int32_t y1, int32_t z1,
+                                     int32_t x2, int32_t y2, int32_t z2, Fn &&fn)
+{
+    int32_t x_max = 0, y_max = 0, z_max = 0;
+    Maps::getTileSize(x_max, y_max, z_max);
+    x1 = std::max(x1, 0);
+    y1 = std::max(y1, 0);
+    z1 = std::max(z1, 0);
+    x2 = std::min(x2, x_max - 1);
+    y2 = std::min(y2, y_max - 1);
+    z2 = std::min(z2, z_max - 1);
+
+    for (int32_t z = z1; z <= z2; z++)
+        for (int32_t by = y1 >> 4; by <= y2 >> 4; by++)
+            for (int32_t bx = x1 >> 4; bx <= x2 >> 4; bx++)
+            {
+                auto block = Maps::getBlock(bx, by, z);
+                if (!block)
+                    continue;
+                for (auto id : block->items)
+                {
+                    auto item = Items::findItemByID(id);
+                    if (!item || !item->flags.bits.on_ground)
+                        continue;
+                    auto &pos = item->pos;
+                    if (pos.x >= x1 && pos.x <= x2 && pos.y >= y1 && pos.y <= y2 && pos.z == z)
+                        fn(item);
+                }
+            }
+}
+
+void Items::getItemsInBox(std::vector<df::item*> &items, df::coord a, df::coord b)
+{
+    items.clear();
+    if (!Maps::IsValid())
+        return;
+    forEachGroundItemInRange(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z),
+                             std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z),
+        [&](df::item *item) { items.push_back(item); });
+}
+
+void Items::getItemsInRadius(std::vector<df::item*> &items, df::coord center, int radius)
+{
+    items.clear();
+    if (!Maps::IsValid() || radius < 0)
+        return;
+    forEachGroundItemInRange(center.x - radius, center.y - radius, center.z - radius,
+                             center.x + radius, center.y + radius, center.z + radius,
+        [&](df::item *item) {
+            if (Maps::SpatialGrid<df::item *>::distance(center, item->pos) <= radius)
+                items.push_back(item);
+        });
+}
+
+void Items::getNearestItems(std::vector<df::item*> &items, df::coord center, size_t count,
+    std::function<bool(df::item*)> filter)
+{
+    items.clear();
+    if (!count || !Maps::isValidTilePos(center))
+        return;
+
+    int32_t x_max = 0, y_max = 0, z_max = 0;
+    Maps::getTileSize(x_max, y_max, z_max);
+    const int limit = std::max({ int(center.x), x_max - 1 - center.x, int(center.y), y_max - 1 - center.y }) +
+                      std::max(int(center.z), z_max - 1 - center.z);
+
+    // widen the search until it holds enough matches or covers the map
+    std::vector<std::pair<int, df::item *>> found;
+    for (int radius = 8; ; radius *= 2)
+    {
+        found.clear();
+        forEachGroundItemInRange(center.x - radius, center.y - radius, center.z - radius,
+                                 center.x + radius, center.y + radius, center.z + radius,
+            [&](df::item *item) {
+                int dist = Maps::SpatialGrid<df::item *>::distance(center, item->pos);
+                if (dist <= radius && (!filter || filter(item)))
+                    found.emplace_back(dist, item);
+            });
+        if (found.size() >= count || radius >= limit)
+            break;
+    }
+
+    auto closer = [](const std::pair<int, df::item *> &a, const std::pair<int, df::item *> &b) {
+        return a.first != b.first ? a.first < b.first : a.second->id < b.second->id;
+    };
+    count = std::min(count, found.size());
+    std::partial_sort(found.begin(), found.begin() + count, found.end(), closer);
+    for (size_t i = 0; i < count; i++)
+        items.push_back(found[i].second);
+}
+
 df::coord Items::getPosition(df::item *item)
 {
     CHECK_NULL_POINTER(item);
@@ -1241,8 +1241,10 @@ bool MapExtras::Block::removeItemOnGround(df::item *item)
 MapExtras::MapCache::MapCache()
 {
     valid = 0;
+    last_block = NULL;
     Maps::getSize(x_bmax, y_bmax, z_max);
     x_tmax = x_bmax*16; y_tmax = y_bmax*16;
+    block_index.resize(z_max);
     std::vector<df::coord2d> geoidx;
     std::vector<std::vector<int16_t> > layer_mats;
     validgeo = Maps::ReadGeology(&layer_mats, &geoidx);
@@ -1316,11 +1318,17 @@ bool MapExtras::MapCache::WriteAll()
         df::job* job = job_link->item;
         df::coord pos = job->pos;
         df::coord blockpos(pos.x>>4,pos.y>>4,pos.z);
-        auto iter = blocks.find(blockpos);
-        if (iter == blocks.end())
+        if (unsigned(blockpos.x) >= x_bmax ||
+            unsigned(blockpos.y) >= y_bmax ||
+            unsigned(blockpos.z) >= z_max)
+            continue;
+        auto &level = block_index[blockpos.z];
+        if (level.empty())
+            continue;
+        auto block = level[blockpos.x + blockpos.y * x_bmax];
+        if (!block)
             continue;
         df::coord2d bpos(pos.x - (blockpos.x<<4),pos.y - (blockpos.y<<4));
-        auto block = iter->second;
         if (!block->designated_tiles.test(bpos.x+bpos.y*16))
             continue;
         bool is_designed = ENUM_ATTR(job_type,is_designation,job->job_type);
@@ -1330,48 +1338,56 @@ bool MapExtras::MapCache::WriteAll()
         // processing.
         Job::removeJob(job);
     }
-    std::map<DFCoord, Block *>::iterator p;
-    for(p = blocks.begin(); p != blocks.end(); p++)
+    for (auto &level : block_index)
     {
-        p->second->Write();
+        for (Block *b : level)
+            if (b)
+                b->Write();
     }
     return true;
 }
 
-MapExtras::Block *MapExtras::MapCache::BlockAt(DFCoord blockcoord)
+MapExtras::Block *MapExtras::MapCache::lookupBlock(DFCoord blockcoord)
 {
     if(!valid)
         return 0;
-    std::map <DFCoord, Block*>::iterator iter = blocks.find(blockcoord);
-    if(iter != blocks.end())
-    {
-        return (*iter).second;
-    }
-    else
-    {
-        if(unsigned(blockcoord.x) < x_bmax &&
-           unsigned(blockcoord.y) < y_bmax &&
-           unsigned(blockcoord.z) < z_max)
-        {
-            Block * nblo = new Block(this, blockcoord);
-            blocks[blockcoord] = nblo;
-            return nblo;
-        }
+    if(unsigned(blockcoord.x) >= x_bmax ||
+       unsigned(blockcoord.y) >= y_bmax ||
+       unsigned(blockcoord.z) >= z_max)
         return 0;
-    }
+
+    auto &level = block_index[blockcoord.z];
+    if (level.empty())
+        level.resize(x_bmax * y_bmax, NULL);
+    Block *&slot = level[blockcoord.x + blockcoord.y * x_bmax];
+    if (!slot)
+        slot = new Block(this, blockcoord);
+
+    last_block = slot;
+    last_bcoord = blockcoord;
+    return slot;
 }
 
 void MapExtras::MapCache::discardBlock(Block *block)
 {
-    blocks.erase(block->bcoord);
+    DFCoord bcoord = block->bcoord;
+    if (unsigned(bcoord.z) < block_index.size() && !block_index[bcoord.z].empty())
+        block_index[bcoord.z][bcoord.x + bcoord.y * x_bmax] = NULL;
+    if (last_block == block)
+        last_block = NULL;
     delete block;
 }
 
 void MapExtras::MapCache::resetTags()
 {
-    for (auto it = blocks.begin(); it != blocks.end(); ++it)
+    for (auto &level : block_index)
     {
-        delete[] it->second->tags;
-        it->second->tags = NULL;
+        for (Block *b : level)
+        {
+            if (!b)
+                continue;
+            delete[] b->tags;
+            b->tags = NULL;
+        }
     }
 }
@@ -301,6 +301,47 @@ bool Maps::isValidTilePos(int32_t x, int32_t y, int32_t z)
     return true;
 }
 
+/*
+ * Flood fill
+ */
+
+Maps::FloodFill::FloodFill(Connectivity connectivity)
+    : connectivity(connectivity)
+{
+    getTileSize(x_max, y_max, z_max);
+}
+
+df::tile_bitmask &Maps::FloodFill::blockMask(df::coord block)
+{
+    auto [it, inserted] = visited.try_emplace(block);
+    if (inserted)
+        it->second.clear();
+    return it->second;
+}
+
+void Maps::FloodFill::addSeed(df::coord pos)
+{
+    if (pos.x < 0 || pos.x >= x_max || pos.y < 0 || pos.y >= y_max || pos.z < 0 || pos.z >= z_max)
+        return;
+    if (markVisited(pos.x, pos.y, pos.z))
+        seeds.push_back(pos);
+}
+
+void Maps::FloodFill::expandFrom(df::coord pos)
+{
+    if (pos.x < 0 || pos.x >= x_max || pos.y < 0 || pos.y >= y_max || pos.z < 0 || pos.z >= z_max)
+        return;
+    sources.push_back(pos);
+}
+
+bool Maps::FloodFill::isVisited(df::coord pos) const
+{
+    auto it = visited.find(df::coord(pos.x >> 4, pos.y >> 4, pos.z));
+    if (it == visited.end())
+        return false;
+    return it->second.bits[pos.y & 15] & (1 << (pos.x & 15));
+}
+
 bool Maps::isTileVisible(int32_t x, int32_t y, int32_t z)
 {
     df::map_block *block = getTileBlock(x, y, z);
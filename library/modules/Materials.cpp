@@ -58,6 +58,8 @@ distribution.
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <unordered_map>
 #include <cstring>
 
 using std::string;
@@ -206,6 +208,212 @@ bool MaterialInfo::find(const std::vector<std::string> &items)
     return false;
 }
 
+/*
+ * Token lookup index, shared by all the find* methods.
+ *
+ * The raw vectors only change when a world is generated or loaded, so the
+ * index is dropped on world load and unload, and is also rebuilt lazily if
+ * the address or size of a vector it was built from differs. A miss is
+ * final: raws renamed in place are not seen until the next world load. Hits
+ * are still checked against the raw, and a stale hit costs a rebuild rather
+ * than a wrong answer.
+ * The "TOKEN:SUBTOKEN" material tables are large with modded raws, so they
+ * are only built the first time a plant or creature material is looked up.
+ */
+
+namespace {
+    enum token_kind {
+        TOKEN_INORGANIC,
+        TOKEN_PLANT,
+        TOKEN_CREATURE,
+        NUM_TOKEN_KINDS
+    };
+
+    struct raws_signature {
+        const void *data = NULL;
+        size_t size = 0;
+
+        bool operator== (const raws_signature &other) const {
+            return data == other.data && size == other.size;
+        }
+    };
+
+    struct material_token_index {
+        std::mutex mutex;
+        raws_signature signature[NUM_TOKEN_KINDS];
+        // raw token -> index in its raws vector
+        std::unordered_map<string, int32_t> raws[NUM_TOKEN_KINDS];
+        // "TOKEN:SUBTOKEN" -> material type; only used for plants and creatures
+        std::unordered_map<string, int16_t> materials[NUM_TOKEN_KINDS];
+        bool materials_built[NUM_TOKEN_KINDS] = {};
+    };
+}
+
+static material_token_index token_index;
+
+template<class T>
+static raws_signature get_signature(const vector<T*> &vec)
+{
+    raws_signature sig;
+    sig.data = vec.data();
+    sig.size = vec.size();
+    return sig;
+}
+
+static raws_signature get_signature(token_kind kind)
+{
+    df::world_raws &raws = world->raws;
+    switch (kind)
+    {
+    case TOKEN_INORGANIC: return get_signature(raws.inorganics);
+    case TOKEN_PLANT: return get_signature(raws.plants.all);
+    case TOKEN_CREATURE: return get_signature(raws.creatures.all);
+    default: return raws_signature();
+    }
+}
+
+static const string &get_raw_token(token_kind kind, int32_t i)
+{
+    df::world_raws &raws = world->raws;
+    switch (kind)
+    {
+    case TOKEN_INORGANIC: return raws.inorganics[i]->id;
+    case TOKEN_PLANT: return raws.plants.all[i]->id;
+    default: return raws.creatures.all[i]->creature_id;
+    }
+}
+
+static vector<df::material*> &get_raw_materials(token_kind kind, int32_t i)
+{
+    df::world_raws &raws = world->raws;
+    if (kind == TOKEN_PLANT)
+        return raws.plants.all[i]->material;
+    return raws.creatures.all[i]->material;
+}
+
+static string material_key(const string &token, const string &subtoken)
+{
+    string key;
+    key.reserve(token.size() + subtoken.size() + 1);
+    key += token;
+    key += ':';
+    key += subtoken;
+    return key;
+}
+
+// must be called with token_index.mutex held
+static void rebuild_token_index(token_kind kind)
+{
+    auto &ids = token_index.raws[kind];
+    token_index.signature[kind] = get_signature(kind);
+    token_index.materials[kind].clear();
+    token_index.materials_built[kind] = false;
+    ids.clear();
+
+    size_t count = token_index.signature[kind].size;
+    ids.reserve(count);
+    // emplace keeps the first of any duplicate ids, like the linear scans did
+    for (size_t i = 0; i < count; i++)
+        ids.emplace(get_raw_token(kind, i), int32_t(i));
+}
+
+// must be called with token_index.mutex held
+static void build_material_index(token_kind kind, int16_t base)
+{
+    auto &mats = token_index.materials[kind];
+    size_t count = token_index.signature[kind].size;
+    for (size_t i = 0; i < count; i++)
+    {
+        auto &material = get_raw_materials(kind, i);
+        const string &token = get_raw_token(kind, i);
+        for (size_t j = 0; j < material.size(); j++)
+            mats.emplace(material_key(token, material[j]->id), int16_t(base + j));
+    }
+    token_index.materials_built[kind] = true;
+}
+
+// must be called with token_index.mutex held
+static int32_t lookup_raw_index(token_kind kind, const string &token)
+{
+    if (!(token_index.signature[kind] == get_signature(kind)))
+        rebuild_token_index(kind);
+
+    auto &ids = token_index.raws[kind];
+    auto it = ids.find(token);
+    if (it == ids.end())
+        return -1;
+    if (get_raw_token(kind, it->second) == token)
+        return it->second;
+
+    // the raw was renamed under us; reindex and look again
+    rebuild_token_index(kind);
+    it = ids.find(token);
+    return it != ids.end() ? it->second : -1;
+}
+
+static int32_t find_raw_index(token_kind kind, const string &token)
+{
+    std::lock_guard<std::mutex> lock(token_index.mutex);
+    return lookup_raw_index(kind, token);
+}
+
+// returns the raw index, and the material type in *type (or -1 if the raw
+// exists but has no such material)
+static int32_t find_raw_material(token_kind kind, int16_t base,
+                                 const string &token, const string &subtoken, int16_t *type)
+{
+    std::lock_guard<std::mutex> lock(token_index.mutex);
+    *type = -1;
+
+    int32_t i = lookup_raw_index(kind, token);
+    if (i < 0)
+        return -1;
+
+    if (!token_index.materials_built[kind])
+        build_material_index(kind, base);
+
+    auto &mats = token_index.materials[kind];
+    auto &material = get_raw_materials(kind, i);
+    auto it = mats.find(material_key(token, subtoken));
+    if (it == mats.end())
+        return i;
+
+    size_t j = it->second - base;
+    if (j >= material.size() || material[j]->id != subtoken)
+    {
+        // the raw's materials changed under us; reindex and look again
+        mats.clear();
+        build_material_index(kind, base);
+        it = mats.find(material_key(token, subtoken));
+        if (it == mats.end())
+            return i;
+    }
+    *type = it->second;
+    return i;
+}
+
+void materials_onStateChange(color_ostream &out, state_change_event event)
+{
+    switch (event) {
+    case SC_WORLD_LOADED:
+    case SC_WORLD_UNLOADED:
+    {
+        // the raws are reloaded, possibly into vectors at the same addresses
+        std::lock_guard<std::mutex> lock(token_index.mutex);
+        for (int kind = 0; kind < NUM_TOKEN_KINDS; kind++)
+        {
+            token_index.signature[kind] = raws_signature();
+            token_index.raws[kind].clear();
+            token_index.materials[kind].clear();
+            token_index.materials_built[kind] = false;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
 bool MaterialInfo::findBuiltin(const std::string &token)
 {
     if (token.empty())
@@ -236,13 +444,9 @@ bool MaterialInfo::findInorganic(const std::string &token)
         return true;
     }
 
-    df::world_raws &raws = world->raws;
-    for (size_t i = 0; i < raws.inorganics.size(); i++)
-    {
-        df::inorganic_raw *p = raws.inorganics[i];
-        if (p->id == token)
-            return decode(0, i);
-    }
+    int32_t i = find_raw_index(TOKEN_INORGANIC, token);
+    if (i >= 0)
+        return decode(0, i);
     return decode(-1);
 }
 
@@ -250,23 +454,21 @@ bool MaterialInfo::findPlant(const std::string &token, const std::string &subtok
 {
     if (token.empty())
         return decode(-1);
-    df::world_raws &raws = world->raws;
-    for (size_t i = 0; i < raws.plants.all.size(); i++)
-    {
-        df::plant_raw *p = raws.plants.all[i];
-        if (p->id != token)
-            continue;
 
-        // As a special exception, return the structural material with empty subtoken
-        if (subtoken.empty())
-            return decode(p->material_defs.type[plant_material_def::basic_mat], p->material_defs.idx[plant_material_def::basic_mat]);
-
-        for (size_t j = 0; j < p->material.size(); j++)
-            if (p->material[j]->id == subtoken)
-                return decode(PLANT_BASE+j, i);
-
-        break;
+    // As a special exception, return the structural material with empty subtoken
+    if (subtoken.empty())
+    {
+        int32_t i = find_raw_index(TOKEN_PLANT, token);
+        if (i < 0)
+            return decode(-1);
+        df::plant_raw *p = world->raws.plants.all[i];
+        return decode(p->material_defs.type[plant_material_def::basic_mat], p->material_defs.idx[plant_material_def::basic_mat]);
     }
+
+    int16_t type;
+    int32_t i = find_raw_material(TOKEN_PLANT, PLANT_BASE, token, subtoken, &type);
+    if (type >= 0)
+        return decode(type, i);
     return decode(-1);
 }
 
@@ -274,20 +476,26 @@ bool MaterialInfo::findCreature(const std::string &token, const std::string &sub
 {
     if (token.empty() || subtoken.empty())
         return decode(-1);
-    df::world_raws &raws = world->raws;
-    for (size_t i = 0; i < raws.creatures.all.size(); i++)
-    {
-        df::creature_raw *p = raws.creatures.all[i];
-        if (p->creature_id != token)
-            continue;
 
-        for (size_t j = 0; j < p->material.size(); j++)
-            if (p->material[j]->id == subtoken)
-                return decode(CREATURE_BASE+j, i);
+    int16_t type;
+    int32_t i = find_raw_material(TOKEN_CREATURE, CREATURE_BASE, token, subtoken, &type);
+    if (type >= 0)
+        return decode(type, i);
+    return decode(-1);
+}
+
+size_t MaterialInfo::findAll(std::vector<MaterialInfo> *out, const std::vector<std::string> &tokens)
+{
+    CHECK_NULL_POINTER(out);
 
-        break;
+    size_t found = 0;
+    out->resize(tokens.size());
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+        if ((*out)[i].find(tokens[i]))
+            found++;
     }
-    return decode(-1);
+    return found;
 }
 
 bool MaterialInfo::findProduct(df::material *material, const std::string &name)
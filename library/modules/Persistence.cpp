@@ -34,6 +34,7 @@ distribution.
 
 #include <json/json.h>
 
+#include <cstring>
 #include <unordered_map>
 
 namespace DFHack {
@@ -74,27 +75,6 @@ struct Persistence::DataEntry {
         }
     }
 
-    Json::Value toJSON() const {
-        Json::Value json(Json::objectValue);
-        json["k"] = key;
-        if (fake_df_id < 0)
-            json["f"] = fake_df_id;
-        if (str_value.size())
-            json["s"] = str_value;
-        size_t num_set_ints = 0;
-        for (size_t i = 0; i < PersistentDataItem::NumInts; i++) {
-            if (int_values.at(i) != -1)
-                num_set_ints = i + 1;
-        }
-        if (num_set_ints) {
-            Json::Value ints(Json::arrayValue);
-            for (size_t i = 0; i < num_set_ints; i++)
-                ints.append(int_values.at(i));
-            json["i"] = std::move(ints);
-        }
-        return json;
-    }
-
     bool isReferencedBy(const PersistentDataItem & item) {
         return item.data.get() == this;
     }
@@ -149,8 +129,9 @@ int PersistentDataItem::fake_df_id() {
         return 0;
 
     // set it if unset
-    if (data->fake_df_id == 0)
+    if (data->fake_df_id == 0) {
         data->fake_df_id = next_fake_df_id--;
+    }
 
     return data->fake_df_id;
 }
@@ -180,24 +161,104 @@ static std::string getSaveFilePath(const std::string &world, const std::string &
     return getSavePath(world) + "/dfhack-" + filterSaveFileName(name) + ".dat";
 }
 
+/*
+ * Binary store format. All integers are little-endian base-128 varints;
+ * signed values are zigzag encoded first.
+ *
+ *   "DFHP" magic, format version, entry count
+ *   per entry: key length, key, fake df id, value length, value,
+ *              number of ints that differ from -1, then those ints
+ *
+ * Stores written by older versions are JSON arrays and are still read.
+ */
+static const char STORE_MAGIC[4] = {'D', 'F', 'H', 'P'};
+static const uint32_t STORE_VERSION = 1;
+
+static void put_varint(std::string &buf, uint64_t val) {
+    while (val >= 0x80) {
+        buf.push_back(char(val | 0x80));
+        val >>= 7;
+    }
+    buf.push_back(char(val));
+}
+
+static void put_sint(std::string &buf, int64_t val) {
+    put_varint(buf, (uint64_t(val) << 1) ^ uint64_t(val >> 63));
+}
+
+static void put_string(std::string &buf, const std::string &str) {
+    put_varint(buf, str.size());
+    buf.append(str);
+}
+
+static void serialize_store(std::string &buf,
+        const std::multimap<std::string, std::shared_ptr<Persistence::DataEntry>> &entries) {
+    size_t count = 0;
+    for (auto & entry : entries) {
+        if (entry.second != nullptr)
+            ++count;
+    }
+
+    buf.append(STORE_MAGIC, sizeof(STORE_MAGIC));
+    put_varint(buf, STORE_VERSION);
+    put_varint(buf, count);
+
+    for (auto & it : entries) {
+        auto & entry = it.second;
+        if (entry == nullptr)
+            continue;
+        put_string(buf, entry->key);
+        put_sint(buf, entry->fake_df_id);
+        put_string(buf, entry->str_value);
+        size_t num_set_ints = 0;
+        for (size_t i = 0; i < PersistentDataItem::NumInts; i++) {
+            if (entry->int_values.at(i) != -1)
+                num_set_ints = i + 1;
+        }
+        put_varint(buf, num_set_ints);
+        for (size_t i = 0; i < num_set_ints; i++)
+            put_sint(buf, entry->int_values.at(i));
+    }
+}
+
+// true if the file at path already holds exactly these bytes
+static bool file_matches(const std::string &path, const std::string &buf) {
+    Filesystem::MappedFile file(path);
+    return file.isOpen() && file.size() == buf.size() &&
+        (buf.empty() || !memcmp(file.data(), buf.data(), buf.size()));
+}
+
 void Persistence::Internal::save(color_ostream& out) {
     if (!Core::getInstance().isWorldLoaded())
         return;
 
     CoreSuspender suspend;
 
+    std::string buf;
     for (auto & entity_store_entry : store) {
         int entity_id = entity_store_entry.first;
-        Json::Value json(Json::arrayValue);
-        for (auto & entries : entity_store_entry.second) {
-            if (entries.second == nullptr)
-                continue;
-            json.append(entries.second->toJSON());
-        }
         std::string name = (entity_id == Persistence::WORLD_ENTITY_ID) ?
             "world" : "entity-" + int_to_string(entity_id);
-        auto file = std::ofstream(getSaveFilePath("current", name));
-        file << json;
+        std::string path = getSaveFilePath("current", name);
+
+        // references returned by val() and ival() can be written at any
+        // time, so changes are found by comparing the serialized store with
+        // the file in the save directory rather than by tracking writes
+        buf.clear();
+        serialize_store(buf, entity_store_entry.second);
+        if (file_matches(path, buf))
+            continue;
+
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(buf.data(), buf.size());
+            if (!file) {
+                out.printerr("Cannot save data to: '%s'\n", path.c_str());
+                continue;
+            }
+        }
+
+        DEBUG(persistence,out).print("saved %zu bytes to '%s'\n", buf.size(), path.c_str());
     }
 
     {
@@ -224,7 +285,81 @@ static void add_entry(int entity_id, std::shared_ptr<Persistence::DataEntry> ent
     add_entry(store[entity_id], entry);
 }
 
-static bool load_file(const std::string & path, int entity_id) {
+// Bounds-checked reader over a mapped store file
+struct StoreReader {
+    const uint8_t *pos;
+    const uint8_t *end;
+    bool ok = true;
+
+    uint64_t varint() {
+        uint64_t val = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= end)
+                break;
+            uint8_t byte = *pos++;
+            val |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return val;
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t sint() {
+        uint64_t val = varint();
+        return int64_t(val >> 1) ^ -int64_t(val & 1);
+    }
+
+    std::string text() {
+        uint64_t len = varint();
+        if (!ok || len > uint64_t(end - pos)) {
+            ok = false;
+            return std::string();
+        }
+        std::string str((const char *)pos, size_t(len));
+        pos += len;
+        return str;
+    }
+};
+
+static bool is_binary_store(const Filesystem::MappedFile & file) {
+    return file.size() >= sizeof(STORE_MAGIC) &&
+        !memcmp(file.data(), STORE_MAGIC, sizeof(STORE_MAGIC));
+}
+
+static bool load_binary_file(const Filesystem::MappedFile & file, int entity_id) {
+    StoreReader in{file.data() + sizeof(STORE_MAGIC), file.data() + file.size()};
+    if (in.varint() != STORE_VERSION || !in.ok)
+        return false;
+
+    uint64_t count = in.varint();
+    auto & entity_store_entry = store[entity_id];
+    for (uint64_t n = 0; n < count && in.ok; n++) {
+        std::string key = in.text();
+        int fake_df_id = int(in.sint());
+        std::string str_value = in.text();
+        uint64_t num_ints = in.varint();
+        if (!in.ok || num_ints > PersistentDataItem::NumInts)
+            return false;
+
+        std::shared_ptr<Persistence::DataEntry> entry(new Persistence::DataEntry(entity_id, key));
+        entry->fake_df_id = fake_df_id;
+        entry->str_value = std::move(str_value);
+        for (size_t i = 0; i < num_ints; i++)
+            entry->int_values.at(i) = int(in.sint());
+        if (!in.ok)
+            return false;
+        if (entry->key.empty())
+            continue;
+        // ensure fake DF IDs remain globally unique
+        next_fake_df_id = std::min(next_fake_df_id, entry->fake_df_id - 1);
+        add_entry(entity_store_entry, entry);
+    }
+
+    return in.ok;
+}
+
+static bool load_json_file(const std::string & path, int entity_id) {
     Json::Value json;
     try {
         std::ifstream file(path);
@@ -249,6 +384,15 @@ static bool load_file(const std::string & path, int entity_id) {
     return true;
 }
 
+static bool load_file(const std::string & path, int entity_id) {
+    Filesystem::MappedFile file(path);
+    if (!file.isOpen())
+        return false;
+    if (is_binary_store(file))
+        return load_binary_file(file, entity_id);
+    return load_json_file(path, entity_id);
+}
+
 void Persistence::Internal::load(color_ostream& out) {
     CoreSuspender suspend;
 
@@ -89,6 +89,7 @@ distribution.
 #include <algorithm>
 #include <numeric>
 #include <functional>
+#include <unordered_map>
 
 using std::string;
 using std::vector;
@@ -846,7 +847,118 @@ df::unit *Units::getUnit (const int32_t index)
     return vector_get(world->units.all, index);
 }
 
+static IdIndex<df::unit> unit_id_index;
+
+void Units::findUnitsByID(const std::vector<int32_t> &ids, std::vector<df::unit*> &units)
+{
+    unit_id_index.resolve(world->units.all, ids, units);
+}
+
 // returns index of creature actually read or -1 if no creature can be found
+// Every unit in world->units.all, bucketed by position. Core marks it stale
+// on every update, paused or not, and so does Units::teleport. The first
+// query after that is answered by scanning the unit list, as a lone query
+// is cheaper that way; a second one brings the grid up to date from
+// position deltas and uses it until it is marked stale again.
+namespace {
+    struct tracked_unit {
+        df::coord pos;  // last position, as stored in the grid
+        uint32_t pass;  // last refresh that found the unit in world->units.all
+        size_t order;   // index in world->units.all as of that refresh
+    };
+}
+
+static struct {
+    Maps::SpatialGrid<df::unit *> grid;
+    std::unordered_map<df::unit *, tracked_unit> tracked;
+    df::map_block ****block_index = NULL;
+    size_t num_units = 0;
+    uint32_t pass = 0;
+    bool stale = true;
+    bool scanned = false; // a query was answered by a scan since it was marked stale
+} unit_index;
+
+void Units::markUnitGridStale()
+{
+    unit_index.stale = true;
+    unit_index.scanned = false;
+}
+
+// returns NULL if the query should scan world->units.all instead
+static const Maps::SpatialGrid<df::unit *> *getUnitGrid()
+{
+    auto &index = unit_index;
+    auto &all = world->units.all;
+
+    if (index.block_index != world->map.block_index)
+    {
+        // new map: start over
+        index.grid.reset();
+        index.tracked.clear();
+        index.block_index = world->map.block_index;
+        index.stale = true;
+    }
+    else if (!index.stale && index.num_units == all.size())
+        return &index.grid;
+
+    if (!index.scanned)
+    {
+        index.scanned = true;
+        return NULL;
+    }
+
+    ++index.pass;
+    for (size_t i = 0; i < all.size(); i++)
+    {
+        auto unit = all[i];
+        auto [it, added] = index.tracked.try_emplace(unit, tracked_unit{ unit->pos, index.pass, i });
+        if (added)
+        {
+            index.grid.insert(unit, unit->pos);
+            continue;
+        }
+        if (it->second.pos != unit->pos)
+        {
+            index.grid.move(unit, it->second.pos, unit->pos);
+            it->second.pos = unit->pos;
+        }
+        it->second.pass = index.pass;
+        it->second.order = i;
+    }
+
+    // tracked is a superset of all, so equal sizes mean nothing was removed
+    if (index.tracked.size() != all.size())
+    {
+        for (auto it = index.tracked.begin(); it != index.tracked.end(); )
+        {
+            if (it->second.pass == index.pass)
+            {
+                ++it;
+                continue;
+            }
+            index.grid.remove(it->first, it->second.pos);
+            it = index.tracked.erase(it);
+        }
+    }
+
+    index.num_units = all.size();
+    index.stale = false;
+    return &index.grid;
+}
+
+// puts units found in the grid, which come out in bucket order, into the
+// world->units.all order that the scans return them in
+static void sortInUnitOrder(std::vector<df::unit*> &units)
+{
+    std::vector<std::pair<size_t, df::unit *>> ordered;
+    ordered.reserve(units.size());
+    for (auto unit : units)
+        ordered.emplace_back(unit_index.tracked.at(unit).order, unit);
+    std::sort(ordered.begin(), ordered.end());
+    for (size_t i = 0; i < ordered.size(); i++)
+        units[i] = ordered[i].second;
+}
+
 bool Units::getUnitsInBox (std::vector<df::unit*> &units,
     int16_t x1, int16_t y1, int16_t z1,
     int16_t x2, int16_t y2, int16_t z2)
@@ -855,13 +967,73 @@ bool Units::getUnitsInBox (std::vector<df::unit*> &units,
         return false;
 
     units.clear();
-    for (df::unit *u : world->units.all)
+    auto grid = getUnitGrid();
+    if (!grid)
     {
-        if (isUnitInBox(u, x1, y1, z1, x2, y2, z2))
-        {
-            units.push_back(u);
-        }
+        for (auto unit : world->units.all)
+            if (isUnitInBox(unit, x1, y1, z1, x2, y2, z2))
+                units.push_back(unit);
+        return true;
+    }
+
+    grid->forEachInBox(df::coord(x1, y1, z1), df::coord(x2, y2, z2),
+        [&](df::unit *unit, df::coord) { units.push_back(unit); });
+    sortInUnitOrder(units);
+    return true;
+}
+
+bool Units::getUnitsInRadius(std::vector<df::unit*> &units, df::coord center, int radius)
+{
+    if (!world)
+        return false;
+
+    units.clear();
+    auto grid = getUnitGrid();
+    if (!grid)
+    {
+        typedef Maps::SpatialGrid<df::unit *> Grid;
+        for (auto unit : world->units.all)
+            if (Maps::isValidTilePos(unit->pos) && Grid::distance(center, unit->pos) <= radius)
+                units.push_back(unit);
+        return true;
     }
+
+    grid->forEachInRadius(center, radius,
+        [&](df::unit *unit, df::coord) { units.push_back(unit); });
+    sortInUnitOrder(units);
+    return true;
+}
+
+bool Units::getNearestUnits(std::vector<df::unit*> &units, df::coord center, size_t count,
+    std::function<bool(df::unit*)> filter)
+{
+    if (!world)
+        return false;
+
+    units.clear();
+    auto grid = getUnitGrid();
+    if (!grid)
+    {
+        if (!Maps::isValidTilePos(center))
+            return true;
+        typedef Maps::SpatialGrid<df::unit *> Grid;
+        std::vector<std::pair<int, df::unit *>> found;
+        for (auto unit : world->units.all)
+            if (Maps::isValidTilePos(unit->pos) && (!filter || filter(unit)))
+                found.emplace_back(Grid::distance(center, unit->pos), unit);
+        count = std::min(count, found.size());
+        std::partial_sort(found.begin(), found.begin() + count, found.end());
+        for (size_t i = 0; i < count; i++)
+            units.push_back(found[i].second);
+        return true;
+    }
+
+    std::vector<std::pair<df::unit *, df::coord>> found;
+    grid->nearest(center, count, found, [&](df::unit *unit, df::coord) {
+        return !filter || filter(unit);
+    });
+    for (auto &entry : found)
+        units.push_back(entry.first);
     return true;
 }
 
@@ -979,6 +1151,7 @@ bool Units::teleport(df::unit *unit, df::coord target_pos)
     // move unit to destination
     unit->pos = target_pos;
     unit->idle_area = target_pos;
+    markUnitGridStale();
 
     // move unit's riders (including babies) to destination
     if (unit->flags1.bits.ridden)
@@ -25,7 +25,10 @@ distribution.
 
 #include "Internal.h"
 
+#include "Error.h"
+
 #include "modules/Gui.h"
+#include "modules/Maps.h"
 #include "modules/Translation.h"
 #include "modules/Units.h"
 #include "modules/World.h"
@@ -41,6 +44,9 @@ distribution.
 #include "df/world_data.h"
 #include "df/world_site.h"
 
+#include <algorithm>
+#include <unordered_map>
+
 using std::string;
 
 using namespace DFHack;
@@ -286,6 +292,83 @@ bool World::DeletePersistentData(const PersistentDataItem &item) {
     return Persistence::deleteItem(item);
 }
 
+/*
+ * Lookups of (persistent item, block) -> tilemask event. Overlays resolve the
+ * same masks for every tile they draw, every frame, and finding one means a
+ * scan of the block events with a virtual cast for each. The cache remembers
+ * where in block_events the mask was found (or that it was absent), and an
+ * entry is only trusted while the block event vector has the same storage and
+ * size and still holds the same event at that position.
+ */
+
+namespace {
+    struct tilemask_key {
+        int id;
+        df::map_block *block;
+
+        bool operator== (const tilemask_key &other) const {
+            return id == other.id && block == other.block;
+        }
+    };
+
+    struct tilemask_key_hash {
+        size_t operator() (const tilemask_key &key) const {
+            return std::hash<df::map_block*>()(key.block) ^ (size_t(key.id) * 0x9E3779B97F4A7C15ULL);
+        }
+    };
+
+    struct tilemask_entry {
+        df::block_square_event * const *events; // block_events storage when cached
+        size_t num_events;
+        int index; // position of the mask event, or -1 if there was none
+        df::block_square_event_world_constructionst *event;
+    };
+}
+
+static std::unordered_map<tilemask_key, tilemask_entry, tilemask_key_hash> tilemask_cache;
+
+void world_onStateChange(color_ostream &out, state_change_event event)
+{
+    switch (event) {
+    case SC_MAP_UNLOADED:
+    case SC_WORLD_UNLOADED:
+        // blocks are freed, and their addresses may be reused by the next map
+        tilemask_cache.clear();
+        break;
+    default:
+        break;
+    }
+}
+
+static df::block_square_event_world_constructionst *findTilemaskEvent(df::map_block *block, int id) {
+    auto &events = block->block_events;
+    tilemask_key key = { id, block };
+
+    auto it = tilemask_cache.find(key);
+    if (it != tilemask_cache.end()) {
+        auto &entry = it->second;
+        if (entry.events == events.data() && entry.num_events == events.size() &&
+                (entry.index < 0 || events[entry.index] == entry.event))
+            return entry.event;
+    }
+
+    tilemask_entry entry = { events.data(), events.size(), -1, NULL };
+    for (size_t i = 0; i < events.size(); i++) {
+        auto ev = events[i];
+        if (ev->getType() != block_square_event_type::world_construction)
+            continue;
+        auto wcsev = strict_virtual_cast<df::block_square_event_world_constructionst>(ev);
+        if (!wcsev || wcsev->construction_id != id)
+            continue;
+        entry.index = i;
+        entry.event = wcsev;
+        break;
+    }
+
+    tilemask_cache[key] = entry;
+    return entry.event;
+}
+
 df::tile_bitmask *World::getPersistentTilemask(PersistentDataItem &item, df::map_block *block, bool create) {
     if (!block)
         return NULL;
@@ -294,14 +377,8 @@ df::tile_bitmask *World::getPersistentTilemask(PersistentDataItem &item, df::map
     if (id > -100)
         return NULL;
 
-    for (auto ev : block->block_events) {
-        if (ev->getType() != block_square_event_type::world_construction)
-            continue;
-        auto wcsev = strict_virtual_cast<df::block_square_event_world_constructionst>(ev);
-        if (!wcsev || wcsev->construction_id != id)
-            continue;
+    if (auto wcsev = findTilemaskEvent(block, id))
         return &wcsev->tile_bitmask;
-    }
 
     if (!create)
         return NULL;
@@ -313,10 +390,41 @@ df::tile_bitmask *World::getPersistentTilemask(PersistentDataItem &item, df::map
     ev->construction_id = id;
     ev->tile_bitmask.clear();
     vector_insert_at(block->block_events, 0, (df::block_square_event*)ev);
+    tilemask_cache.erase({ id, block });
 
     return &ev->tile_bitmask;
 }
 
+df::tile_bitmask *World::PersistentTilemaskArea::get(const df::coord &pos) const {
+    int bx = (pos.x >> 4) - min_block.x;
+    int by = (pos.y >> 4) - min_block.y;
+    if (pos.z != min_block.z || bx < 0 || by < 0 || bx >= width || by >= height)
+        return NULL;
+    return masks[bx + by * width];
+}
+
+bool World::PersistentTilemaskArea::getassignment(const df::coord &pos) const {
+    auto mask = get(pos);
+    return mask && mask->getassignment(pos);
+}
+
+void World::getPersistentTilemasks(PersistentTilemaskArea *area, PersistentDataItem &item,
+                                   const df::coord &min, const df::coord &max) {
+    CHECK_NULL_POINTER(area);
+
+    area->min_block = df::coord(std::max(0, int(min.x)) >> 4, std::max(0, int(min.y)) >> 4, min.z);
+    area->width = std::max(0, (max.x >> 4) - area->min_block.x + 1);
+    area->height = std::max(0, (max.y >> 4) - area->min_block.y + 1);
+    area->masks.assign(area->width * area->height, NULL);
+
+    for (int by = 0; by < area->height; by++) {
+        for (int bx = 0; bx < area->width; bx++) {
+            auto block = Maps::getBlock(area->min_block.x + bx, area->min_block.y + by, min.z);
+            area->masks[bx + by * area->width] = getPersistentTilemask(item, block);
+        }
+    }
+}
+
 bool World::deletePersistentTilemask(PersistentDataItem &item, df::map_block *block) {
     if (!block)
         return false;
@@ -339,5 +447,9 @@ bool World::deletePersistentTilemask(PersistentDataItem &item, df::map_block *bl
         found = true;
     }
 
+    // the cached event pointer is dangling now, and its address may be
+    // reused by the next event inserted into the block
+    tilemask_cache.erase({ id, block });
+
     return found;
 }
@@ -119,24 +119,10 @@ struct ClothingRequirement
         std::stringstream stream(s);
         string loadedJob;
         stream >> loadedJob;
-        FOR_ENUM_ITEMS(job_type, job)
-        {
-            if (ENUM_KEY_STR(job_type, job) == loadedJob)
-            {
-                jobType = job;
-                break;
-            }
-        }
+        find_enum_item(&jobType, loadedJob);
         string loadedItem;
         stream >> loadedItem;
-        FOR_ENUM_ITEMS(item_type, item)
-        {
-            if (ENUM_KEY_STR(item_type, item) == loadedItem)
-            {
-                itemType = item;
-                break;
-            }
-        }
+        find_enum_item(&itemType, loadedItem);
         stream >> item_subtype;
         stream >> material_category.whole;
         stream >> needed_per_citizen;
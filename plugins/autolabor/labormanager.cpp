@@ -9,11 +9,14 @@
 #include <Export.h>
 #include <PluginManager.h>
 
+#include <cinttypes>
 #include <vector>
 #include <algorithm>
 #include <queue>
 #include <map>
 #include <iterator>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "modules/Units.h"
 #include "modules/World.h"
@@ -94,6 +97,44 @@ static bool pause_on_error = 1;
 
 static std::vector<int> state_count(5);
 
+// wall time spent in each phase of the labor cycle, reported by "labormanager timing"
+enum cycle_phase {
+    PHASE_BUILDINGS,
+    PHASE_DESIGNATIONS,
+    PHASE_JOBS,
+    PHASE_ITEMS,
+    PHASE_INDICES,
+    PHASE_DWARFS,
+    PHASE_ASSIGN,
+    NUM_PHASES
+};
+
+static const char * const phase_names[NUM_PHASES] = {
+    "buildings",
+    "designations",
+    "jobs",
+    "items",
+    "indices",
+    "dwarfs",
+    "assignment",
+};
+
+struct phase_timing {
+    uint64_t last_ns = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+static phase_timing phase_timings[NUM_PHASES];
+static uint64_t timed_cycles = 0;
+
+static void reset_timing()
+{
+    for (auto &timing : phase_timings)
+        timing = phase_timing();
+    timed_cycles = 0;
+}
+
 static PersistentDataItem config;
 
 enum ConfigFlags {
@@ -345,6 +386,8 @@ static void init_state()
     if (!enable_labormanager)
         return;
 
+    reset_timing();
+
     // Load labors from save
     labor_infos.resize(ARRAY_COUNT(default_labor_infos));
 
@@ -657,6 +700,13 @@ private:
     std::list<dwarf_info_t*> available_dwarfs;
     std::list<dwarf_info_t*> busy_dwarfs;
 
+    // relationship indices, rebuilt once per cycle so the per-dwarf pass
+    // doesn't have to rescan all units and activities for every dwarf
+    std::unordered_set<int32_t> mothers_of_minors;
+    std::unordered_map<df::unit*, std::vector<df::activity_info*>> meetings_by_unit;
+
+    uint64_t phase_start_ns;
+
 private:
     void set_labor(dwarf_info_t* dwarf, df::unit_labor labor, bool value)
     {
@@ -894,6 +944,43 @@ private:
 
     }
 
+    void build_indices()
+    {
+        mothers_of_minors.clear();
+        meetings_by_unit.clear();
+
+        for (auto u : world->units.active)
+        {
+            if ((u->profession == df::profession::CHILD || u->profession == df::profession::BABY) &&
+                Units::isActive(u))
+            {
+                int32_t mother_id = u->relationship_ids[df::unit_relationship_type::Mother];
+                if (mother_id != -1)
+                    mothers_of_minors.insert(mother_id);
+            }
+        }
+
+        for (auto act : plotinfo->activities)
+        {
+            if (!act)
+                continue;
+            if (act->unit_actor)
+                meetings_by_unit[act->unit_actor].push_back(act);
+            if (act->unit_noble && act->unit_noble != act->unit_actor)
+                meetings_by_unit[act->unit_noble].push_back(act);
+        }
+    }
+
+    void end_phase(cycle_phase phase)
+    {
+        uint64_t now = PerfCounters::getTimestampNs();
+        phase_timing &timing = phase_timings[phase];
+        timing.last_ns = now - phase_start_ns;
+        timing.total_ns += timing.last_ns;
+        timing.max_ns = std::max(timing.max_ns, timing.last_ns);
+        phase_start_ns = now;
+    }
+
     void collect_dwarf_list()
     {
         state_count.clear();
@@ -944,22 +1031,18 @@ private:
 
                 // identify dwarfs who are needed for meetings and mark them for exclusion
 
-                for (size_t i = 0; i < plotinfo->activities.size(); ++i)
+                auto meetings = meetings_by_unit.find(dwarf->dwarf);
+                if (meetings != meetings_by_unit.end())
                 {
-                    df::activity_info *act = plotinfo->activities[i];
-                    if (!act) continue;
-
-                    bool p1 = act->unit_actor == dwarf->dwarf;
-                    bool p2 = act->unit_noble == dwarf->dwarf;
-
-                    if (p1 || p2)
+                    for (df::activity_info *act : meetings->second)
                     {
-                        df::unit* other = p1 ? act->unit_noble : act->unit_actor;
+                        df::unit* other = (act->unit_actor == dwarf->dwarf) ? act->unit_noble : act->unit_actor;
                         if (other && !(!Units::isActive(other) ||
                                        (other->job.current_job &&
                                             (other->job.current_job->job_type == df::job_type::Sleep ||
                                              other->job.current_job->job_type == df::job_type::Rest)) ||
-                                       ENUM_ATTR(profession, military, other->profession)))                        {
+                                       ENUM_ATTR(profession, military, other->profession)))
+                        {
                             dwarf->clear_all = true;
                             if (print_debug)
                                 out.print("Dwarf \"%s\" has a meeting, will be cleared of all labors\n", dwarf->dwarf->name.first_name.c_str());
@@ -975,17 +1058,11 @@ private:
 
                 // check to see if dwarf has minor children
 
-                for (auto u2 = world->units.active.begin(); u2 != world->units.active.end(); ++u2)
+                if (mothers_of_minors.count(dwarf->dwarf->id))
                 {
-                    if ((*u2)->relationship_ids[df::unit_relationship_type::Mother] == dwarf->dwarf->id &&
-                        Units::isActive(*u2) &&
-                        ((*u2)->profession == df::profession::CHILD || (*u2)->profession == df::profession::BABY))
-                    {
-                        dwarf->has_children = true;
-                        if (print_debug)
-                            out.print("Dwarf %s has minor children\n", dwarf->dwarf->name.first_name.c_str());
-                        break;
-                    }
+                    dwarf->has_children = true;
+                    if (print_debug)
+                        out.print("Dwarf %s has minor children\n", dwarf->dwarf->name.first_name.c_str());
                 }
 
                 // check if dwarf has an axe, pick, or crossbow
@@ -1321,25 +1398,37 @@ public:
             labor_infos[l].active_dwarfs = labor_infos[l].busy_dwarfs = labor_infos[l].idle_dwarfs = 0;
         }
 
+        phase_start_ns = PerfCounters::getTimestampNs();
+
         // scan for specific buildings of interest
 
         scan_buildings();
+        end_phase(PHASE_BUILDINGS);
 
         // count number of squares designated for dig, wood cutting, detailing, and plant harvesting
 
         count_map_designations();
+        end_phase(PHASE_DESIGNATIONS);
 
         // collect current job list
 
         collect_job_list();
+        end_phase(PHASE_JOBS);
 
         // count number of picks and axes available for use
 
         count_tools();
+        end_phase(PHASE_ITEMS);
+
+        // index children and meetings for the dwarf pass
+
+        build_indices();
+        end_phase(PHASE_INDICES);
 
         // collect list of dwarfs
 
         collect_dwarf_list();
+        end_phase(PHASE_DWARFS);
 
         // add job entries for designation-related jobs
 
@@ -1852,6 +1941,9 @@ public:
 
         release_dwarf_list();
 
+        end_phase(PHASE_ASSIGN);
+        timed_cycles++;
+
         if (labors_changed)
         {
             *df::global::process_dig = true;
@@ -1937,6 +2029,29 @@ void print_labor(df::unit_labor labor, color_ostream &out)
         << endl;
 }
 
+static void print_timing(color_ostream &out)
+{
+    if (!timed_cycles)
+    {
+        out << "No labor cycles have run yet." << endl;
+        return;
+    }
+
+    out.print("Phase timings over %" PRIu64 " cycle(s):\n", timed_cycles);
+    out.print("%-14s %10s %10s %10s\n", "phase", "last ms", "avg ms", "max ms");
+
+    uint64_t last_total = 0, sum_total = 0;
+    for (int i = 0; i < NUM_PHASES; i++)
+    {
+        const phase_timing &timing = phase_timings[i];
+        out.print("%-14s %10.3f %10.3f %10.3f\n", phase_names[i],
+            timing.last_ns / 1e6, timing.total_ns / 1e6 / timed_cycles, timing.max_ns / 1e6);
+        last_total += timing.last_ns;
+        sum_total += timing.total_ns;
+    }
+    out.print("%-14s %10.3f %10.3f\n", "total", last_total / 1e6, sum_total / 1e6 / timed_cycles);
+}
+
 df::unit_labor lookup_labor_by_name(std::string name)
 {
     // We should accept incorrect casing, there is no ambiguity.
@@ -2113,6 +2228,20 @@ command_result labormanager(color_ostream &out, std::vector <std::string> & para
 
         return CR_OK;
     }
+    else if ((parameters.size() == 1 || parameters.size() == 2) && parameters[0] == "timing")
+    {
+        if (parameters.size() == 2 && parameters[1] == "reset")
+        {
+            reset_timing();
+            out << "Phase timings reset." << endl;
+            return CR_OK;
+        }
+        if (parameters.size() == 2)
+            return CR_WRONG_USAGE;
+
+        print_timing(out);
+        return CR_OK;
+    }
     else if (parameters.size() == 2 && parameters[0] == "pause-on-error")
     {
         if (!enable_labormanager)
@@ -5,7 +5,13 @@
  * Written by cdombroski.
  */
 
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
 
 #include "Console.h"
@@ -41,6 +47,7 @@
 #include "df/world.h"
 
 using std::endl;
+using std::ifstream;
 using std::ofstream;
 using std::pair;
 using std::map;
@@ -151,29 +158,86 @@ DFhackCExport command_result plugin_shutdown(color_ostream &) {
     return CR_OK;
 }
 
+// the map state that is shared by all phases of one z-level. it is captured
+// on the main thread before the phases are processed in parallel.
+struct level_snapshot {
+    df::coord start;
+    int32_t width = 0;
+    int32_t height = 0;
+    vector<df::building *> buildings; // empty if no phase needs buildings
+
+    df::building * building_at(const df::coord &pos) const {
+        if (buildings.empty())
+            return Buildings::findAtTile(pos);
+        return buildings[(pos.y - start.y) * width + (pos.x - start.x)];
+    }
+};
+
 struct blueprint_processor;
 struct tile_context {
     blueprint_processor *processor;
+    const level_snapshot *snapshot = NULL;
     bool pretty = false;
     df::building* b = NULL;
 };
 
 typedef vector<const char *> bp_row;     // index is x coordinate
 typedef map<int16_t, bp_row> bp_area;    // key is y coordinate
-typedef map<int16_t, bp_area> bp_volume; // key is z coordinate
+
+// backing store for the strings that are generated while a z-level is being
+// processed. the strings stay valid until the level has been written out and
+// the arena is reset.
+class string_arena {
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    vector<std::unique_ptr<char[]>> blocks;
+    std::deque<string> oversized;
+    size_t used = BLOCK_SIZE; // bytes used in blocks.back()
+public:
+    const char * intern(const char *str) {
+        size_t len = strlen(str) + 1;
+        if (len > BLOCK_SIZE) {
+            oversized.emplace_back(str);
+            return oversized.back().c_str();
+        }
+        if (used + len > BLOCK_SIZE) {
+            blocks.emplace_back(new char[BLOCK_SIZE]);
+            used = 0;
+        }
+        char *ret = blocks.back().get() + used;
+        memcpy(ret, str, len);
+        used += len;
+        return ret;
+    }
+
+    // drops all strings but keeps the first block around for the next level
+    void reset() {
+        if (blocks.size() > 1)
+            blocks.resize(1);
+        used = blocks.empty() ? BLOCK_SIZE : 0;
+        oversized.clear();
+    }
+};
 
 typedef const char * (get_tile_fn)(const df::coord &pos,
                                    const tile_context &ctx);
 typedef void (init_ctx_fn)(const df::coord &pos, tile_context &ctx);
 
 struct blueprint_processor {
-    bp_volume mapdata;
+    bp_area level; // the rows of the z-level that is being processed
+    string_arena strings;
     const string mode;
     const string phase;
     const bool force_create;
     get_tile_fn * const get_tile;
     init_ctx_fn * const init_ctx;
     std::set<df::building *> seen;
+
+    // processed levels are streamed to this file and copied into the real
+    // blueprint file once we know which phases end up in which file
+    string spill_fname;
+    ofstream spill;
+    bool has_data = false;
+    int16_t zprev = 0; // for the minimal format, the last level written
     blueprint_processor(const string &mode, const string &phase,
                         bool force_create, get_tile_fn *get_tile,
                         init_ctx_fn *init_ctx)
@@ -181,7 +245,7 @@ struct blueprint_processor {
           get_tile(get_tile), init_ctx(init_ctx) { }
 };
 
-// global caches, cleared when the string cache is cleared
+// global caches, read-only while the phases are being processed
 static std::unordered_map<df::coord, df::engraving *> engravings_cache;
 static std::unordered_map<df::coord, df::job *> dig_job_cache;
 static PersistentDataItem warm_config, damp_config;
@@ -213,27 +277,22 @@ static void init_caches(DFHack::color_ostream &out, bool cache_engravings) {
     });
 }
 
+static void clear_caches() {
+    engravings_cache.clear();
+    dig_job_cache.clear();
+}
+
 // We use const char * throughout this code instead of std::string to avoid
 // having to allocate memory for all the small string literals. This
 // significantly speeds up processing and allows us to handle very large maps
-// (e.g. 16x16 embarks) without running out of memory. This cache provides a
-// mechanism for storing dynamically created strings so their memory stays
-// allocated until we write out the blueprints at the end.
-// If NULL is passed as the str, the cache is cleared.
+// (e.g. 16x16 embarks) without running out of memory. Dynamically created
+// strings are stored in the arena of the phase that is being processed on
+// the current thread, so their memory stays allocated until the current
+// z-level has been written out.
+static thread_local string_arena *current_arena = NULL;
+
 static const char * cache(const char *str) {
-    // this local static assumes that no two blueprints are being generated at
-    // the same time, which is currently ensured by the higher-level DFHack
-    // command handling code. if this assumption ever becomes untrue, we'll
-    // need to protect the cache with thread synchronization primitives or make
-    // the cache per-blueprint.
-    static std::set<string> _cache;
-    if (!str) {
-        _cache.clear();
-        engravings_cache.clear();
-        dig_job_cache.clear();
-        return NULL;
-    }
-    return _cache.emplace(str).first->c_str();
+    return current_arena->intern(str);
 }
 
 // Convenience wrapper for std::string.
@@ -246,6 +305,8 @@ static const char * cache(std::ostringstream &str) {
     return cache(str.str());
 }
 
+// World::getPersistentTilemask updates a shared lookup cache, so this must only
+// be called from one phase (dig)
 static const char * add_markers(const df::coord &pos, const char *sym) {
     if (!sym)
         return NULL;
@@ -340,7 +401,7 @@ static const char * get_tile_dig(const df::coord &pos, const tile_context &) {
     if (td && td->bits.dig != df::tile_dig_designation::No)
         return add_markers(pos, get_tile_dig_designation(pos, td->bits.dig));
     if (dig_job_cache.contains(pos))
-        if (const char * ret = get_tile_dig_job(td, dig_job_cache[pos]))
+        if (const char * ret = get_tile_dig_job(td, dig_job_cache.at(pos)))
             return add_markers(pos, ret);
 
     auto tt = Maps::getTileType(pos);
@@ -376,7 +437,7 @@ static const char * get_tile_dig(const df::coord &pos, const tile_context &) {
 
 static const char * get_tile_smooth_minimal(const df::coord &pos,
                                             const tile_context &) {
-    if (dig_job_cache.contains(pos) && dig_job_cache[pos]->job_type == df::job_type::CarveFortification)
+    if (dig_job_cache.contains(pos) && dig_job_cache.at(pos)->job_type == df::job_type::CarveFortification)
         return "s";
 
     auto tt = Maps::getTileType(pos);
@@ -406,8 +467,8 @@ static const char * get_tile_smooth_with_engravings(const df::coord &pos,
         return smooth_minimal;
 
     if (dig_job_cache.contains(pos) &&
-            (dig_job_cache[pos]->job_type == df::job_type::DetailFloor ||
-             dig_job_cache[pos]->job_type == df::job_type::DetailWall))
+            (dig_job_cache.at(pos)->job_type == df::job_type::DetailFloor ||
+             dig_job_cache.at(pos)->job_type == df::job_type::DetailWall))
         return "s";
 
     if (auto td = Maps::getTileDesignation(pos); td && td->bits.smooth == 2)
@@ -439,8 +500,8 @@ static const char * get_tile_smooth_all(const df::coord &pos,
         return smooth_minimal;
 
     if (dig_job_cache.contains(pos) &&
-            (dig_job_cache[pos]->job_type == df::job_type::SmoothFloor ||
-             dig_job_cache[pos]->job_type == df::job_type::SmoothWall))
+            (dig_job_cache.at(pos)->job_type == df::job_type::SmoothFloor ||
+             dig_job_cache.at(pos)->job_type == df::job_type::SmoothWall))
         return "s";
 
     if (auto td = Maps::getTileDesignation(pos); td && td->bits.smooth == 1)
@@ -489,7 +550,7 @@ static const char * get_tile_carve_minimal(const df::coord &pos,
         return NULL;
 
     if (dig_job_cache.contains(pos)) {
-        df::job *job = dig_job_cache[pos];
+        df::job *job = dig_job_cache.at(pos);
         switch (job->job_type) {
         case df::job_type::CarveTrack:
             switch (tileShape(*tt))
@@ -540,8 +601,8 @@ static const char * get_tile_carve(const df::coord &pos, const tile_context &tc)
         return tile_carve_minimal;
 
     if (dig_job_cache.contains(pos) &&
-            (dig_job_cache[pos]->job_type == df::job_type::DetailFloor ||
-             dig_job_cache[pos]->job_type == df::job_type::DetailWall))
+            (dig_job_cache.at(pos)->job_type == df::job_type::DetailFloor ||
+             dig_job_cache.at(pos)->job_type == df::job_type::DetailWall))
         return "e";
 
     if (auto td = Maps::getTileDesignation(pos); td && td->bits.smooth == 2)
@@ -1340,60 +1401,53 @@ static bool is_meta_phase(color_ostream &out,
     return ret;
 }
 
-static void write_minimal(ofstream &ofile, const blueprint_options &opts,
-                          const bp_volume &mapdata) {
-    if (mapdata.begin() == mapdata.end())
-        return;
-
+// writes one non-empty z-level. zprev is the index of the last written level
+// and is carried over between calls.
+static void write_minimal_level(ofstream &ofile, const blueprint_options &opts,
+                                int16_t z, const bp_area &area,
+                                int16_t &zprev) {
     const string z_key = opts.depth > 0 ? "#<" : "#>";
 
-    int16_t zprev = 0;
-    for (auto area : mapdata) {
-        for ( ; zprev < area.first; ++zprev)
-            ofile << z_key << endl;
-        int16_t yprev = 0;
-        for (auto row : area.second) {
-            for ( ; yprev < row.first; ++yprev)
-                ofile << endl;
-            size_t xprev = 0;
-            auto &tiles = row.second;
-            size_t rowsize = tiles.size();
-            for (size_t x = 0; x < rowsize; ++x) {
-                if (!tiles[x])
-                    continue;
-                for ( ; xprev < x; ++xprev)
-                    ofile << ",";
-                ofile << tiles[x];
-            }
+    for ( ; zprev < z; ++zprev)
+        ofile << z_key << endl;
+    int16_t yprev = 0;
+    for (auto &row : area) {
+        for ( ; yprev < row.first; ++yprev)
+            ofile << endl;
+        size_t xprev = 0;
+        auto &tiles = row.second;
+        size_t rowsize = tiles.size();
+        for (size_t x = 0; x < rowsize; ++x) {
+            if (!tiles[x])
+                continue;
+            for ( ; xprev < x; ++xprev)
+                ofile << ",";
+            ofile << tiles[x];
         }
-        ofile << endl;
     }
+    ofile << endl;
 }
 
-static void write_pretty(ofstream &ofile, const blueprint_options &opts,
-                         const bp_volume &mapdata) {
+// writes one z-level, which may be empty
+static void write_pretty_level(ofstream &ofile, const blueprint_options &opts,
+                               int16_t z, const bp_area &area) {
     const string z_key = opts.depth > 0 ? "#<" : "#>";
 
     int16_t absdepth = abs(opts.depth);
-    for (int16_t z = 0; z < absdepth; ++z) {
-        const bp_area *area = NULL;
-        if (mapdata.count(z))
-            area = &mapdata.at(z);
-        for (int16_t y = 0; y < opts.height; ++y) {
-            const bp_row *row = NULL;
-            if (area && area->count(y))
-                row = &area->at(y);
-            for (int16_t x = 0; x < opts.width; ++x) {
-                const char *tile = NULL;
-                if (row)
-                    tile = row->at(x);
-                ofile << (tile ? tile : " ") << ",";
-            }
-            ofile << "#" << endl;
+    for (int16_t y = 0; y < opts.height; ++y) {
+        const bp_row *row = NULL;
+        if (area.count(y))
+            row = &area.at(y);
+        for (int16_t x = 0; x < opts.width; ++x) {
+            const char *tile = NULL;
+            if (row)
+                tile = row->at(x);
+            ofile << (tile ? tile : " ") << ",";
         }
-        if (z < absdepth - 1)
-            ofile << z_key << endl;
+        ofile << "#" << endl;
     }
+    if (z < absdepth - 1)
+        ofile << z_key << endl;
 }
 
 static string get_modeline(color_ostream &out, const blueprint_options &opts,
@@ -1418,7 +1472,7 @@ static bool write_blueprint(color_ostream &out,
                             std::map<string, ofstream*> &output_files,
                             const blueprint_options &opts,
                             const blueprint_processor &processor,
-                            bool pretty, int32_t ordinal) {
+                            int32_t ordinal) {
     string fname;
     if (!get_filename(fname, out, opts, processor.phase, ordinal))
         return false;
@@ -1428,10 +1482,14 @@ static bool write_blueprint(color_ostream &out,
     ofstream &ofile = *output_files[fname];
     ofile << get_modeline(out, opts, processor.mode, processor.phase) << endl;
 
-    if (pretty)
-        write_pretty(ofile, opts, processor.mapdata);
-    else
-        write_minimal(ofile, opts, processor.mapdata);
+    ifstream spill(processor.spill_fname, ifstream::binary);
+    if (!spill) {
+        out.printerr("could not read temporary file: '%s'\n",
+                     processor.spill_fname.c_str());
+        return false;
+    }
+    if (spill.peek() != ifstream::traits_type::eof())
+        ofile << spill.rdbuf();
 
     return true;
 }
@@ -1461,7 +1519,7 @@ static void write_meta_blueprint(color_ostream &out,
 static void ensure_building(const df::coord &pos, tile_context &ctx) {
     if (ctx.b)
         return;
-    ctx.b = Buildings::findAtTile(pos);
+    ctx.b = ctx.snapshot->building_at(pos);
 }
 
 static void add_processor(vector<blueprint_processor> &processors,
@@ -1474,14 +1532,144 @@ static void add_processor(vector<blueprint_processor> &processors,
                                                  get_tile, init_ctx));
 }
 
+// runs one phase over one z-level and streams the result to the phase's spill
+// file. called in parallel for all phases, so it must not touch anything that
+// another phase could write to.
+static void process_level(blueprint_processor &processor,
+                          const level_snapshot &snapshot,
+                          const blueprint_options &opts, bool pretty,
+                          int16_t zidx) {
+    // empty map instance to pass to emplace() below
+    static const bp_row EMPTY_ROW;
+
+    current_arena = &processor.strings;
+    const df::coord &start = snapshot.start;
+    for (int32_t y = 0; y < snapshot.height; y++) {
+        for (int32_t x = 0; x < snapshot.width; x++) {
+            df::coord pos(start.x + x, start.y + y, start.z);
+            tile_context ctx;
+            ctx.pretty = pretty;
+            ctx.processor = &processor;
+            ctx.snapshot = &snapshot;
+            if (processor.init_ctx)
+                processor.init_ctx(pos, ctx);
+            const char *tile_str = processor.get_tile(pos, ctx);
+            if (tile_str) {
+                auto row = processor.level.emplace(y, EMPTY_ROW);
+                auto &tiles = row.first->second;
+                if (row.second)
+                    tiles.resize(opts.width);
+                tiles[x] = tile_str;
+            }
+        }
+    }
+
+    if (pretty)
+        write_pretty_level(processor.spill, opts, zidx, processor.level);
+    else if (!processor.level.empty())
+        write_minimal_level(processor.spill, opts, zidx, processor.level,
+                            processor.zprev);
+    if (!processor.level.empty())
+        processor.has_data = true;
+
+    processor.level.clear();
+    processor.strings.reset();
+    current_arena = NULL;
+}
+
+static void remove_spill_files(vector<blueprint_processor> &processors) {
+    for (blueprint_processor &processor : processors) {
+        if (processor.spill.is_open())
+            processor.spill.close();
+        if (!processor.spill_fname.empty())
+            std::remove(processor.spill_fname.c_str());
+    }
+}
+
+// processes the z-levels in order, running all phases of a level in parallel
+static bool process_levels(color_ostream &out,
+                           const df::coord &start, const df::coord &end,
+                           const blueprint_options &opts,
+                           vector<blueprint_processor> &processors) {
+    static const bp_area EMPTY_AREA;
+
+    for (blueprint_processor &processor : processors) {
+        processor.spill_fname = BLUEPRINT_USER_DIR + opts.name + "-" +
+                processor.phase + ".part";
+        processor.spill.open(processor.spill_fname,
+                             ofstream::binary | ofstream::trunc);
+        if (!processor.spill) {
+            out.printerr("could not create temporary file: '%s'\n",
+                         processor.spill_fname.c_str());
+            return false;
+        }
+    }
+
+    bool need_buildings = false;
+    for (blueprint_processor &processor : processors)
+        need_buildings = need_buildings || processor.init_ctx;
+
+    const bool pretty = opts.format != "minimal";
+    const int32_t z_inc = start.z < end.z ? 1 : -1;
+    level_snapshot snapshot;
+    snapshot.width = end.x - start.x;
+    snapshot.height = end.y - start.y;
+    vector<std::exception_ptr> errors(processors.size());
+    for (int32_t z = start.z; z != end.z; z += z_inc) {
+        snapshot.start = df::coord(start.x, start.y, z);
+        if (need_buildings) {
+            snapshot.buildings.resize(snapshot.width * snapshot.height);
+            for (int32_t y = 0; y < snapshot.height; y++)
+                for (int32_t x = 0; x < snapshot.width; x++)
+                    snapshot.buildings[y * snapshot.width + x] =
+                            Buildings::findAtTile(df::coord(start.x + x, start.y + y, z));
+        }
+
+        const int16_t zidx = abs(z - start.z);
+        auto worker = [&](size_t idx) {
+            try {
+                process_level(processors[idx], snapshot, opts, pretty, zidx);
+            } catch (...) {
+                errors[idx] = std::current_exception();
+            }
+        };
+
+        vector<std::thread> threads;
+        threads.reserve(processors.size() - 1);
+        for (size_t i = 1; i < processors.size(); i++)
+            threads.emplace_back(worker, i);
+        worker(0);
+        for (auto &thread : threads)
+            thread.join();
+
+        for (auto &error : errors)
+            if (error)
+                std::rethrow_exception(error);
+    }
+
+    // the pretty format always has the requested number of levels, even if
+    // the area was cropped to the map bounds
+    if (pretty) {
+        for (int16_t zidx = abs(end.z - start.z); zidx < abs(opts.depth); ++zidx)
+            for (blueprint_processor &processor : processors)
+                write_pretty_level(processor.spill, opts, zidx, EMPTY_AREA);
+    }
+
+    for (blueprint_processor &processor : processors) {
+        processor.spill.close();
+        if (!processor.spill) {
+            out.printerr("could not write temporary file: '%s'\n",
+                         processor.spill_fname.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
 static bool do_transform(color_ostream &out,
                          const df::coord &start, const df::coord &end,
                          blueprint_options opts, // copy so we can munge it
                          vector<string> &filenames) {
-    // empty map instances to pass to emplace() below
-    static const bp_area EMPTY_AREA;
-    static const bp_row EMPTY_ROW;
-
     init_caches(out, opts.engrave);
 
     vector<blueprint_processor> processors;
@@ -1516,38 +1704,21 @@ static bool do_transform(color_ostream &out,
     if (!create_output_dir(out, opts))
         return false;
 
-    const bool pretty = opts.format != "minimal";
-    const int32_t z_inc = start.z < end.z ? 1 : -1;
-    for (int32_t z = start.z; z != end.z; z += z_inc) {
-        for (int32_t y = start.y; y < end.y; y++) {
-            for (int32_t x = start.x; x < end.x; x++) {
-                df::coord pos(x, y, z);
-                tile_context ctx;
-                ctx.pretty = pretty;
-                for (blueprint_processor &processor : processors) {
-                    ctx.processor = &processor;
-                    if (processor.init_ctx)
-                        processor.init_ctx(pos, ctx);
-                    const char *tile_str = processor.get_tile(pos, ctx);
-                    if (tile_str) {
-                        // ensure our z-index is in the order we want to write
-                        auto area = processor.mapdata.emplace(abs(z - start.z),
-                                                              EMPTY_AREA);
-                        auto row = area.first->second.emplace(y - start.y,
-                                                              EMPTY_ROW);
-                        auto &tiles = row.first->second;
-                        if (row.second)
-                            tiles.resize(opts.width);
-                        tiles[x - start.x] = tile_str;
-                    }
-                }
-            }
-        }
+    bool ok = false;
+    try {
+        ok = process_levels(out, start, end, opts, processors);
+    } catch (...) {
+        remove_spill_files(processors);
+        throw;
+    }
+    if (!ok) {
+        remove_spill_files(processors);
+        return false;
     }
 
     std::vector<string> meta_phases;
     for (blueprint_processor &processor : processors) {
-        if (processor.mapdata.empty() && !processor.force_create)
+        if (!processor.has_data && !processor.force_create)
             continue;
         if (is_meta_phase(out, opts, processor.phase))
             meta_phases.push_back(processor.phase);
@@ -1559,7 +1730,7 @@ static bool do_transform(color_ostream &out,
     int32_t ordinal = 0;
     std::map<string, ofstream*> output_files;
     for (blueprint_processor &processor : processors) {
-        if (processor.mapdata.empty() && !processor.force_create)
+        if (!processor.has_data && !processor.force_create)
             continue;
         bool meta_phase = is_meta_phase(out, opts, processor.phase);
         if (!in_meta)
@@ -1569,8 +1740,7 @@ static bool do_transform(color_ostream &out,
             ++ordinal;
         }
         in_meta = meta_phase;
-        if (!write_blueprint(out, output_files, opts, processor, pretty,
-                             ordinal))
+        if (!write_blueprint(out, output_files, opts, processor, ordinal))
             break;
     }
     if (in_meta)
@@ -1581,6 +1751,7 @@ static bool do_transform(color_ostream &out,
         it.second->close();
         delete(it.second);
     }
+    remove_spill_files(processors);
 
     return true;
 }
@@ -1652,8 +1823,7 @@ static command_result do_blueprint(color_ostream &out,
 
     bool ok = do_transform(out, start, end, options, files);
 
-    // clear caches
-    cache(NULL);
+    clear_caches();
 
     return ok ? CR_OK : CR_FAILURE;
 }
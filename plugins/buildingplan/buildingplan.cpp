@@ -294,6 +294,7 @@ DFhackCExport command_result plugin_load_site_data (color_ostream &out) {
 
     planned_buildings.clear();
     tasks.clear();
+    clearItemIndex();
     reset_filters(out);
 
     vector<PersistentDataItem> filter_configs;
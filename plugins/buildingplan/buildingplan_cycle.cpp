@@ -2,6 +2,7 @@
 #include "buildingplan.h"
 
 #include "Debug.h"
+#include "MiscUtils.h"
 
 #include "modules/Burrows.h"
 #include "modules/Items.h"
@@ -18,6 +19,9 @@
 #include "df/job.h"
 #include "df/world.h"
 
+#include <algorithm>
+#include <optional>
+#include <set>
 #include <unordered_map>
 
 using std::map;
@@ -111,7 +115,8 @@ bool matchesHeatSafety(int16_t mat_type, int32_t mat_index, HeatSafety heat) {
     return false;
 }
 
-bool matchesFilters(df::item * item, const df::job_item * jitem, HeatSafety heat, const ItemFilter &item_filter, const std::set<string> &specials) {
+// checks that depend only on what the item is: its type, material, and quality
+static bool matchesFixedFilters(df::item * item, const df::job_item * jitem, HeatSafety heat, const ItemFilter &item_filter) {
     // check the properties that are not checked by Job::isSuitableItem()
     if (jitem->item_type > -1 && jitem->item_type != item->getType())
         return false;
@@ -123,6 +128,26 @@ bool matchesFilters(df::item * item, const df::job_item * jitem, HeatSafety heat
     if (jitem->flags2.bits.building_material && !item->isBuildMat())
         return false;
 
+    if (jitem->metal_ore > -1 && !item->isMetalOre(jitem->metal_ore))
+        return false;
+
+    if (jitem->has_tool_use > df::tool_uses::NONE
+        && !item->hasToolUse(jitem->has_tool_use))
+        return false;
+
+    auto itype = item->getType();
+
+    if (!matchesHeatSafety(item->getMaterial(), item->getMaterialIndex(), heat))
+        return false;
+
+    return Job::isSuitableItem(jitem, itype, item->getSubtype())
+        && Job::isSuitableMaterial(jitem, item->getMaterial(), item->getMaterialIndex(), itype)
+        && item_filter.matches(item);
+}
+
+// checks that depend on what the item currently contains or how it has been
+// worked since it was made
+static bool matchesContentFilters(df::item * item, const df::job_item * jitem, const std::set<string> &specials) {
     if ((jitem->flags1.bits.empty || jitem->flags2.bits.lye_milk_free)) {
         auto gref = Items::getGeneralRef(item, df::general_ref_type::CONTAINS_ITEM);
         if (gref) {
@@ -137,30 +162,21 @@ bool matchesFilters(df::item * item, const df::job_item * jitem, HeatSafety heat
         }
     }
 
-    if (jitem->metal_ore > -1 && !item->isMetalOre(jitem->metal_ore))
-        return false;
-
-    if (jitem->has_tool_use > df::tool_uses::NONE
-        && !item->hasToolUse(jitem->has_tool_use))
-        return false;
-
-    auto itype = item->getType();
-
-    if (itype == df::item_type::SLAB && specials.count("engraved")
-        && static_cast<df::item_slabst *>(item)->engraving_type != df::slab_engraving_type::Memorial)
-        return false;
-
-    if (itype == df::item_type::CAGE && specials.count("empty")
+    if (item->getType() == df::item_type::CAGE && specials.count("empty")
         && (Items::getGeneralRef(item, df::general_ref_type::CONTAINS_UNIT)
             || Items::getGeneralRef(item, df::general_ref_type::CONTAINS_ITEM)))
         return false;
 
-    if (!matchesHeatSafety(item->getMaterial(), item->getMaterialIndex(), heat))
+    if (item->getType() == df::item_type::SLAB && specials.count("engraved")
+        && static_cast<df::item_slabst *>(item)->engraving_type != df::slab_engraving_type::Memorial)
         return false;
 
-    return Job::isSuitableItem(jitem, itype, item->getSubtype())
-        && Job::isSuitableMaterial(jitem, item->getMaterial(), item->getMaterialIndex(), itype)
-        && item_filter.matches(item);
+    return true;
+}
+
+bool matchesFilters(df::item * item, const df::job_item * jitem, HeatSafety heat, const ItemFilter &item_filter, const std::set<string> &specials) {
+    return matchesContentFilters(item, jitem, specials)
+        && matchesFixedFilters(item, jitem, heat, item_filter);
 }
 
 bool isJobReady(color_ostream &out, const std::vector<df::job_item *> &jitems) {
@@ -241,28 +257,175 @@ static int distance(df::coord pos1, df::coord pos2) {
     return std::max(abs(pos1.x - pos2.x), abs(pos1.y - pos2.y)) + abs(pos1.z - pos2.z);
 }
 
+// The items in a vector that could ever match one task's filter. What an item
+// is made of never changes, so each item is checked against the fixed part of
+// the filter once, when it joins the vector. Each cycle then only re-checks
+// where the candidates are and what they hold.
+struct BucketIndex {
+    bool built = false;
+    std::vector<int32_t> candidates;  // sorted
+    std::vector<int32_t> undecorated; // sorted; need improvements before they can match
+};
+
+// everything matchesFixedFilters depends on. getBucket leaves some of this
+// out, so tasks in the same bucket can have different filters and the index
+// can't be keyed on the bucket alone. the strings and the material list are
+// folded into a hash, so building a key allocates nothing.
+struct FixedFilterKey {
+    int32_t item_type, item_subtype, mat_type, mat_index;
+    uint32_t flags1, flags2, flags3, flags4, flags5;
+    int32_t metal_ore, has_tool_use;
+    int32_t heat_safety;
+    int32_t min_quality, max_quality;
+    uint32_t mat_mask;
+    bool decorated_only;
+    uint64_t text_hash; // reaction class, reaction product and material list
+
+    auto operator<=>(const FixedFilterKey &) const = default;
+};
+
+static void hashMix(uint64_t &hash, uint64_t value) {
+    hash = (hash ^ value) * 1099511628211ULL;
+}
+
+static void hashString(uint64_t &hash, const string &str) {
+    for (unsigned char ch : str)
+        hashMix(hash, ch);
+    hashMix(hash, str.size());
+}
+
+static FixedFilterKey getFixedFilterKey(const df::job_item *ji, const PlannedBuilding &pb, int rev_filter_idx) {
+    const ItemFilter &item_filter = pb.item_filters[rev_filter_idx];
+    uint64_t text_hash = 14695981039346656037ULL;
+    hashString(text_hash, ji->reaction_class);
+    hashString(text_hash, ji->has_material_reaction_product);
+    for (auto &mat : item_filter.getMaterials()) {
+        hashMix(text_hash, uint64_t(uint16_t(mat.type)) << 32 | uint32_t(mat.index));
+    }
+    return FixedFilterKey{
+        int32_t(ji->item_type), int32_t(ji->item_subtype), int32_t(ji->mat_type), ji->mat_index,
+        ji->flags1.whole, ji->flags2.whole, ji->flags3.whole, uint32_t(ji->flags4), uint32_t(ji->flags5),
+        ji->metal_ore, int32_t(ji->has_tool_use),
+        int32_t(pb.heat_safety),
+        int32_t(item_filter.getMinQuality()), int32_t(item_filter.getMaxQuality()),
+        item_filter.getMaterialMask().whole,
+        item_filter.getDecoratedOnly(),
+        text_hash };
+}
+
+// one job item vector: the ids it held when it was last scanned, and an
+// index for every filter that is served from it
+struct VectorIndex {
+    std::vector<int32_t> ids; // sorted
+    map<FixedFilterKey, BucketIndex> indices;
+};
+
+static map<df::job_item_vector_id, VectorIndex> vector_indices;
+
+// positions of the unattached matching items, as indices into the matching
+// list of the filter being served. sized to the map, so it is kept across
+// cycles and only emptied when a new filter is loaded into it.
+static std::optional<Maps::SpatialGrid<size_t>> matching_grid;
+
+void clearItemIndex() {
+    vector_indices.clear();
+    matching_grid.reset();
+}
+
+// replaces ids with the ids now in item_vector and collects the items that
+// were not there last time. items leave and rejoin the vectors, so new
+// items are not just the ones with the highest ids.
+static void refreshVectorIds(std::vector<int32_t> &ids, const std::vector<df::item *> &item_vector,
+        std::vector<df::item *> &added) {
+    std::vector<std::pair<int32_t, df::item *>> current;
+    current.reserve(item_vector.size());
+    for (auto item : item_vector)
+        current.emplace_back(item->id, item);
+    if (!std::is_sorted(current.begin(), current.end()))
+        std::sort(current.begin(), current.end());
+
+    std::vector<int32_t> new_ids;
+    new_ids.reserve(current.size());
+    auto old_it = ids.begin();
+    for (auto &[id, item] : current) {
+        while (old_it != ids.end() && *old_it < id)
+            ++old_it;
+        if (old_it == ids.end() || *old_it != id)
+            added.push_back(item);
+        new_ids.push_back(id);
+    }
+    ids.swap(new_ids);
+}
+
+static void indexItem(BucketIndex &index, df::item *item, const df::job_item *jitem,
+        const PlannedBuilding &pb, const ItemFilter &item_filter) {
+    if (item_filter.getDecoratedOnly() && !item->hasImprovements())
+        insert_into_vector(index.undecorated, item->id);
+    else if (matchesFixedFilters(item, jitem, pb.heat_safety, item_filter))
+        insert_into_vector(index.candidates, item->id);
+}
+
+static void updateBucketIndex(BucketIndex &index, const VectorIndex &vindex,
+        const std::vector<df::item *> &item_vector, const std::vector<df::item *> &added,
+        const df::job_item *jitem, const PlannedBuilding &pb, int rev_filter_idx) {
+    const ItemFilter &item_filter = pb.item_filters[rev_filter_idx];
+
+    // pick up items that have been decorated since we last saw them
+    for (auto it = index.undecorated.begin(); it != index.undecorated.end(); ) {
+        auto item = df::item::find(*it);
+        if (item && !item->hasImprovements() && std::binary_search(vindex.ids.begin(), vindex.ids.end(), *it)) {
+            ++it;
+            continue;
+        }
+        int32_t id = *it;
+        it = index.undecorated.erase(it);
+        if (item && item->hasImprovements() && matchesFixedFilters(item, jitem, pb.heat_safety, item_filter))
+            insert_into_vector(index.candidates, id);
+    }
+
+    if (index.built) {
+        for (auto item : added)
+            indexItem(index, item, jitem, pb, item_filter);
+        return;
+    }
+    for (auto item : item_vector)
+        indexItem(index, item, jitem, pb, item_filter);
+    index.built = true;
+}
+
 static void doVector(color_ostream &out, df::job_item_vector_id vector_id,
         map<string, Bucket> &buckets,
         unordered_map<int32_t, PlannedBuilding> &planned_buildings,
         bool unsuspend_on_finalize) {
     auto other_id = ENUM_ATTR(job_item_vector_id, other, vector_id);
-    const auto item_vector = df::global::world->items.other[other_id];
+    const auto &item_vector = df::global::world->items.other[other_id];
+    auto &vindex = vector_indices[vector_id];
+    auto &indices = vindex.indices;
+    // items that joined the vector since the last cycle
+    std::vector<df::item *> added;
+    refreshVectorIds(vindex.ids, item_vector, added);
 
     DEBUG(cycle,out).print("matching %zu item(s) in vector %s against %zu filter bucket(s)\n",
           item_vector.size(),
           ENUM_KEY_STR(job_item_vector_id, vector_id).c_str(),
           buckets.size());
 
+    // item id -> whether the item passed the screen this cycle. shared by
+    // all buckets, since the same items tend to be candidates for many.
+    unordered_map<int32_t, bool> screened;
+    auto passesScreen = [&](df::item *item) {
+        auto it = screened.find(item->id);
+        if (it == screened.end())
+            it = screened.emplace(item->id, itemPassesScreen(out, item)).first;
+        return it->second;
+    };
+
     //  items we might want to attach (and their positions)
-    std::vector<df::item*> available;
-    for (auto item : item_vector) {
-        if (itemPassesScreen(out, item))
-            available.emplace_back(item);
-    }
     std::vector<std::pair<df::coord, df::item*>> matching;
     size_t num_matching = 0;
-
-    DEBUG(cycle,out).print("%zu items available for assignment\n", available.size());
+    std::vector<std::pair<size_t, df::coord>> nearest;
+    // fixed filter keys of the indices used this call; the rest are stale
+    std::set<FixedFilterKey> used_keys;
 
     for (auto bucket_it = buckets.begin(); bucket_it != buckets.end(); ) {
 
@@ -271,6 +434,7 @@ static void doVector(color_ostream &out, df::job_item_vector_id vector_id,
 
         auto & task_queue = bucket_it->second;
         bool first_task = true;
+        FixedFilterKey matching_key{};
 
         while (auto bld = popInvalidTasks(out, task_queue, planned_buildings)){
             auto & task = task_queue.front();
@@ -282,23 +446,41 @@ static void doVector(color_ostream &out, df::job_item_vector_id vector_id,
             const int filter_idx = task.second;
             const int rev_filter_idx = num_filters - (filter_idx+1);
             auto &pb = planned_buildings.at(id);
+            FixedFilterKey key = getFixedFilterKey(jitems[filter_idx], pb, rev_filter_idx);
+
+            // first task of the bucket, or one whose filter differs from the
+            // task before it: filter/count available items
+            if (first_task || key != matching_key) {
+                auto &index = indices[key];
+                used_keys.insert(key);
+                matching_key = key;
+                updateBucketIndex(index, vindex, item_vector, added, jitems[filter_idx], pb, rev_filter_idx);
 
-            // first task of the bucket: filter/count available items
-            if (first_task) {
                 matching.clear();
-                for(auto item : available)
+                auto &candidates = index.candidates;
+                size_t num_kept = 0;
+                for (auto item_id : candidates) {
+                    auto item = df::item::find(item_id);
+                    if (!item || !std::binary_search(vindex.ids.begin(), vindex.ids.end(), item_id))
+                        continue; // drop items that no longer exist or left the vector
+                    candidates[num_kept++] = item_id;
                     if (!item->flags.bits.in_job &&
-                        matchesFilters(item,
-                                       jitems[filter_idx],
-                                       pb.heat_safety,
-                                       pb.item_filters[rev_filter_idx],
-                                       pb.specials))
+                        passesScreen(item) &&
+                        matchesContentFilters(item, jitems[filter_idx], pb.specials))
                         matching.emplace_back(Items::getPosition(item),item);
+                }
+                candidates.resize(num_kept);
+
+                if (!matching_grid)
+                    matching_grid.emplace();
+                matching_grid->clear();
+                for (size_t idx = 0; idx < matching.size(); ++idx)
+                    matching_grid->insert(idx, matching[idx].first);
 
                 num_matching = matching.size();
                 first_task = false;
-                TRACE(cycle,out).print("first task in bucket: found %zu matching items\n",
-                                        num_matching);
+                TRACE(cycle,out).print("new filter in bucket: found %zu matching items out of %zu candidates\n",
+                                        num_matching, candidates.size());
             }
             // every task: find and attach closest matching item (if any)
             if (num_matching == 0)
@@ -306,9 +488,15 @@ static void doVector(color_ostream &out, df::job_item_vector_id vector_id,
 
             auto jpos = job->pos;
             std::pair<df::coord, df::item*> *closest = nullptr;
-            for (auto &p : matching) {
-                if (p.second && (closest == nullptr || distance(jpos, p.first) < distance(jpos, closest->first)))
-                    closest = &p;
+            nearest.clear();
+            if (matching_grid->nearest(jpos, 1, nearest)) {
+                closest = &matching[nearest[0].first];
+            } else {
+                // the only items left are somewhere the grid can't hold them
+                for (auto &p : matching) {
+                    if (p.second && (closest == nullptr || distance(jpos, p.first) < distance(jpos, closest->first)))
+                        closest = &p;
+                }
             }
             auto item = closest->second; // some item must be closest.
 
@@ -335,6 +523,7 @@ static void doVector(color_ostream &out, df::job_item_vector_id vector_id,
                 // null the item* component in vector of matching items
                 // ensures we don't try to attach this item to another job
                 closest->second = nullptr;
+                matching_grid->remove(size_t(closest - matching.data()), closest->first);
                 --num_matching;
                 // try to finalize building
                 if (isJobReady(out, jitems)) {
@@ -357,6 +546,13 @@ static void doVector(color_ostream &out, df::job_item_vector_id vector_id,
             ++bucket_it;
         }
     }
+
+    for (auto it = indices.begin(); it != indices.end(); ) {
+        if (used_keys.count(it->first))
+            ++it;
+        else
+            it = indices.erase(it);
+    }
 }
 
 struct VectorsToScanLast {
@@ -380,6 +576,15 @@ void buildingplan_cycle(color_ostream &out, Tasks &tasks,
             "running buildingplan cycle for %zu registered buildings\n",
             planned_buildings.size());
 
+    // drop indices for vectors that no longer have any tasks. doVector
+    // drops the ones for filters that are no longer in use.
+    for (auto vec_it = vector_indices.begin(); vec_it != vector_indices.end(); ) {
+        if (!tasks.count(vec_it->first))
+            vec_it = vector_indices.erase(vec_it);
+        else
+            ++vec_it;
+    }
+
     for (auto it = tasks.begin(); it != tasks.end(); ) {
         auto vector_id = it->first;
         // we could make this a set, but it's only a few elements
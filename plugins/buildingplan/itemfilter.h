@@ -24,7 +24,7 @@ public:
     df::item_quality getMaxQuality() const {return max_quality; }
     bool getDecoratedOnly() const { return decorated_only; }
     df::dfhack_material_category getMaterialMask() const { return mat_mask; }
-    std::set<DFHack::MaterialInfo> getMaterials() const { return materials; }
+    const std::set<DFHack::MaterialInfo> &getMaterials() const { return materials; }
 
     bool matches(df::dfhack_material_category mask) const;
     bool matches(DFHack::MaterialInfo &material) const;
@@ -41,8 +41,8 @@ static std::unordered_map<df::coord, df::tiletype> active_dig_jobs;
 
 static command_result do_command(color_ostream &out, vector<string> &parameters);
 static void init_diggers(color_ostream& out);
-static void jobStartedHandler(color_ostream& out, void* ptr);
-static void jobCompletedHandler(color_ostream& out, void* ptr);
+static void jobStartedHandler(color_ostream& out, df::job* job);
+static void jobCompletedHandler(color_ostream& out, df::job* job);
 
 DFhackCExport command_result plugin_init(color_ostream &out, std::vector<PluginCommand> &commands) {
     DEBUG(status, out).print("initializing %s\n", plugin_name);
@@ -64,8 +64,8 @@ DFhackCExport command_result plugin_enable(color_ostream &out, bool enable) {
         reset();
         if (enable) {
             init_diggers(out);
-            EventManager::registerListener(EventManager::EventType::JOB_STARTED, EventManager::EventHandler(plugin_self, jobStartedHandler, 0));
-            EventManager::registerListener(EventManager::EventType::JOB_COMPLETED, EventManager::EventHandler(plugin_self, jobCompletedHandler, 0));
+            EventManager::registerListener<EventManager::EventType::JOB_STARTED, jobStartedHandler>(plugin_self, 0);
+            EventManager::registerListener<EventManager::EventType::JOB_COMPLETED, jobCompletedHandler>(plugin_self, 0);
         } else {
             EventManager::unregisterAll(plugin_self);
         }
@@ -127,10 +127,9 @@ static void init_diggers(color_ostream& out) {
     }
 }
 
-static void jobStartedHandler(color_ostream& out, void* ptr) {
+static void jobStartedHandler(color_ostream& out, df::job* job) {
     DEBUG(event, out).print("entering jobStartedHandler\n");
 
-    df::job *job = (df::job *)ptr;
     auto type = ENUM_ATTR(job_type, type, job->job_type);
     if (type != job_type_class::Digging)
         return;
@@ -190,10 +189,9 @@ static void expand_burrows(color_ostream &out, const df::coord & pos, df::tilety
         Job::checkDesignationsNow();
 }
 
-static void jobCompletedHandler(color_ostream& out, void* ptr) {
+static void jobCompletedHandler(color_ostream& out, df::job* job) {
     DEBUG(event, out).print("entering jobCompletedHandler\n");
 
-    df::job *job = (df::job *)ptr;
     auto type = ENUM_ATTR(job_type, type, job->job_type);
     if (type != job_type_class::Digging)
         return;
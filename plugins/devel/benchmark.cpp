@@ -0,0 +1,483 @@
+// Micro-benchmarks for core library data structures
+
+#include "Core.h"
+#include "Console.h"
+#include "Export.h"
+#include "PluginManager.h"
+#include "DataDefs.h"
+#include "MiscUtils.h"
+#include "TileTypes.h"
+
+#include "modules/Items.h"
+#include "modules/MapCache.h"
+#include "modules/Maps.h"
+
+#include "df/item_constructed.h"
+#include "df/item_weaponst.h"
+#include "df/map_block.h"
+#include "df/world.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <stack>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using std::vector;
+using std::string;
+using namespace DFHack;
+using namespace df::enums;
+
+DFHACK_PLUGIN("benchmark");
+REQUIRE_GLOBAL(world);
+
+static command_result benchmark(color_ostream &out, vector<string> &parameters);
+
+DFhackCExport command_result plugin_init(color_ostream &out, std::vector<PluginCommand> &commands)
+{
+    commands.push_back(PluginCommand("benchmark",
+        "Time core library lookups and scans.",
+        benchmark, false,
+        "benchmark mapcache\n"
+        "  Scan every map tile through MapCache with per-tile lookups, with\n"
+        "  per-tile lookups through the old std::map block index, and with\n"
+        "  block iteration, and report tiles per second.\n"
+        "benchmark tilemask\n"
+        "  Count hidden tiles and liquid tiles in every block, once with\n"
+        "  per-tile loops and once with the Maps block kernels.\n"
+        "benchmark flood\n"
+        "  Label wall and open regions of the map, once with a stack-based\n"
+        "  flood fill and once with Maps::FloodFill.\n"
+        "benchmark vcast\n"
+        "  Run virtual_cast over every item, on one thread and on all cores,\n"
+        "  and report casts per second.\n"
+        "benchmark ids\n"
+        "  Resolve the ids in every map block's item list, as stockpile scans\n"
+        "  do, with df::item::find, Items::findItemByID and Items::findItemsByID.\n"));
+    return CR_OK;
+}
+
+DFhackCExport command_result plugin_shutdown(color_ostream &out)
+{
+    return CR_OK;
+}
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_s(bench_clock::time_point start)
+{
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static void report(color_ostream &out, const char *name, size_t count, const char *unit, double seconds)
+{
+    out.print("%-24s %10zu %s in %8.3f ms (%.3g %s/s)\n", name, count, unit,
+        seconds * 1000, seconds > 0 ? count / seconds : 0.0, unit);
+}
+
+// prospector-style scan: count wall tiles, hidden tiles, and liquid tiles
+struct scan_totals
+{
+    size_t tiles = 0;
+    size_t walls = 0;
+    size_t hidden = 0;
+    size_t liquid = 0;
+
+    void add(df::tiletype tt, df::tile_designation des)
+    {
+        ++tiles;
+        if (tileShape(tt) == tiletype_shape::WALL)
+            ++walls;
+        if (des.bits.hidden)
+            ++hidden;
+        if (des.bits.flow_size)
+            ++liquid;
+    }
+};
+
+static command_result bench_mapcache(color_ostream &out)
+{
+    if (!Maps::IsValid())
+    {
+        out.printerr("Map is not available!\n");
+        return CR_FAILURE;
+    }
+
+    uint32_t x_max = 0, y_max = 0, z_max = 0;
+    Maps::getSize(x_max, y_max, z_max);
+
+    // per-tile accessors, as used by most map walkers
+    {
+        MapExtras::MapCache map;
+        scan_totals totals;
+        auto start = bench_clock::now();
+        for (uint32_t z = 0; z < z_max; z++)
+            for (uint32_t y = 0; y < y_max * 16; y++)
+                for (uint32_t x = 0; x < x_max * 16; x++)
+                {
+                    DFCoord pos(x, y, z);
+                    if (!map.testCoord(pos))
+                        continue;
+                    totals.add(map.tiletypeAt(pos), map.designationAt(pos));
+                }
+        report(out, "mapcache per-tile", totals.tiles, "tiles", elapsed_s(start));
+    }
+
+    // the same per-tile scan through the std::map<DFCoord, Block *> index
+    // MapCache used before the dense block index, for comparison
+    {
+        MapExtras::MapCache map;
+        std::map<DFCoord, MapExtras::Block *> blocks;
+        map.forEachBlock([&](MapExtras::Block *b) { blocks[b->getCoord()] = b; });
+        auto block_at = [&](DFCoord pos) -> MapExtras::Block * {
+            auto it = blocks.find(DFCoord(pos.x >> 4, pos.y >> 4, pos.z));
+            return it != blocks.end() ? it->second : NULL;
+        };
+        scan_totals totals;
+        auto start = bench_clock::now();
+        for (uint32_t z = 0; z < z_max; z++)
+            for (uint32_t y = 0; y < y_max * 16; y++)
+                for (uint32_t x = 0; x < x_max * 16; x++)
+                {
+                    DFCoord pos(x, y, z);
+                    // testCoord, tiletypeAt and designationAt each did a lookup
+                    MapExtras::Block *b = block_at(pos);
+                    if (!b || !b->is_valid())
+                        continue;
+                    totals.add(block_at(pos)->tiletypeAt(pos), block_at(pos)->DesignationAt(pos));
+                }
+        report(out, "mapcache per-tile (map)", totals.tiles, "tiles", elapsed_s(start));
+    }
+
+    // block iteration with the Block accessors
+    {
+        MapExtras::MapCache map;
+        scan_totals totals;
+        auto start = bench_clock::now();
+        map.forEachBlock([&](MapExtras::Block *b) {
+            for (int y = 0; y < 16; y++)
+                for (int x = 0; x < 16; x++)
+                {
+                    df::coord2d pos(x, y);
+                    totals.add(b->tiletypeAt(pos), b->DesignationAt(pos));
+                }
+        });
+        report(out, "mapcache forEachBlock", totals.tiles, "tiles", elapsed_s(start));
+    }
+
+    return CR_OK;
+}
+
+static command_result bench_tilemask(color_ostream &out)
+{
+    if (!Maps::IsValid())
+    {
+        out.printerr("Map is not available!\n");
+        return CR_FAILURE;
+    }
+
+    auto &blocks = world->map.map_blocks;
+    const size_t tiles = blocks.size() * 256;
+
+    // nested per-tile loops, as in the scanners before the block kernels
+    size_t loop_hidden = 0, loop_liquid = 0;
+    {
+        auto start = bench_clock::now();
+        for (auto block : blocks)
+            for (int x = 0; x < 16; x++)
+                for (int y = 0; y < 16; y++)
+                {
+                    auto des = block->designation[x][y];
+                    if (des.bits.hidden)
+                        ++loop_hidden;
+                    if (des.bits.flow_size && !block->occupancy[x][y].bits.building)
+                        ++loop_liquid;
+                }
+        report(out, "per-tile loops", tiles, "tiles", elapsed_s(start));
+    }
+
+    size_t mask_hidden = 0, mask_liquid = 0;
+    {
+        auto start = bench_clock::now();
+        for (auto block : blocks)
+        {
+            mask_hidden += Maps::countTiles(block, [](df::tiletype, df::tile_designation des, df::tile_occupancy) {
+                return des.bits.hidden;
+            });
+            mask_liquid += Maps::countTiles(block, [](df::tiletype, df::tile_designation des, df::tile_occupancy occ) {
+                return des.bits.flow_size && !occ.bits.building;
+            });
+        }
+        report(out, "block kernels", tiles, "tiles", elapsed_s(start));
+    }
+
+    if (loop_hidden != mask_hidden || loop_liquid != mask_liquid)
+    {
+        out.printerr("Results differ: %zu/%zu hidden, %zu/%zu liquid\n",
+            loop_hidden, mask_hidden, loop_liquid, mask_liquid);
+        return CR_FAILURE;
+    }
+    return CR_OK;
+}
+
+// flood fill with an explicit stack, as the map walkers did before Maps::FloodFill
+template<typename Pred>
+static size_t stack_flood(std::unordered_set<df::coord> &visited, df::coord seed,
+                          bool diagonal, bool vertical, Pred pred)
+{
+    size_t count = 0;
+    std::stack<df::coord> flood;
+    flood.push(seed);
+    visited.insert(seed);
+    while (!flood.empty())
+    {
+        df::coord pos = flood.top();
+        flood.pop();
+        ++count;
+        for (int dz = -1; dz <= 1; dz++)
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    bool skip = dz ? (!vertical || dx || dy) : ((!dx && !dy) || (dx && dy && !diagonal));
+                    if (skip)
+                        continue;
+                    df::coord next = pos + df::coord(dx, dy, dz);
+                    if (Maps::isValidTilePos(next) && !visited.count(next) && pred(next))
+                    {
+                        visited.insert(next);
+                        flood.push(next);
+                    }
+                }
+    }
+    return count;
+}
+
+template<typename Pred>
+static bool bench_flood_regions(color_ostream &out, const char *name,
+                                Maps::FloodFill::Connectivity connectivity, Pred pred)
+{
+    int32_t x_max = 0, y_max = 0, z_max = 0;
+    Maps::getTileSize(x_max, y_max, z_max);
+    bool diagonal = connectivity == Maps::FloodFill::DIAGONAL || connectivity == Maps::FloodFill::DIAGONAL_3D;
+    bool vertical = connectivity == Maps::FloodFill::ORTHOGONAL_3D || connectivity == Maps::FloodFill::DIAGONAL_3D;
+
+    size_t stack_tiles = 0, stack_regions = 0;
+    {
+        std::unordered_set<df::coord> visited;
+        auto start = bench_clock::now();
+        for (int32_t z = 0; z < z_max; z++)
+            for (int32_t y = 0; y < y_max; y++)
+                for (int32_t x = 0; x < x_max; x++)
+                {
+                    df::coord pos(x, y, z);
+                    if (visited.count(pos) || !pred(pos))
+                        continue;
+                    stack_tiles += stack_flood(visited, pos, diagonal, vertical, pred);
+                    ++stack_regions;
+                }
+        string label = string(name) + " stack";
+        report(out, label.c_str(), stack_tiles, "tiles", elapsed_s(start));
+    }
+
+    size_t fill_regions = 0;
+    Maps::FloodFill flood(connectivity);
+    {
+        auto start = bench_clock::now();
+        for (int32_t z = 0; z < z_max; z++)
+            for (int32_t y = 0; y < y_max; y++)
+                for (int32_t x = 0; x < x_max; x++)
+                {
+                    df::coord pos(x, y, z);
+                    if (flood.isVisited(pos) || !pred(pos))
+                        continue;
+                    flood.addSeed(pos);
+                    flood.run(pred, [](df::coord) {});
+                    ++fill_regions;
+                }
+        string label = string(name) + " FloodFill";
+        report(out, label.c_str(), flood.count(), "tiles", elapsed_s(start));
+    }
+
+    if (stack_tiles != flood.count() || stack_regions != fill_regions)
+    {
+        out.printerr("Results differ: %zu/%zu tiles, %zu/%zu regions\n",
+            stack_tiles, flood.count(), stack_regions, fill_regions);
+        return false;
+    }
+    out.print("%zu %s regions\n", fill_regions, name);
+    return true;
+}
+
+static command_result bench_flood(color_ostream &out)
+{
+    if (!Maps::IsValid())
+    {
+        out.printerr("Map is not available!\n");
+        return CR_FAILURE;
+    }
+
+    auto is_wall = [](df::coord pos) {
+        auto tt = Maps::getTileType(pos);
+        return tt && tileShape(*tt) == tiletype_shape::WALL;
+    };
+    auto is_open = [](df::coord pos) {
+        auto tt = Maps::getTileType(pos);
+        return tt && tileShape(*tt) != tiletype_shape::WALL;
+    };
+
+    bool ok = bench_flood_regions(out, "walls", Maps::FloodFill::DIAGONAL, is_wall);
+    ok = bench_flood_regions(out, "open", Maps::FloodFill::ORTHOGONAL_3D, is_open) && ok;
+    return ok ? CR_OK : CR_FAILURE;
+}
+
+struct vcast_totals
+{
+    size_t known = 0;
+    size_t weapons = 0;
+    size_t constructed = 0;
+
+    bool operator==(const vcast_totals &other) const
+    {
+        return known == other.known && weapons == other.weapons && constructed == other.constructed;
+    }
+};
+
+static vcast_totals vcast_pass(const vector<df::item*> &items)
+{
+    vcast_totals totals;
+    for (auto item : items)
+    {
+        if (virtual_identity::get(item))
+            ++totals.known;
+        if (virtual_cast<df::item_weaponst>(item))
+            ++totals.weapons;
+        // item_constructed has subclasses, so this takes the is_subclass path
+        if (virtual_cast<df::item_constructed>(item))
+            ++totals.constructed;
+    }
+    return totals;
+}
+
+static command_result bench_vcast(color_ostream &out)
+{
+    auto &items = world->items.all;
+    if (items.empty())
+    {
+        out.printerr("No items to cast!\n");
+        return CR_FAILURE;
+    }
+
+    // three lookups per item per pass; aim for a few million in total
+    const size_t passes = std::max<size_t>(1, 1000000 / items.size());
+    const size_t casts = items.size() * 3 * passes;
+
+    vcast_totals single;
+    {
+        auto start = bench_clock::now();
+        for (size_t i = 0; i < passes; i++)
+            single = vcast_pass(items);
+        report(out, "vcast one thread", casts, "casts", elapsed_s(start));
+    }
+
+    const unsigned num_threads = std::max(2u, std::thread::hardware_concurrency());
+    std::atomic<size_t> mismatches(0);
+    {
+        vector<std::thread> threads;
+        auto start = bench_clock::now();
+        for (unsigned t = 0; t < num_threads; t++)
+            threads.emplace_back([&]() {
+                for (size_t i = 0; i < passes; i++)
+                    if (!(vcast_pass(items) == single))
+                        ++mismatches;
+            });
+        for (auto &thread : threads)
+            thread.join();
+        string label = stl_sprintf("vcast %u threads", num_threads);
+        report(out, label.c_str(), casts * num_threads, "casts", elapsed_s(start));
+    }
+
+    out.print("%zu items: %zu with known classes, %zu weapons, %zu constructed\n",
+        items.size(), single.known, single.weapons, single.constructed);
+    if (mismatches)
+    {
+        out.printerr("%zu threaded passes disagreed with the single-threaded pass\n", mismatches.load());
+        return CR_FAILURE;
+    }
+    return CR_OK;
+}
+
+static command_result bench_ids(color_ostream &out)
+{
+    if (!Maps::IsValid())
+    {
+        out.printerr("Map is not available!\n");
+        return CR_FAILURE;
+    }
+
+    vector<int32_t> ids;
+    for (auto block : world->map.map_blocks)
+        ids.insert(ids.end(), block->items.begin(), block->items.end());
+    if (ids.empty())
+    {
+        out.printerr("No items on the map!\n");
+        return CR_FAILURE;
+    }
+    out.print("%zu item ids in map blocks, %zu items in the world\n", ids.size(), world->items.all.size());
+
+    vector<df::item*> binsearch_items;
+    {
+        binsearch_items.reserve(ids.size());
+        auto start = bench_clock::now();
+        for (auto id : ids)
+            binsearch_items.push_back(df::item::find(id));
+        report(out, "df::item::find", ids.size(), "ids", elapsed_s(start));
+    }
+
+    vector<df::item*> single_items;
+    {
+        single_items.reserve(ids.size());
+        auto start = bench_clock::now();
+        for (auto id : ids)
+            single_items.push_back(Items::findItemByID(id));
+        report(out, "Items::findItemByID", ids.size(), "ids", elapsed_s(start));
+    }
+
+    vector<df::item*> batch_items;
+    {
+        auto start = bench_clock::now();
+        Items::findItemsByID(ids, batch_items);
+        report(out, "Items::findItemsByID", ids.size(), "ids", elapsed_s(start));
+    }
+
+    if (single_items != binsearch_items || batch_items != binsearch_items)
+    {
+        out.printerr("Results differ between the lookup methods\n");
+        return CR_FAILURE;
+    }
+    return CR_OK;
+}
+
+static command_result benchmark(color_ostream &out, vector<string> &parameters)
+{
+    if (parameters.empty())
+        return CR_WRONG_USAGE;
+
+    CoreSuspender suspend;
+
+    const string &which = parameters[0];
+    if (which == "mapcache")
+        return bench_mapcache(out);
+    if (which == "tilemask")
+        return bench_tilemask(out);
+    if (which == "flood")
+        return bench_flood(out);
+    if (which == "vcast")
+        return bench_vcast(out);
+    if (which == "ids")
+        return bench_ids(out);
+
+    return CR_WRONG_USAGE;
+}
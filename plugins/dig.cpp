@@ -1474,113 +1474,54 @@ command_result digv (color_ostream &out, vector <string> & parameters)
         return CR_FAILURE;
     }
     con.print("%d/%d/%d tiletype: %d, veinmat: %d, designation: 0x%x ... DIGGING!\n", cx,cy,cz, tt, veinmat, des.whole);
-    stack <DFHack::DFCoord> flood;
-    flood.push(xy);
-
-    while( !flood.empty() )
-    {
-        DFHack::DFCoord current = flood.top();
-        flood.pop();
-        if (MCache->tagAt(current))
-            continue;
-        int16_t vmat2 = MCache->veinMaterialAt(current);
-        tt = MCache->tiletypeAt(current);
-        if(!DFHack::isWallTerrain(tt))
-            continue;
-        if(vmat2!=veinmat)
-            continue;
 
+    // the whole vein, minus the map border
+    auto is_vein = [&](const DFHack::DFCoord &pos) {
+        return pos.x > 0 && pos.x < int32_t(tx_max) - 1 && pos.y > 0 && pos.y < int32_t(ty_max) - 1 &&
+            MCache->testCoord(pos) && DFHack::isWallTerrain(MCache->tiletypeAt(pos)) &&
+            MCache->veinMaterialAt(pos) == veinmat;
+    };
+    auto dig_tile = [&](const DFHack::DFCoord &current) {
         // found a good tile, dig+unset material
         df::tile_designation des = MCache->designationAt(current);
-        df::tile_designation des_minus;
-        df::tile_designation des_plus;
-        des_plus.whole = des_minus.whole = 0;
-        int16_t vmat_minus = -1;
-        int16_t vmat_plus = -1;
-        bool below = 0;
-        bool above = 0;
         if(updown)
         {
-            if(MCache->testCoord(current-1))
-            {
-                below = 1;
-                des_minus = MCache->designationAt(current-1);
-                vmat_minus = MCache->veinMaterialAt(current-1);
-            }
-
-            if(MCache->testCoord(current+1))
+            if(current.z > 0 && MCache->testCoord(current-1) && MCache->veinMaterialAt(current-1) == veinmat)
             {
-                above = 1;
-                des_plus = MCache->designationAt(current+1);
-                vmat_plus = MCache->veinMaterialAt(current+1);
-            }
-        }
-        if(MCache->testCoord(current))
-        {
-            MCache->setTagAt(current, 1);
+                df::tile_designation des_minus = MCache->designationAt(current-1);
+                if(des_minus.bits.dig == tile_dig_designation::DownStair)
+                    des_minus.bits.dig = tile_dig_designation::UpDownStair;
+                else
+                    des_minus.bits.dig = tile_dig_designation::UpStair;
+                MCache->setDesignationAt(current-1,des_minus,priority);
 
-            if(current.x < int32_t(tx_max) - 2)
-            {
-                flood.push(DFHack::DFCoord(current.x + 1, current.y, current.z));
-                if(current.y < int32_t(ty_max) - 2)
-                {
-                    flood.push(DFHack::DFCoord(current.x + 1, current.y + 1,current.z));
-                    flood.push(DFHack::DFCoord(current.x, current.y + 1,current.z));
-                }
-                if(current.y > 1)
-                {
-                    flood.push(DFHack::DFCoord(current.x + 1, current.y - 1,current.z));
-                    flood.push(DFHack::DFCoord(current.x, current.y - 1,current.z));
-                }
-            }
-            if(current.x > 1)
-            {
-                flood.push(DFHack::DFCoord(current.x - 1, current.y,current.z));
-                if(current.y < int32_t(ty_max) - 2)
-                {
-                    flood.push(DFHack::DFCoord(current.x - 1, current.y + 1,current.z));
-                    flood.push(DFHack::DFCoord(current.x, current.y + 1,current.z));
-                }
-                if(current.y > 1)
-                {
-                    flood.push(DFHack::DFCoord(current.x - 1, current.y - 1,current.z));
-                    flood.push(DFHack::DFCoord(current.x, current.y - 1,current.z));
-                }
+                des.bits.dig = tile_dig_designation::DownStair;
             }
-            if(updown)
+            if(current.z < int32_t(z_max) - 1 && MCache->testCoord(current+1) && MCache->veinMaterialAt(current+1) == veinmat)
             {
-                if(current.z > 0 && below && vmat_minus == vmat2)
-                {
-                    flood.push(current-1);
-
-                    if(des_minus.bits.dig == tile_dig_designation::DownStair)
-                        des_minus.bits.dig = tile_dig_designation::UpDownStair;
-                    else
-                        des_minus.bits.dig = tile_dig_designation::UpStair;
-                    MCache->setDesignationAt(current-1,des_minus,priority);
-
-                    des.bits.dig = tile_dig_designation::DownStair;
-                }
-                if(current.z < int32_t(z_max) - 1 && above && vmat_plus == vmat2)
-                {
-                    flood.push(current+ 1);
-
-                    if(des_plus.bits.dig == tile_dig_designation::UpStair)
-                        des_plus.bits.dig = tile_dig_designation::UpDownStair;
-                    else
-                        des_plus.bits.dig = tile_dig_designation::DownStair;
-                    MCache->setDesignationAt(current+1,des_plus,priority);
+                df::tile_designation des_plus = MCache->designationAt(current+1);
+                if(des_plus.bits.dig == tile_dig_designation::UpStair)
+                    des_plus.bits.dig = tile_dig_designation::UpDownStair;
+                else
+                    des_plus.bits.dig = tile_dig_designation::DownStair;
+                MCache->setDesignationAt(current+1,des_plus,priority);
 
-                    if(des.bits.dig == tile_dig_designation::DownStair)
-                        des.bits.dig = tile_dig_designation::UpDownStair;
-                    else
-                        des.bits.dig = tile_dig_designation::UpStair;
-                }
+                if(des.bits.dig == tile_dig_designation::DownStair)
+                    des.bits.dig = tile_dig_designation::UpDownStair;
+                else
+                    des.bits.dig = tile_dig_designation::UpStair;
             }
-            if(des.bits.dig == tile_dig_designation::No)
-                des.bits.dig = tile_dig_designation::Default;
-            MCache->setDesignationAt(current,des,priority);
         }
+        if(des.bits.dig == tile_dig_designation::No)
+            des.bits.dig = tile_dig_designation::Default;
+        MCache->setDesignationAt(current,des,priority);
+    };
+
+    if(is_vein(xy))
+    {
+        Maps::FloodFill flood(updown ? Maps::FloodFill::DIAGONAL_3D : Maps::FloodFill::DIAGONAL);
+        flood.addSeed(xy);
+        flood.run(is_vein, dig_tile);
     }
     MCache->WriteAll();
     return CR_OK;
@@ -2046,14 +1987,24 @@ static int getCurLevelDesignatedCount(color_ostream &out) {
         if (block->map_pos.z != z)
             continue;
 
+        auto hidden = Maps::getTileMask(block, [](df::tiletype, df::tile_designation des, df::tile_occupancy) {
+            return des.bits.hidden;
+        });
+        auto designated = Maps::getTileMask(block, [](df::tiletype, df::tile_designation des, df::tile_occupancy) {
+            return des.bits.dig != df::tile_dig_designation::No;
+        });
+        designated &= hidden;
+        count += Maps::countTiles(designated);
+        if (dig_jobs.empty())
+            continue;
+
+        // hidden tiles whose designation was already taken by a job
+        hidden -= designated;
         const auto & block_pos = block->map_pos;
-        for (uint32_t x = 0; x < 16; x++) for (uint32_t y = 0; y < 16; y++) {
-            if (!block->designation[x % 16][y % 16].bits.hidden)
-                continue;
-            df::coord pos = block_pos + df::coord(x, y, 0);
-            if (block->designation[x][y].bits.dig || dig_jobs.contains(pos))
+        Maps::forEachTile(hidden, [&](int x, int y) {
+            if (dig_jobs.contains(block_pos + df::coord(x, y, 0)))
                 ++count;
-        }
+        });
     }
     return count;
 }
@@ -2186,26 +2137,32 @@ static void paintScreenWarmDamp(bool aquifer_mode = false, bool show_damp = fals
     heavy_aq_pen.tile = heavy_aq_texpos;
 
     auto dims = Gui::getDwarfmodeViewDims().map();
+
+    // resolve the designation masks for the visible blocks once per frame
+    static World::PersistentTilemaskArea warm_masks, damp_masks;
+    df::coord view_min(*window_x + dims.first.x, *window_y + dims.first.y, *window_z);
+    df::coord view_max(*window_x + dims.second.x, *window_y + dims.second.y, *window_z);
+    World::getPersistentTilemasks(&warm_masks, warm_config, view_min, view_max);
+    World::getPersistentTilemasks(&damp_masks, damp_config, view_min, view_max);
+
+    auto &view = Gui::getViewportSnapshot();
     for (int y = dims.first.y; y <= dims.second.y; ++y) {
         for (int x = dims.first.x; x <= dims.second.x; ++x) {
             df::coord pos(*window_x + x, *window_y + y, *window_z);
 
-            auto block = Maps::getTileBlock(pos);
-            if (!block)
+            auto tile = view.get(x, y);
+            if (!tile || !tile->block)
                 continue;
+            auto block = tile->block;
 
             if (!aquifer_mode && Screen::inGraphicsMode()) {
-                if (auto warm_mask = World::getPersistentTilemask(warm_config, block)) {
-                    if (warm_mask->getassignment(pos))
-                        bump_layers(warm_dig_pen, x, y);
-                }
-                if (auto damp_mask = World::getPersistentTilemask(damp_config, block)) {
-                    if (damp_mask->getassignment(pos))
-                        bump_layers(damp_dig_pen, x, y);
-                }
+                if (warm_masks.getassignment(pos))
+                    bump_layers(warm_dig_pen, x, y);
+                if (damp_masks.getassignment(pos))
+                    bump_layers(damp_dig_pen, x, y);
             }
 
-            if (!aquifer_mode && !Maps::isTileVisible(pos) && !Maps::isTileVisible(pos-1)) {
+            if (!aquifer_mode && !tile->isVisible() && !Maps::isTileVisible(pos-1)) {
                 TRACE(log).print("skipping hidden tile\n");
                 continue;
             }
@@ -2229,8 +2186,8 @@ static void paintScreenWarmDamp(bool aquifer_mode = false, bool show_damp = fals
                 TRACE(log).print("scanning map tile at (%d, %d, %d) screen offset (%d, %d)\n",
                     pos.x, pos.y, pos.z, x, y);
 
-                auto des = Maps::getTileDesignation(pos);
-                if (des && des->bits.dig != df::tile_dig_designation::No) {
+                auto des = &block->designation[pos.x&15][pos.y&15];
+                if (des->bits.dig != df::tile_dig_designation::No) {
                     if (blink(1000))
                         continue;
                 }
@@ -2244,19 +2201,14 @@ static void paintScreenWarmDamp(bool aquifer_mode = false, bool show_damp = fals
                 int color = COLOR_BLACK;
 
                 if (!aquifer_mode) {
-                    if (auto warm_mask = World::getPersistentTilemask(warm_config, block)) {
-                        if (warm_mask->getassignment(pos) && blink(500)) {
-                            color = COLOR_LIGHTRED;
-                            auto damp_mask = World::getPersistentTilemask(damp_config, block);
-                            if (damp_mask && damp_mask->getassignment(pos) && blink(2000))
-                                color = COLOR_BLUE;
-                        }
+                    if (warm_masks.getassignment(pos) && blink(500)) {
+                        color = COLOR_LIGHTRED;
+                        if (damp_masks.getassignment(pos) && blink(2000))
+                            color = COLOR_BLUE;
                     }
                     if (color == COLOR_BLACK) {
-                        if (auto damp_mask = World::getPersistentTilemask(damp_config, block)) {
-                            if (damp_mask->getassignment(pos) && blink(500))
-                                color = COLOR_BLUE;
-                        }
+                        if (damp_masks.getassignment(pos) && blink(500))
+                            color = COLOR_BLUE;
                     }
                     if (color == COLOR_BLACK && is_warm(pos)) {
                         color = COLOR_RED;
@@ -2460,14 +2412,16 @@ static void paintScreenCarve() {
     bool draw_priority = blink(1000);
 
     auto dims = Gui::getDwarfmodeViewDims().map();
+    auto &view = Gui::getViewportSnapshot();
     for (int y = dims.first.y; y <= dims.second.y; ++y) {
         for (int x = dims.first.x; x <= dims.second.x; ++x) {
             df::coord map_pos(*window_x + x, *window_y + y, *window_z);
 
-            if (!Maps::isValidTilePos(map_pos))
+            auto tile = view.get(x, y);
+            if (!tile || !tile->isValid())
                 continue;
 
-            if (!Maps::isTileVisible(map_pos)) {
+            if (!tile->isVisible()) {
                 TRACE(log).print("skipping hidden tile\n");
                 continue;
             }
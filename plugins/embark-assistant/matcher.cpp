@@ -17,6 +17,7 @@
 #include "df/world_region_type.h"
 
 #include "matcher.h"
+#include "parallel.h"
 #include "survey.h"
 
 using df::global::world;
@@ -2659,16 +2660,22 @@ namespace embark_assist {
             embark_assist::defs::finders *finder,
             embark_assist::defs::match_results *match_results) {
 //                        color_ostream_proxy out(Core::getInstance().getConsole());
-            uint32_t count = 0;
-            for (uint16_t i = 0; i < world->worldgen.worldgen_parms.dim_x; i++) {
+            //  Each column is matched independently and counted separately, the counts
+            //  are summed afterwards so the result does not depend on the scheduling.
+            std::vector<uint32_t> column_counts(world->worldgen.worldgen_parms.dim_x, 0);
+            embark_assist::parallel::for_each_index(world->worldgen.worldgen_parms.dim_x, [&](uint16_t i) {
                 for (uint16_t k = 0; k < world->worldgen.worldgen_parms.dim_y; k++) {
                     match_results->at(i).at(k).preliminary_match =
                         world_tile_match(survey_results, i, k, finder);
-                    if (match_results->at(i).at(k).preliminary_match) count++;
+                    if (match_results->at(i).at(k).preliminary_match) column_counts[i]++;
                     match_results->at(i).at(k).contains_match = false;
                 }
-            }
+            });
 
+            uint32_t count = 0;
+            for (auto column_count : column_counts) {
+                count += column_count;
+            }
             return count;
         }
 
@@ -3088,7 +3095,9 @@ uint16_t embark_assist::matcher::find(embark_assist::defs::match_iterators *iter
             embark_assist::matcher::move_cursor(iterator->x, iterator->y);
 
             if (!survey_results->at(0).at(0).survey_completed) {  // Every world tile has gone through preliminary survey, so add possible incursion resources to each tile.
-                for (uint16_t i = 0; i < world->worldgen.worldgen_parms.dim_x; i++) {
+                //  A tile only updates its own summary from its neighbours' edge data, which is not
+                //  changed by this pass, so the columns are processed in parallel.
+                embark_assist::parallel::for_each_index(world->worldgen.worldgen_parms.dim_x, [&](uint16_t i) {
                     for (uint16_t k = 0; k < world->worldgen.worldgen_parms.dim_y; k++) {
                         embark_assist::defs::region_tile_datum* current = &survey_results->at(i).at(k);
 
@@ -3317,7 +3326,7 @@ uint16_t embark_assist::matcher::find(embark_assist::defs::match_iterators *iter
 
                         survey_results->at(i).at(k).survey_completed = true;  //  A bit wasteful to add a flag to every entry when only the very first one is ever read...
                     }
-                }
+                });
             }
         }
     }
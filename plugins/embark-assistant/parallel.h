@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace embark_assist {
+    namespace parallel {
+        //  Calls fn(i) for every i in [0, count) on a set of worker threads, the
+        //  calling thread included. Indices are handed out one at a time, so fn
+        //  must only write to the result slots owned by its index and only read
+        //  DF state. Exceptions are rethrown on the calling thread.
+        //
+        template<typename Fn>
+        void for_each_index(uint16_t count, Fn fn) {
+            unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
+            num_threads = std::max(1u, std::min<unsigned>(num_threads, count));
+
+            std::vector<std::exception_ptr> errors(num_threads);
+            std::atomic<uint32_t> next(0);
+
+            auto worker = [&](unsigned idx) {
+                try {
+                    for (uint32_t i = next++; i < count; i = next++) {
+                        fn(i);
+                    }
+                }
+                catch (...) {
+                    errors[idx] = std::current_exception();
+                }
+            };
+
+            std::vector<std::thread> threads;
+            threads.reserve(num_threads - 1);
+            for (unsigned i = 1; i < num_threads; i++) {
+                threads.emplace_back(worker, i);
+            }
+            worker(0);
+            for (auto &thread : threads) {
+                thread.join();
+            }
+
+            for (auto &error : errors) {
+                if (error) std::rethrow_exception(error);
+            }
+        }
+    }
+}
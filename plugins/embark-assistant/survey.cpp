@@ -53,6 +53,7 @@
 #include "df/world_underground_region.h"
 
 #include "defs.h"
+#include "parallel.h"
 #include "survey.h"
 
 using namespace DFHack;
@@ -733,11 +734,14 @@ void embark_assist::survey::high_level_world_survey(embark_assist::defs::geo_dat
     embark_assist::defs::world_tile_data *survey_results) {
 //    color_ostream_proxy out(Core::getInstance().getConsole());
 
-    int16_t temperature;
-    bool negative;
-
     embark_assist::survey::geo_survey(geo_summary);
-    for (uint16_t i = 0; i < world->worldgen.worldgen_parms.dim_x; i++) {
+
+    //  Every world tile only reads the world data and writes its own slot in survey_results,
+    //  so the columns are surveyed in parallel.
+    embark_assist::parallel::for_each_index(world->worldgen.worldgen_parms.dim_x, [&](uint16_t i) {
+        int16_t temperature;
+        bool negative;
+
         for (uint16_t k = 0; k < world->worldgen.worldgen_parms.dim_y; k++) {
             df::coord2d adjusted;
             df::world_data *world_data = world->world_data;
@@ -887,7 +891,7 @@ void embark_assist::survey::high_level_world_survey(embark_assist::defs::geo_dat
                 if (results.evilness_count[l] == offset_count) results.evilness_count[l] = 256;
             }
         }
-    }
+    });
 
     embark_assist::survey::survey_evil_weather(survey_results);
 }
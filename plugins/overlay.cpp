@@ -46,25 +46,32 @@ namespace DFHack {
 static df::coord2d screenSize;
 static int32_t interfacePct = 100;
 
-static void overlay_interpose_lua(const char *fn_name, int nargs = 0, int nres = 0,
-        Lua::LuaLambda && args_lambda = Lua::DEFAULT_LUA_LAMBDA,
-        Lua::LuaLambda && res_lambda = Lua::DEFAULT_LUA_LAMBDA) {
-    DEBUG(event).print("calling overlay lua function: '%s'\n", fn_name);
+// called from every hooked viewscreen on every frame, so resolved once
+static Lua::FunctionRef update_widgets_fn("plugins.overlay", "update_viewscreen_widgets");
+static Lua::FunctionRef feed_widgets_fn("plugins.overlay", "feed_viewscreen_widgets");
+static Lua::FunctionRef render_widgets_fn("plugins.overlay", "render_viewscreen_widgets");
 
-    CoreSuspender guard;
+template<typename ArgFn, typename ResFn>
+static void overlay_interpose_lua(Lua::FunctionRef &fn, int nargs, int nres,
+        ArgFn &&args_fn, ResFn &&res_fn) {
+    DEBUG(event).print("calling overlay lua function: '%s'\n", fn.getName());
 
-    color_ostream & out = Core::getInstance().getConsole();
-    auto L = Lua::Core::State;
+    CoreSuspender guard;
 
     auto & core = Core::getInstance();
+    color_ostream & out = core.getConsole();
     auto & counters = core.perf_counters;
-    uint32_t start_ms = core.p->getTickCount();
+    uint64_t start_ns = PerfCounters::getTimestampNs();
 
-    Lua::CallLuaModuleFunction(out, L, "plugins.overlay", fn_name, nargs, nres,
-                               std::forward<Lua::LuaLambda&&>(args_lambda),
-                               std::forward<Lua::LuaLambda&&>(res_lambda));
+    fn.invoke(out, Lua::Core::State, nargs, nres,
+              std::forward<ArgFn>(args_fn), std::forward<ResFn>(res_fn));
+
+    counters.incCounter(counters.total_overlay_ms, start_ns);
+}
 
-    counters.incCounter(counters.total_overlay_ms, start_ms);
+template<typename ArgFn>
+static void overlay_interpose_lua(Lua::FunctionRef &fn, int nargs, ArgFn &&args_fn) {
+    overlay_interpose_lua(fn, nargs, 0, std::forward<ArgFn>(args_fn), [](lua_State *) {});
 }
 
 template<class T>
@@ -73,7 +80,7 @@ struct viewscreen_overlay : T {
 
     DEFINE_VMETHOD_INTERPOSE(void, logic, ()) {
         INTERPOSE_NEXT(logic)();
-        overlay_interpose_lua("update_viewscreen_widgets", 2, 0,
+        overlay_interpose_lua(update_widgets_fn, 2,
                 [&](lua_State *L) {
                     Lua::Push(L, T::_identity.getName());
                     Lua::Push(L, this);
@@ -83,7 +90,7 @@ struct viewscreen_overlay : T {
         bool input_is_handled = false;
         // don't send input to the overlays if there is a modal dialog up
         if (!world->status.popups.size()) {
-            overlay_interpose_lua("feed_viewscreen_widgets", 3, 1,
+            overlay_interpose_lua(feed_widgets_fn, 3, 1,
                     [&](lua_State *L) {
                         Lua::Push(L, T::_identity.getName());
                         Lua::Push(L, this);
@@ -99,7 +106,7 @@ struct viewscreen_overlay : T {
     }
     DEFINE_VMETHOD_INTERPOSE(void, render, (uint32_t curtick)) {
         INTERPOSE_NEXT(render)(curtick);
-        overlay_interpose_lua("render_viewscreen_widgets", 2, 0,
+        overlay_interpose_lua(render_widgets_fn, 2,
                 [&](lua_State *L) {
                     Lua::Push(L, T::_identity.getName());
                     Lua::Push(L, this);
@@ -196,7 +203,11 @@ DFhackCExport command_result plugin_init(color_ostream &out, vector<PluginComman
 }
 
 DFhackCExport command_result plugin_shutdown(color_ostream &out) {
-    return plugin_enable(out, false);
+    command_result res = plugin_enable(out, false);
+    update_widgets_fn.reset();
+    feed_widgets_fn.reset();
+    render_widgets_fn.reset();
+    return res;
 }
 
 DFhackCExport command_result plugin_onupdate (color_ostream &out) {
@@ -211,9 +222,9 @@ DFhackCExport command_result plugin_onupdate (color_ostream &out) {
     return CR_OK;
 }
 
-static void record_widget_runtime(string name, uint32_t start_ms) {
+static void record_widget_runtime(string name, uint64_t start_ns) {
     auto & counters = Core::getInstance().perf_counters;
-    counters.incCounter(counters.overlay_per_widget[name.c_str()], start_ms);
+    counters.incCounter(counters.overlay_per_widget[name.c_str()], start_ns);
 }
 
 DFHACK_PLUGIN_LUA_FUNCTIONS {
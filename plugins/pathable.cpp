@@ -14,7 +14,6 @@
 #include "df/world.h"
 
 using namespace DFHack;
-using std::stack;
 using std::unordered_set;
 
 DFHACK_PLUGIN("pathable");
@@ -65,6 +64,7 @@ static void paint_screen(const PaintCtx & ctx, const unordered_set<df::coord> &
     bool show_hidden, std::function<bool(const df::coord & pos)> get_can_walk)
 {
     auto dims = Gui::getDwarfmodeViewDims().map();
+    auto &view = Gui::getViewportSnapshot();
     for (int y = dims.first.y; y <= dims.second.y; ++y) {
         for (int x = dims.first.x; x <= dims.second.x; ++x) {
             df::coord map_pos(*window_x + x, *window_y + y, *window_z);
@@ -78,7 +78,8 @@ static void paint_screen(const PaintCtx & ctx, const unordered_set<df::coord> &
                 continue;
             }
 
-            if (!show_hidden && !Maps::isTileVisible(map_pos)) {
+            auto tile = view.get(x, y);
+            if (!show_hidden && (!tile || !tile->isVisible())) {
                 TRACE(log).print("skipping hidden tile\n");
                 continue;
             }
@@ -193,15 +194,26 @@ static bool getDepotAccessibleByAnimals() {
 
 struct FloodCtx {
     uint16_t wgroup;
-    unordered_set<df::coord> & wagon_path;
-    unordered_set<df::coord> seen; // contains tiles that should not be added to search_edge
-    stack<df::coord> search_edge;  // contains tiles that can be successfully moved into
+    Maps::FloodFill & flood;
     const unordered_set<df::coord> & entry_tiles;
+    unordered_set<df::coord> * wagon_path;
+    bool found = false;
 
-    FloodCtx(uint16_t wgroup, unordered_set<df::coord> & wagon_path, const unordered_set<df::coord> & entry_tiles)
-        : wgroup(wgroup), wagon_path(wagon_path), entry_tiles(entry_tiles) {}
+    FloodCtx(uint16_t wgroup, Maps::FloodFill & flood, const unordered_set<df::coord> & entry_tiles,
+        unordered_set<df::coord> * wagon_path)
+        : wgroup(wgroup), flood(flood), entry_tiles(entry_tiles), wagon_path(wagon_path) {}
 };
 
+// the far end of a ramp is not itself checked for width or added to the path,
+// but it is expanded from every time it is reached, even if it was rejected
+// as a wagon tile before
+static void follow_ramp(FloodCtx & ctx, const df::coord & pos) {
+    if (ctx.entry_tiles.contains(pos))
+        ctx.found = true;
+    else
+        ctx.flood.expandFrom(pos);
+}
+
 static bool is_wagon_traversible(FloodCtx & ctx, const df::coord & pos, const df::coord & prev_pos) {
     if (auto bld = Buildings::findAtTile(pos)) {
         if (bld->getType() == df::building_type::Trap)
@@ -219,7 +231,7 @@ static bool is_wagon_traversible(FloodCtx & ctx, const df::coord & pos, const df
     if (shape == df::tiletype_shape::RAMP_TOP ) {
         df::coord pos_below = pos + df::coord(0, 0, -1);
         if (Maps::getWalkableGroup(pos_below)) {
-            ctx.search_edge.emplace(pos_below);
+            follow_ramp(ctx, pos_below);
             return true;
         }
     } else if (shape == df::tiletype_shape::WALL) {
@@ -227,7 +239,7 @@ static bool is_wagon_traversible(FloodCtx & ctx, const df::coord & pos, const df
         if (prev_tt && tileShape(*prev_tt) == df::tiletype_shape::RAMP) {
             df::coord pos_above = pos + df::coord(0, 0, 1);
             if (Maps::getWalkableGroup(pos_above)) {
-                ctx.search_edge.emplace(pos_above);
+                follow_ramp(ctx, pos_above);
                 return true;
             }
         }
@@ -236,30 +248,23 @@ static bool is_wagon_traversible(FloodCtx & ctx, const df::coord & pos, const df
     return false;
 }
 
-static void check_wagon_tile(FloodCtx & ctx, const df::coord & pos) {
-    if (ctx.seen.contains(pos))
-        return;
-
-    ctx.seen.emplace(pos);
-
+// entry tiles are part of the path, but the search does not continue past them
+static bool is_wagon_tile(FloodCtx & ctx, const df::coord & pos) {
     if (ctx.entry_tiles.contains(pos)) {
-        ctx.wagon_path.emplace(pos);
-        ctx.search_edge.emplace(pos);
-        return;
+        if (ctx.wagon_path)
+            ctx.wagon_path->emplace(pos);
+        ctx.found = true;
+        return false;
     }
 
-    if (is_wagon_traversible(ctx, pos+df::coord(-1, -1, 0), pos) &&
+    return is_wagon_traversible(ctx, pos+df::coord(-1, -1, 0), pos) &&
         is_wagon_traversible(ctx, pos+df::coord( 0, -1, 0), pos) &&
         is_wagon_traversible(ctx, pos+df::coord( 1, -1, 0), pos) &&
         is_wagon_traversible(ctx, pos+df::coord(-1,  0, 0), pos) &&
         is_wagon_traversible(ctx, pos+df::coord( 1,  0, 0), pos) &&
         is_wagon_traversible(ctx, pos+df::coord(-1,  1, 0), pos) &&
         is_wagon_traversible(ctx, pos+df::coord( 0,  1, 0), pos) &&
-        is_wagon_traversible(ctx, pos+df::coord( 1,  1, 0), pos))
-    {
-        ctx.wagon_path.emplace(pos);
-        ctx.search_edge.emplace(pos);
-    }
+        is_wagon_traversible(ctx, pos+df::coord( 1,  1, 0), pos);
 }
 
 // returns true if a continuous 3-wide path can be found to an entry tile
@@ -270,31 +275,26 @@ static void check_wagon_tile(FloodCtx & ctx, const df::coord & pos) {
 static bool wagon_flood(unordered_set<df::coord> * wagon_path, const df::coord & depot_pos,
     const unordered_set<df::coord> & entry_tiles)
 {
-    bool found = false;
-    unordered_set<df::coord> temp_wagon_path;
-    FloodCtx ctx(Maps::getWalkableGroup(depot_pos), wagon_path ? *wagon_path : temp_wagon_path, entry_tiles);
+    if (entry_tiles.contains(depot_pos)) {
+        if (wagon_path)
+            wagon_path->emplace(depot_pos);
+        return true;
+    }
 
-    ctx.wagon_path.emplace(depot_pos);
-    ctx.seen.emplace(depot_pos);
-    ctx.search_edge.emplace(depot_pos);
-    while (!ctx.search_edge.empty()) {
-        df::coord pos = ctx.search_edge.top();
-        ctx.search_edge.pop();
+    Maps::FloodFill flood(Maps::FloodFill::ORTHOGONAL);
+    FloodCtx ctx(Maps::getWalkableGroup(depot_pos), flood, entry_tiles, wagon_path);
 
-        if (entry_tiles.contains(pos)) {
-            found = true;
-            if (!wagon_path)
-                break;
-            continue;
-        }
-
-        check_wagon_tile(ctx, pos+df::coord( 0, -1, 0));
-        check_wagon_tile(ctx, pos+df::coord( 0,  1, 0));
-        check_wagon_tile(ctx, pos+df::coord(-1,  0, 0));
-        check_wagon_tile(ctx, pos+df::coord( 1,  0, 0));
-    }
+    flood.addSeed(depot_pos);
+    flood.run([&](const df::coord & pos) { return is_wagon_tile(ctx, pos); },
+        [&](const df::coord & pos) {
+            if (ctx.found && !wagon_path)
+                return false;
+            if (wagon_path)
+                wagon_path->emplace(pos);
+            return true;
+        });
 
-    return found;
+    return ctx.found;
 }
 
 static unordered_set<df::coord> wagon_path;
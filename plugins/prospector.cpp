@@ -119,6 +119,14 @@ struct matdata
         }
         return count;
     }
+    void merge(const matdata &other)
+    {
+        count += other.count;
+        if (other.lower_z != invalid_z && (lower_z == invalid_z || other.lower_z < lower_z))
+            lower_z = other.lower_z;
+        if (other.upper_z != invalid_z && (upper_z == invalid_z || other.upper_z > upper_z))
+            upper_z = other.upper_z;
+    }
     float count;
     int lower_z;
     int upper_z;
@@ -621,23 +629,14 @@ static command_result embark_prospector(color_ostream &out,
     return CR_OK;
 }
 
-static command_result map_prospector(color_ostream &con,
-                                     const prospect_options &options) {
-    if (!Maps::IsValid())
-    {
-        con.printerr("Map is not available!\n");
-        return CR_FAILURE;
-    }
-
-    uint32_t x_max = 0, y_max = 0, z_max = 0;
-    Maps::getSize(x_max, y_max, z_max);
-    MapExtras::MapCache map;
-
-    DFHack::Materials *mats = Core::getInstance().getMaterials();
-
-    DFHack::t_feature blockFeatureGlobal;
-    DFHack::t_feature blockFeatureLocal;
+static void merge_mats(MatMap &into, const MatMap &from)
+{
+    for (auto &entry : from)
+        into[entry.first].merge(entry.second);
+}
 
+struct prospect_tallies
+{
     bool hasDemonTemple = false;
     bool hasLair = false;
     MatMap baseMats;
@@ -651,162 +650,201 @@ static command_result map_prospector(color_ostream &con,
     matdata aquiferTiles;
     matdata tubeTiles;
 
-    for(uint32_t z = 0; z < z_max; z++)
+    void merge(const prospect_tallies &other)
     {
-        // the '- 100' is because DF v50 and later have a 100 offset in reported elevation
-        int global_z = world->map.region_z + z - 100;
+        hasDemonTemple |= other.hasDemonTemple;
+        hasLair |= other.hasLair;
+        merge_mats(baseMats, other.baseMats);
+        merge_mats(layerMats, other.layerMats);
+        merge_mats(veinMats, other.veinMats);
+        merge_mats(plantMats, other.plantMats);
+        merge_mats(treeMats, other.treeMats);
+        liquidWater.merge(other.liquidWater);
+        liquidMagma.merge(other.liquidMagma);
+        aquiferTiles.merge(other.aquiferTiles);
+        tubeTiles.merge(other.tubeTiles);
+    }
+};
 
-        for(uint32_t b_y = 0; b_y < y_max; b_y++)
+// Tallies a single map block. Runs on the block scan worker threads, so it
+// must only read game state.
+static void scan_block(MapExtras::Block *b, prospect_tallies &t,
+                       const prospect_options &options)
+{
+    DFHack::DFCoord bcoord = b->getCoord();
+    uint32_t z = bcoord.z;
+    // the '- 100' is because DF v50 and later have a 100 offset in reported elevation
+    int global_z = world->map.region_z + z - 100;
+
+    // Find features
+    DFHack::t_feature blockFeatureGlobal;
+    DFHack::t_feature blockFeatureLocal;
+    b->GetGlobalFeature(&blockFeatureGlobal);
+    b->GetLocalFeature(&blockFeatureLocal);
+
+    // Tally the designation and occupancy flags a whole block at a time
+    df::map_block *block = b->getRaw();
+    df::tile_bitmask visible;
+    if (options.hidden)
+        visible.set_all();
+    else
+        visible = Maps::getTileMask(block, [](df::tiletype, df::tile_designation des, df::tile_occupancy) {
+            return !des.bits.hidden;
+        });
+
+    auto add_tiles = [&](matdata &data, df::tile_bitmask mask) {
+        mask &= visible;
+        if (int count = Maps::countTiles(mask))
+            data.add(global_z, count);
+    };
+    add_tiles(t.aquiferTiles, Maps::getTileMask(block, [](df::tiletype, df::tile_designation des, df::tile_occupancy) {
+        return des.bits.water_table;
+    }));
+    add_tiles(t.liquidMagma, Maps::getTileMask(block, [](df::tiletype, df::tile_designation des, df::tile_occupancy) {
+        return des.bits.flow_size && des.bits.liquid_type == tile_liquid::Magma;
+    }));
+    add_tiles(t.liquidWater, Maps::getTileMask(block, [](df::tiletype, df::tile_designation des, df::tile_occupancy) {
+        return des.bits.flow_size && des.bits.liquid_type != tile_liquid::Magma;
+    }));
+    auto lairs = Maps::getTileMask(block, [](df::tiletype, df::tile_designation, df::tile_occupancy occ) {
+        return occ.bits.monster_lair;
+    });
+    lairs &= visible;
+    if (lairs.has_assignments())
+        t.hasLair = true;
+
+    // Iterate over the visible tiles in the block
+    for(uint32_t y = 0; y < 16; y++)
+    {
+        for(uint32_t x = 0; x < 16; x++)
         {
-            for(uint32_t b_x = 0; b_x < x_max; b_x++)
+            df::coord2d coord(x, y);
+            if (!visible.getassignment(coord))
+                continue;
+            df::tile_designation des = b->DesignationAt(coord);
+
+            df::tiletype type = b->tiletypeAt(coord);
+            df::tiletype_shape tileshape = tileShape(type);
+            df::tiletype_material tilemat = tileMaterial(type);
+
+            // We only care about these types
+            switch (tileshape)
             {
-                // Get the map block
-                df::coord2d blockCoord(b_x, b_y);
-                MapExtras::Block *b = map.BlockAt(DFHack::DFCoord(b_x, b_y, z));
-                if (!b || !b->is_valid())
+            case tiletype_shape::WALL:
+            case tiletype_shape::FORTIFICATION:
+                break;
+            case tiletype_shape::EMPTY:
+                /* A heuristic: tubes inside adamantine have EMPTY:AIR tiles which
+                   still have feature_local set. Also check the unrevealed status,
+                   so as to exclude any holes mined by the player. */
+                if (tilemat == tiletype_material::AIR &&
+                    des.bits.feature_local && des.bits.hidden &&
+                    blockFeatureLocal.type == feature_type::deep_special_tube)
                 {
-                    continue;
+                    t.tubeTiles.add(global_z);
                 }
+            default:
+                continue;
+            }
 
-                // Find features
-                b->GetGlobalFeature(&blockFeatureGlobal);
-                b->GetLocalFeature(&blockFeatureLocal);
+            // Count the material type
+            t.baseMats[tilemat].add(global_z);
 
-                // Iterate over all the tiles in the block
-                for(uint32_t y = 0; y < 16; y++)
+            // Find the type of the tile
+            switch (tilemat)
+            {
+            case tiletype_material::SOIL:
+            case tiletype_material::STONE:
+                t.layerMats[b->layerMaterialAt(coord)].add(global_z);
+                break;
+            case tiletype_material::MINERAL:
+                t.veinMats[b->veinMaterialAt(coord)].add(global_z);
+                break;
+            case tiletype_material::FEATURE:
+                if (blockFeatureLocal.type != -1 && des.bits.feature_local)
                 {
-                    for(uint32_t x = 0; x < 16; x++)
+                    if (blockFeatureLocal.type == feature_type::deep_special_tube
+                            && blockFeatureLocal.main_material == 0) // stone
                     {
-                        df::coord2d coord(x, y);
-                        df::tile_designation des = b->DesignationAt(coord);
-                        df::tile_occupancy occ = b->OccupancyAt(coord);
-
-                        // Skip hidden tiles
-                        if (!options.hidden && des.bits.hidden)
-                        {
-                            continue;
-                        }
-
-                        // Check for aquifer
-                        if (des.bits.water_table)
-                        {
-                            aquiferTiles.add(global_z);
-                        }
-
-                        // Check for lairs
-                        if (occ.bits.monster_lair)
-                        {
-                            hasLair = true;
-                        }
-
-                        // Check for liquid
-                        if (des.bits.flow_size)
-                        {
-                            if (des.bits.liquid_type == tile_liquid::Magma)
-                                liquidMagma.add(global_z);
-                            else
-                                liquidWater.add(global_z);
-                        }
-
-                        df::tiletype type = b->tiletypeAt(coord);
-                        df::tiletype_shape tileshape = tileShape(type);
-                        df::tiletype_material tilemat = tileMaterial(type);
-
-                        // We only care about these types
-                        switch (tileshape)
-                        {
-                        case tiletype_shape::WALL:
-                        case tiletype_shape::FORTIFICATION:
-                            break;
-                        case tiletype_shape::EMPTY:
-                            /* A heuristic: tubes inside adamantine have EMPTY:AIR tiles which
-                               still have feature_local set. Also check the unrevealed status,
-                               so as to exclude any holes mined by the player. */
-                            if (tilemat == tiletype_material::AIR &&
-                                des.bits.feature_local && des.bits.hidden &&
-                                blockFeatureLocal.type == feature_type::deep_special_tube)
-                            {
-                                tubeTiles.add(global_z);
-                            }
-                        default:
-                            continue;
-                        }
-
-                        // Count the material type
-                        baseMats[tilemat].add(global_z);
-
-                        // Find the type of the tile
-                        switch (tilemat)
-                        {
-                        case tiletype_material::SOIL:
-                        case tiletype_material::STONE:
-                            layerMats[b->layerMaterialAt(coord)].add(global_z);
-                            break;
-                        case tiletype_material::MINERAL:
-                            veinMats[b->veinMaterialAt(coord)].add(global_z);
-                            break;
-                        case tiletype_material::FEATURE:
-                            if (blockFeatureLocal.type != -1 && des.bits.feature_local)
-                            {
-                                if (blockFeatureLocal.type == feature_type::deep_special_tube
-                                        && blockFeatureLocal.main_material == 0) // stone
-                                {
-                                    veinMats[blockFeatureLocal.sub_material].add(global_z);
-                                }
-                                else if (blockFeatureLocal.type == feature_type::deep_surface_portal)
-                                {
-                                    hasDemonTemple = true;
-                                }
-                            }
-
-                            if (blockFeatureGlobal.type != -1 && des.bits.feature_global
-                                    && blockFeatureGlobal.type == feature_type::underworld_from_layer
-                                    && blockFeatureGlobal.main_material == 0) // stone
-                            {
-                                layerMats[blockFeatureGlobal.sub_material].add(global_z);
-                            }
-                            break;
-                        case tiletype_material::LAVA_STONE:
-                            // TODO ?
-                            break;
-                        default:
-                            break;
-                        }
+                        t.veinMats[blockFeatureLocal.sub_material].add(global_z);
+                    }
+                    else if (blockFeatureLocal.type == feature_type::deep_surface_portal)
+                    {
+                        t.hasDemonTemple = true;
                     }
                 }
 
-                // Check plants this way, as the other way wasn't getting them all
-                // and we can check visibility more easily here
-                if (options.shrubs)
+                if (blockFeatureGlobal.type != -1 && des.bits.feature_global
+                        && blockFeatureGlobal.type == feature_type::underworld_from_layer
+                        && blockFeatureGlobal.main_material == 0) // stone
                 {
-                    auto block = Maps::getBlockColumn(b_x,b_y);
-                    vector<df::plant *> *plants = block ? &block->plants : NULL;
-                    if(plants)
-                    {
-                        for (PlantList::const_iterator it = plants->begin(); it != plants->end(); it++)
-                        {
-                            const df::plant & plant = *(*it);
-                            if (uint32_t(plant.pos.z) != z)
-                                continue;
-                            df::coord2d loc(plant.pos.x, plant.pos.y);
-                            loc = loc % 16;
-                            if (options.hidden || !b->DesignationAt(loc).bits.hidden)
-                            {
-                                if (ENUM_ATTR(plant_type, is_shrub, plant.type))
-                                    plantMats[plant.material].add(global_z);
-                                else
-                                    treeMats[plant.material].add(global_z);
-                            }
-                        }
-                    }
+                    t.layerMats[blockFeatureGlobal.sub_material].add(global_z);
+                }
+                break;
+            case tiletype_material::LAVA_STONE:
+                // TODO ?
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    // Check plants this way, as the other way wasn't getting them all
+    // and we can check visibility more easily here
+    if (options.shrubs)
+    {
+        auto block = Maps::getBlockColumn(bcoord.x, bcoord.y);
+        vector<df::plant *> *plants = block ? &block->plants : NULL;
+        if(plants)
+        {
+            for (PlantList::const_iterator it = plants->begin(); it != plants->end(); it++)
+            {
+                const df::plant & plant = *(*it);
+                if (uint32_t(plant.pos.z) != z)
+                    continue;
+                df::coord2d loc(plant.pos.x, plant.pos.y);
+                loc = loc % 16;
+                if (options.hidden || !b->DesignationAt(loc).bits.hidden)
+                {
+                    if (ENUM_ATTR(plant_type, is_shrub, plant.type))
+                        t.plantMats[plant.material].add(global_z);
+                    else
+                        t.treeMats[plant.material].add(global_z);
                 }
-                // Block end
-            } // block x
+            }
+        }
+    }
+}
+
+static command_result map_prospector(color_ostream &con,
+                                     const prospect_options &options) {
+    if (!Maps::IsValid())
+    {
+        con.printerr("Map is not available!\n");
+        return CR_FAILURE;
+    }
+
+    DFHack::Materials *mats = Core::getInstance().getMaterials();
 
-            // Clean uneeded memory
-            map.trash();
-        } // block y
-    } // z
+    // each worker thread of the block scan fills its own tallies; they are
+    // merged once the whole map has been visited
+    prospect_tallies tallies = MapExtras::parallelScanBlocks<prospect_tallies>(
+        [&](MapExtras::Block *b, prospect_tallies &t) { scan_block(b, t, options); },
+        [](prospect_tallies &into, const prospect_tallies &from) { into.merge(from); });
+
+    bool hasDemonTemple = tallies.hasDemonTemple;
+    bool hasLair = tallies.hasLair;
+    MatMap &baseMats = tallies.baseMats;
+    MatMap &layerMats = tallies.layerMats;
+    MatMap &veinMats = tallies.veinMats;
+    MatMap &plantMats = tallies.plantMats;
+    MatMap &treeMats = tallies.treeMats;
+
+    matdata &liquidWater = tallies.liquidWater;
+    matdata &liquidMagma = tallies.liquidMagma;
+    matdata &aquiferTiles = tallies.aquiferTiles;
+    matdata &tubeTiles = tallies.tubeTiles;
 
     MatMap::const_iterator it;
 
@@ -0,0 +1,261 @@
+#include "block_stream.h"
+
+#include "DataDefs.h"
+
+#include "modules/Maps.h"
+
+#include "df/map_block.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include <zlib.h>
+
+using namespace DFHack;
+using namespace RemoteFortressReader;
+
+// don't bother compressing payloads smaller than this
+static const size_t MIN_COMPRESS_SIZE = 64;
+
+// the largest area a single client may subscribe to, in blocks
+static const size_t MAX_SUBSCRIBED_BLOCKS = 1 << 18;
+
+// Rather than a copy of the block, only a hash of each x column of tiles is
+// kept, so a large subscription costs ~80 bytes per block instead of ~2.5KB.
+// A changed column is resent whole. A 32-bit hash collision would hide a
+// change in that column until it changes again.
+//
+// DF keeps no per-block change counter for these arrays, so every poll still
+// reads and hashes every subscribed block; what the stream saves is the
+// encoding and the bytes on the wire, not the scan. Clients should subscribe
+// to the area they display rather than the whole map.
+struct BlockStreamService::SentBlock
+{
+    df::map_block *block;
+    uint32_t column_hash[16];
+};
+
+static const uint16_t ALL_COLUMNS = 0xFFFF;
+
+static inline uint32_t hash_words(uint32_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i + 4 <= size; i += 4)
+    {
+        uint32_t word;
+        memcpy(&word, bytes + i, 4);
+        hash = (hash ^ word) * 0x01000193;
+        hash ^= hash >> 15;
+    }
+    return hash;
+}
+
+// tiletype, designation and occupancy are indexed [x][y], so each x column
+// is contiguous in all three arrays
+static void hash_columns(df::map_block *block, uint32_t (&out)[16])
+{
+    for (int x = 0; x < 16; x++)
+    {
+        uint32_t hash = 0x811c9dc5;
+        hash = hash_words(hash, block->tiletype[x], sizeof(block->tiletype[x]));
+        hash = hash_words(hash, block->designation[x], sizeof(block->designation[x]));
+        hash = hash_words(hash, block->occupancy[x], sizeof(block->occupancy[x]));
+        out[x] = hash;
+    }
+}
+
+BlockStreamService::BlockStreamService()
+    : min_x(0), max_x(0), min_y(0), max_y(0), min_z(0), max_z(0), compress(false),
+      map_size_x(0), map_size_y(0), map_size_z(0)
+{
+    addMethod("SubscribeBlocks", &BlockStreamService::SubscribeBlocks, SF_ALLOW_REMOTE);
+    addMethod("GetBlockUpdates", &BlockStreamService::GetBlockUpdates, SF_ALLOW_REMOTE);
+}
+
+void BlockStreamService::resetSentBlocks()
+{
+    sent_blocks.clear();
+    size_t volume = size_t(max_x - min_x) * size_t(max_y - min_y) * size_t(max_z - min_z);
+    sent_blocks.resize(volume);
+    Maps::getSize(map_size_x, map_size_y, map_size_z);
+}
+
+command_result BlockStreamService::SubscribeBlocks(color_ostream &stream, const BlockSubscription *in)
+{
+    if (!Maps::IsValid())
+        return CR_NOT_FOUND;
+
+    uint32_t size_x, size_y, size_z;
+    Maps::getSize(size_x, size_y, size_z);
+
+    min_x = std::max(0, in->min_x());
+    min_y = std::max(0, in->min_y());
+    min_z = std::max(0, in->min_z());
+    max_x = std::max(min_x, std::min<int>(size_x, in->max_x()));
+    max_y = std::max(min_y, std::min<int>(size_y, in->max_y()));
+    max_z = std::max(min_z, std::min<int>(size_z, in->max_z()));
+    compress = in->compress();
+
+    size_t volume = size_t(max_x - min_x) * size_t(max_y - min_y) * size_t(max_z - min_z);
+    if (volume > MAX_SUBSCRIBED_BLOCKS)
+    {
+        stream.printerr("Block subscription of %zu blocks is too large.\n", volume);
+        max_x = min_x; max_y = min_y; max_z = min_z;
+        resetSentBlocks();
+        return CR_WRONG_USAGE;
+    }
+
+    resetSentBlocks();
+    return CR_OK;
+}
+
+static void put_varint(std::string &buf, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        buf.push_back(char(value | 0x80));
+        value >>= 7;
+    }
+    buf.push_back(char(value));
+}
+
+struct tile_value
+{
+    uint32_t tiletype;
+    uint32_t designation;
+    uint32_t occupancy;
+
+    bool operator==(const tile_value &other) const
+    {
+        return tiletype == other.tiletype && designation == other.designation && occupancy == other.occupancy;
+    }
+};
+
+static tile_value get_tile(df::map_block *block, int i)
+{
+    int x = i & 15, y = i >> 4;
+    return tile_value{
+        uint32_t(uint16_t(block->tiletype[x][y])),
+        block->designation[x][y].whole,
+        block->occupancy[x][y].whole };
+}
+
+static bool is_column_changed(uint16_t columns, int i)
+{
+    return (columns >> (i & 15)) & 1;
+}
+
+// appends run-length records for the tiles in the given mask of x columns
+static void encode_runs(df::map_block *block, uint16_t columns, std::string &out)
+{
+    int prev_end = 0;
+    int i = 0;
+    while (i < 256)
+    {
+        if (!is_column_changed(columns, i))
+        {
+            i++;
+            continue;
+        }
+        tile_value value = get_tile(block, i);
+        int start = i++;
+        while (i < 256 && is_column_changed(columns, i) && get_tile(block, i) == value)
+            i++;
+        put_varint(out, start - prev_end);
+        put_varint(out, i - start);
+        put_varint(out, value.tiletype);
+        put_varint(out, value.designation);
+        put_varint(out, value.occupancy);
+        prev_end = i;
+    }
+}
+
+static bool compress_runs(const std::string &runs, std::string &out)
+{
+    uLongf size = compressBound(runs.size());
+    out.resize(size);
+    if (compress2((Bytef *)&out[0], &size, (const Bytef *)runs.data(), runs.size(), Z_BEST_SPEED) != Z_OK)
+        return false;
+    if (size >= runs.size())
+        return false;
+    out.resize(size);
+    return true;
+}
+
+command_result BlockStreamService::GetBlockUpdates(color_ostream &stream, const EmptyMessage *in, BlockUpdateList *out)
+{
+    if (!Maps::IsValid())
+        return CR_NOT_FOUND;
+
+    int x, y, z;
+    Maps::getPosition(x, y, z);
+    out->set_map_x(x);
+    out->set_map_y(y);
+
+    uint32_t size_x, size_y, size_z;
+    Maps::getSize(size_x, size_y, size_z);
+    if (size_x != map_size_x || size_y != map_size_y || size_z != map_size_z)
+    {
+        max_x = std::min<int>(max_x, size_x);
+        max_y = std::min<int>(max_y, size_y);
+        max_z = std::min<int>(max_z, size_z);
+        min_x = std::min(min_x, max_x);
+        min_y = std::min(min_y, max_y);
+        min_z = std::min(min_z, max_z);
+        resetSentBlocks();
+    }
+
+    std::string runs;
+    std::string packed;
+    uint32_t column_hash[16];
+    size_t idx = 0;
+    for (int zz = min_z; zz < max_z; zz++)
+        for (int yy = min_y; yy < max_y; yy++)
+            for (int xx = min_x; xx < max_x; xx++, idx++)
+            {
+                auto &sent = sent_blocks[idx];
+                df::map_block *block = Maps::getBlock(xx, yy, zz);
+                if (!block)
+                {
+                    sent.reset();
+                    continue;
+                }
+
+                hash_columns(block, column_hash);
+                bool full = !sent || sent->block != block;
+                uint16_t columns = full ? ALL_COLUMNS : 0;
+                if (!full)
+                {
+                    for (int col = 0; col < 16; col++)
+                        if (column_hash[col] != sent->column_hash[col])
+                            columns |= 1 << col;
+                    if (!columns)
+                        continue;
+                }
+
+                runs.clear();
+                encode_runs(block, columns, runs);
+
+                if (!sent)
+                    sent.reset(new SentBlock());
+                sent->block = block;
+                memcpy(sent->column_hash, column_hash, sizeof(column_hash));
+
+                auto delta = out->add_blocks();
+                delta->set_map_x(block->map_pos.x);
+                delta->set_map_y(block->map_pos.y);
+                delta->set_map_z(block->map_pos.z);
+                delta->set_full(full);
+                delta->set_raw_size(runs.size());
+                if (compress && runs.size() >= MIN_COMPRESS_SIZE && compress_runs(runs, packed))
+                {
+                    delta->set_compressed(true);
+                    delta->set_tile_runs(packed);
+                }
+                else
+                    delta->set_tile_runs(runs);
+            }
+
+    return CR_OK;
+}
@@ -0,0 +1,42 @@
+#ifndef BLOCK_STREAM_H
+#define BLOCK_STREAM_H
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "RemoteServer.h"
+#include "RemoteFortressReader.pb.h"
+
+// Connection-specific RPC service. Each client gets its own instance, which
+// remembers what block data was last sent to that client so that
+// GetBlockUpdates only has to send the tiles that changed since then.
+// Only tiletype, designation and occupancy are streamed; spatter, base
+// materials, items, buildings and flows still come from GetBlockList.
+class BlockStreamService : public DFHack::RPCService
+{
+public:
+    struct SentBlock;
+
+    BlockStreamService();
+
+    DFHack::command_result SubscribeBlocks(DFHack::color_ostream &stream, const RemoteFortressReader::BlockSubscription *in);
+    DFHack::command_result GetBlockUpdates(DFHack::color_ostream &stream, const DFHack::EmptyMessage *in, RemoteFortressReader::BlockUpdateList *out);
+
+private:
+    void resetSentBlocks();
+
+    int min_x, max_x;
+    int min_y, max_y;
+    int min_z, max_z;
+    bool compress;
+
+    // map size when the subscription state was built; a different size means
+    // a different map was loaded and everything has to be resent
+    uint32_t map_size_x, map_size_y, map_size_z;
+
+    // hashes of the last data sent for every block in the subscribed area,
+    // indexed densely in z/y/x order. null means nothing was sent for that
+    // block yet.
+    std::vector<std::unique_ptr<SentBlock>> sent_blocks;
+};
+
+#endif
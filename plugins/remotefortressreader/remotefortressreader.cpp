@@ -126,6 +126,7 @@
 #include "df/unit_relationship_type.h"
 
 #include "adventure_control.h"
+#include "block_stream.h"
 #include "building_reader.h"
 #include "dwarf_control.h"
 #include "item_reader.h"
@@ -248,7 +249,7 @@ DFhackCExport command_result plugin_init(color_ostream &out, std::vector <Plugin
 
 DFhackCExport RPCService *plugin_rpcconnect(color_ostream &)
 {
-    RPCService *svc = new RPCService();
+    RPCService *svc = new BlockStreamService();
     svc->addFunction("GetMaterialList", GetMaterialList, SF_ALLOW_REMOTE);
     svc->addFunction("GetGrowthList", GetGrowthList, SF_ALLOW_REMOTE);
     svc->addFunction("GetBlockList", GetBlockList, SF_ALLOW_REMOTE);
@@ -1424,20 +1425,13 @@ static command_result GetBlockList(color_ostream &stream, const BlockRequest *in
                 df::map_block * block = DFHack::Maps::getBlock(pos);
                 if (block != NULL)
                 {
-                    bool nonAir = false;
-                    for (int xxx = 0; xxx < 16; xxx++)
-                        for (int yyy = 0; yyy < 16; yyy++)
-                        {
-                            if ((DFHack::tileShapeBasic(DFHack::tileShape(block->tiletype[xxx][yyy])) != df::tiletype_shape_basic::None &&
-                                DFHack::tileShapeBasic(DFHack::tileShape(block->tiletype[xxx][yyy])) != df::tiletype_shape_basic::Open)
-                                || block->designation[xxx][yyy].bits.flow_size > 0
-                                || block->occupancy[xxx][yyy].bits.building > 0)
-                            {
-                                nonAir = true;
-                                goto ItsAir;
-                            }
-                        }
-                ItsAir:
+                    bool nonAir = DFHack::Maps::anyTile(block,
+                        [](df::tiletype tt, df::tile_designation des, df::tile_occupancy occ) {
+                            auto shape = DFHack::tileShapeBasic(DFHack::tileShape(tt));
+                            return (shape != df::tiletype_shape_basic::None && shape != df::tiletype_shape_basic::Open)
+                                || des.bits.flow_size > 0
+                                || occ.bits.building > 0;
+                        });
                     if (block->flows.size() > 0)
                         nonAir = true;
                     if (nonAir || firstBlock)
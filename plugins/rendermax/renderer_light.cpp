@@ -1,10 +1,12 @@
 #include "renderer_light.hpp"
 
+#include <algorithm>
 #include <functional>
 #include <math.h>
 #include <string>
 #include <vector>
 
+#include "Core.h"
 #include "LuaTools.h"
 
 #include "modules/Gui.h"
@@ -20,6 +22,7 @@
 #include "df/graphic.h"
 #include "df/item.h"
 #include "df/items_other_id.h"
+#include "df/map_block.h"
 #include "df/plant.h"
 #include "df/plant_raw.h"
 #include "df/unit.h"
@@ -101,7 +104,8 @@ rect2d getMapViewport()
     }
     return mkrect_wh(1,1,view_rb,view_height+1);
 }
-lightingEngineViewscreen::lightingEngineViewscreen(renderer_light* target):lightingEngine(target),threading(this),doDebug(false)
+lightingEngineViewscreen::lightingEngineViewscreen(renderer_light* target):lightingEngine(target),threading(this),doDebug(false),
+    occlusionNs(0),lightNs(0),combineNs(0),batchCount(0),stolenCount(0),blocksReused(0),blocksRebuilt(0),occlusionFrame(0)
 {
     reinit();
     defaultSettings();
@@ -274,6 +278,10 @@ void lightingEngineViewscreen::clear()
         myRenderer->invalidate();
     }
 }
+void lightingEngineViewscreen::clearMapCache()
+{
+    occlusionCache.clear();
+}
 void lightingEngineViewscreen::calculate()
 {
     if(lightMap.size()!=myRenderer->lightGrid.size())
@@ -290,9 +298,25 @@ void lightingEngineViewscreen::calculate()
     {
         lightMap[getIndex(i,j)]=dim;
     }
+    uint64_t start=PerfCounters::getTimestampNs();
     doOcupancyAndLights();
+    uint64_t occlusionEnd=PerfCounters::getTimestampNs();
     threading.signalDoneOcclusion();
     threading.waitForWrites();
+    occlusionNs=occlusionEnd-start;
+    lightNs=PerfCounters::getTimestampNs()-occlusionEnd;
+    combineNs=threading.combineNs;
+    batchCount=threading.batches.size();
+    stolenCount=threading.stolenBatches;
+}
+void lightingEngineViewscreen::printStats(color_ostream &out)
+{
+    out.print("Last frame: occlusion %.3f ms, lights %.3f ms (of which combine %.3f ms)\n",
+        occlusionNs/1e6,lightNs/1e6,combineNs/1e6);
+    out.print("  %zu light batches on %zu threads, %zu stolen\n",
+        batchCount,threading.threadPool.size(),stolenCount);
+    out.print("  occlusion blocks: %zu reused, %zu rebuilt, %zu cached\n",
+        blocksReused,blocksRebuilt,occlusionCache.size());
 }
 void lightingEngineViewscreen::updateWindow()
 {
@@ -472,6 +496,148 @@ bool lightingEngineViewscreen::applyMaterial(int tileId,int matType,int matIndex
     }
     return false;
 }
+static void applyMaterialTo(rgbf& cell,lightSource& light,const matLightDef& mat,float size=1, float thickness = 1)
+{
+    if(mat.isTransparent)
+    {
+        if(thickness > 0.999 && thickness < 1.001)
+            cell*=mat.transparency;
+        else
+            cell*=mat.transparency.pow(thickness);
+    }
+    else
+        cell=rgbf(0,0,0);
+    if(mat.isEmiting)
+    {
+        lightSource source=mat.makeSource(size);
+        light.combine(source);
+        if(source.flicker)
+            light.flicker=true;
+    }
+}
+//hash of everything the tile occlusion of a block depends on
+static uint64_t occlusionSignature(df::map_block* block,df::map_block* below)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](uint64_t value) { hash = (hash ^ value) * 1099511628211ULL; };
+    mix(reinterpret_cast<uintptr_t>(block));
+    mix(reinterpret_cast<uintptr_t>(below));
+    if(!block)
+        return hash;
+    for(int x=0;x<16;x++)
+    for(int y=0;y<16;y++)
+    {
+        df::tile_designation d=block->designation[x][y];
+        mix(uint32_t(block->tiletype[x][y]));
+        mix(uint32_t(d.bits.hidden) | uint32_t(d.bits.liquid_type) << 1 | uint32_t(d.bits.flow_size) << 2);
+        if(below)
+        {
+            df::tile_designation d2=below->designation[x][y];
+            mix(uint32_t(d2.bits.liquid_type) | uint32_t(d2.bits.flow_size) << 1);
+        }
+    }
+    return hash;
+}
+const occlusionBlock& lightingEngineViewscreen::getOcclusionBlock(MapExtras::Block* b,MapExtras::Block* bDown)
+{
+    df::map_block* block=b->getRaw();
+    df::map_block* below=bDown ? bDown->getRaw() : NULL;
+    uint64_t signature=occlusionSignature(block,below);
+    DFCoord bcoord=b->getCoord();
+    uint64_t key=(uint64_t(uint16_t(bcoord.x)) << 32) | (uint64_t(uint16_t(bcoord.y)) << 16) | uint16_t(bcoord.z);
+
+    auto it=occlusionCache.find(key);
+    if(it!=occlusionCache.end() && it->second.block==block && it->second.signature==signature)
+    {
+        blocksReused++;
+        it->second.lastUsed=occlusionFrame;
+        return it->second;
+    }
+    occlusionBlock& entry=occlusionCache[key];
+    entry.lastUsed=occlusionFrame;
+    entry.block=block;
+    entry.signature=signature;
+    buildOcclusionBlock(entry,b,bDown);
+    blocksRebuilt++;
+    return entry;
+}
+void lightingEngineViewscreen::trimOcclusionCache(size_t blocksInView)
+{
+    //keep the blocks around the view so scrolling back is cheap, but don't
+    //let the cache grow with everything the view has ever passed over
+    const size_t maxCached=std::max<size_t>(blocksInView*4,1024);
+    if(occlusionCache.size()<=maxCached)
+        return;
+    for(auto it=occlusionCache.begin();it!=occlusionCache.end();)
+    {
+        if(it->second.lastUsed!=occlusionFrame)
+            it=occlusionCache.erase(it);
+        else
+            ++it;
+    }
+}
+void lightingEngineViewscreen::buildOcclusionBlock(occlusionBlock& entry,MapExtras::Block* b,MapExtras::Block* bDown)
+{
+    for(int block_x = 0; block_x < 16; block_x++)
+    for(int block_y = 0; block_y < 16; block_y++)
+    {
+        df::coord2d gpos(block_x,block_y);
+        rgbf& curCell=entry.occlusion[block_x][block_y];
+        lightSource& curLight=entry.light[block_x][block_y];
+        curCell=matAmbience.transparency;
+        curLight=lightSource();
+
+        df::tiletype type = b->tiletypeAt(gpos);
+        df::tile_designation d = b->DesignationAt(gpos);
+        if(d.bits.hidden )
+        {
+            curCell=rgbf(0,0,0);
+            continue; // do not process hidden stuff, TODO other hidden stuff
+        }
+        //df::tile_occupancy o = b->OccupancyAt(gpos);
+        df::tiletype_shape shape = ENUM_ATTR(tiletype,shape,type);
+        bool is_wall=!ENUM_ATTR(tiletype_shape,passable_high,shape);
+        bool is_floor=!ENUM_ATTR(tiletype_shape,passable_low,shape);
+        // df::tiletype_shape_basic basic_shape = ENUM_ATTR(tiletype_shape, basic_shape, shape);
+        df::tiletype_material tileMat= ENUM_ATTR(tiletype,material,type);
+
+        DFHack::t_matpair mat=b->staticMaterialAt(gpos);
+
+        matLightDef* lightDef=getMaterialDef(mat.mat_type,mat.mat_index);
+        if(!lightDef || !lightDef->isTransparent)
+            lightDef=&matWall;
+        if(shape==df::tiletype_shape::BROOK_BED )
+        {
+            curCell=rgbf(0,0,0);
+        }
+        else if(is_wall)
+        {
+            if(tileMat==df::tiletype_material::FROZEN_LIQUID)
+                applyMaterialTo(curCell,curLight,matIce);
+            else
+                applyMaterialTo(curCell,curLight,*lightDef);
+        }
+        else if(!d.bits.liquid_type && d.bits.flow_size>0 )
+        {
+            applyMaterialTo(curCell,curLight,matWater, (float)d.bits.flow_size/7.0f, (float)d.bits.flow_size/7.0f);
+        }
+        if(d.bits.liquid_type && d.bits.flow_size>0)
+        {
+            applyMaterialTo(curCell,curLight,matLava,(float)d.bits.flow_size/7.0f,(float)d.bits.flow_size/7.0f);
+        }
+        else if(!is_floor)
+        {
+            if(bDown)
+            {
+               df::tile_designation d2=bDown->DesignationAt(gpos);
+               if(d2.bits.liquid_type && d2.bits.flow_size>0)
+               {
+                   applyMaterialTo(curCell,curLight,matLava);
+               }
+            }
+        }
+    }
+}
 rgbf lightingEngineViewscreen::propogateSun(MapExtras::Block* b, int x,int y,const rgbf& in,bool lastLevel)
 {
     //TODO unify under addLight/addOclusion
@@ -622,6 +788,8 @@ void lightingEngineViewscreen::doOcupancyAndLights()
 
     MapExtras::MapCache cache;
     doSun(sky,cache);
+    blocksReused=blocksRebuilt=0;
+    occlusionFrame++;
 
     int window_x=*df::global::window_x;
     int window_y=*df::global::window_y;
@@ -643,72 +811,21 @@ void lightingEngineViewscreen::doOcupancyAndLights()
         if(!b)
             continue; //empty blocks fixed by sun propagation
 
+        const occlusionBlock& cached=getOcclusionBlock(b,bDown);
         for(int block_x = 0; block_x < 16; block_x++)
         for(int block_y = 0; block_y < 16; block_y++)
         {
             df::coord2d pos;
             pos.x = blockX*16+block_x;
             pos.y = blockY*16+block_y;
-            df::coord2d gpos=pos;
             pos=worldToViewportCoord(pos,vp,window2d);
             if(!isInRect(pos,vp))
                 continue;
             int tile=getIndex(pos.x,pos.y);
-            rgbf& curCell=ocupancy[tile];
-            curCell=matAmbience.transparency;
-
-
-            df::tiletype type = b->tiletypeAt(gpos);
-            df::tile_designation d = b->DesignationAt(gpos);
-            if(d.bits.hidden )
-            {
-                curCell=rgbf(0,0,0);
-                continue; // do not process hidden stuff, TODO other hidden stuff
-            }
-            //df::tile_occupancy o = b->OccupancyAt(gpos);
-            df::tiletype_shape shape = ENUM_ATTR(tiletype,shape,type);
-            bool is_wall=!ENUM_ATTR(tiletype_shape,passable_high,shape);
-            bool is_floor=!ENUM_ATTR(tiletype_shape,passable_low,shape);
-            // df::tiletype_shape_basic basic_shape = ENUM_ATTR(tiletype_shape, basic_shape, shape);
-            df::tiletype_material tileMat= ENUM_ATTR(tiletype,material,type);
-
-            DFHack::t_matpair mat=b->staticMaterialAt(gpos);
-
-            matLightDef* lightDef=getMaterialDef(mat.mat_type,mat.mat_index);
-            if(!lightDef || !lightDef->isTransparent)
-                lightDef=&matWall;
-            if(shape==df::tiletype_shape::BROOK_BED )
-            {
-                curCell=rgbf(0,0,0);
-            }
-            else if(is_wall)
-            {
-                if(tileMat==df::tiletype_material::FROZEN_LIQUID)
-                    applyMaterial(tile,matIce);
-                else
-                    applyMaterial(tile,*lightDef);
-            }
-            else if(!d.bits.liquid_type && d.bits.flow_size>0 )
-            {
-                applyMaterial(tile,matWater, (float)d.bits.flow_size/7.0f, (float)d.bits.flow_size/7.0f);
-            }
-            if(d.bits.liquid_type && d.bits.flow_size>0)
-            {
-                applyMaterial(tile,matLava,(float)d.bits.flow_size/7.0f,(float)d.bits.flow_size/7.0f);
-            }
-            else if(!is_floor)
-            {
-                if(bDown)
-                {
-                   df::tile_designation d2=bDown->DesignationAt(gpos);
-                   if(d2.bits.liquid_type && d2.bits.flow_size>0)
-                   {
-                       applyMaterial(tile,matLava);
-                   }
-                }
-            }
-
-
+            ocupancy[tile]=cached.occlusion[block_x][block_y];
+            const lightSource& light=cached.light[block_x][block_y];
+            if(light.radius>0)
+                addLight(tile,light);
         }
 
         df::map_block* block=b->getRaw();
@@ -775,6 +892,7 @@ void lightingEngineViewscreen::doOcupancyAndLights()
             }
         }
     }
+    trimOcclusionCache(blocksReused+blocksRebuilt);
     if(df::global::cursor->x>-30000)
     {
         int wx=df::global::cursor->x-window_x+vp.first.x;
@@ -1178,6 +1296,7 @@ void lightingEngineViewscreen::loadSettings()
 
     CoreSuspender lock;
     color_ostream_proxy out(Core::getInstance().getConsole());
+    clearMapCache(); //materials might have changed
 
     lua_State* s=DFHack::Lua::Core::State;
     lua_newtable(s);
@@ -1243,7 +1362,7 @@ void lightingEngineViewscreen::loadSettings()
 /*
  *      Threading stuff
  */
-lightThread::lightThread( lightThreadDispatch& dispatch ):dispatch(dispatch),myThread(0),isDone(false)
+lightThread::lightThread( lightThreadDispatch& dispatch ):dispatch(dispatch),lastFrame(0),queue(0),myThread(0),isDone(false)
 {
 
 }
@@ -1254,58 +1373,108 @@ lightThread::~lightThread()
 
 void lightThread::run()
 {
-    while(!isDone)
+    while(true)
     {
         //TODO: get area to process, and then process (by rounds): 1. occlusions, 2.sun, 3.lights(could be difficult, units/items etc...)
         {//wait for occlusion (and lights) to be ready
             std::unique_lock<std::mutex> guard(dispatch.occlusionMutex);
-            if(!dispatch.occlusionReady)
-                dispatch.occlusionDone.wait(guard);//wait for work
-            if(dispatch.unprocessed.size()==0 || !dispatch.occlusionReady) //spurious wake-up
-                continue;
+            dispatch.occlusionDone.wait(guard,[this]{return isDone || dispatch.frame!=lastFrame;});
+            if(isDone)
+                break;
+            lastFrame=dispatch.frame;
             if(dispatch.occlusion.size()!=canvas.size()) //oh no somebody resized stuff
                 canvas.resize(dispatch.occlusion.size());
         }
-
-
-        { //get my rectangle (any will do)
-            std::lock_guard<std::mutex> guard(dispatch.unprocessedMutex);
-            if (dispatch.unprocessed.size()==0)
-            {
-                //wtf?? why?!
-                continue;
-            }
-            myRect=dispatch.unprocessed.top();
-            dispatch.unprocessed.pop();
-            if (dispatch.unprocessed.size()==0)
-            {
-                dispatch.occlusionReady=false;
-            }
-
-        }
         work();
         {
             std::lock_guard<std::mutex> guard(dispatch.writeLock);
+            uint64_t start=PerfCounters::getTimestampNs();
             combine();//write it back
+            dispatch.combineNs+=PerfCounters::getTimestampNs()-start;
             dispatch.writeCount++;
         }
         dispatch.writesDone.notify_one();//tell about it to the dispatch.
     }
 }
 
+void lightThread::assignBatches(size_t first,size_t last)
+{
+    queue=(uint64_t(first) << 32) | uint64_t(last);
+}
+
+bool lightThread::popBatch(size_t& batch)
+{
+    uint64_t cur=queue.load();
+    while(true)
+    {
+        uint32_t front=uint32_t(cur >> 32), back=uint32_t(cur);
+        if(front>=back)
+            return false;
+        if(queue.compare_exchange_weak(cur,(uint64_t(front+1) << 32) | back))
+        {
+            batch=front;
+            return true;
+        }
+    }
+}
+
+bool lightThread::stealBatch(size_t& batch)
+{
+    uint64_t cur=queue.load();
+    while(true)
+    {
+        uint32_t front=uint32_t(cur >> 32), back=uint32_t(cur);
+        if(front>=back)
+            return false;
+        if(queue.compare_exchange_weak(cur,(uint64_t(front) << 32) | (back-1)))
+        {
+            batch=back-1;
+            return true;
+        }
+    }
+}
+
 void lightThread::work()
 {
-    canvas.assign(canvas.size(),rgbf(0,0,0));
-    for(int i=myRect.first.x;i<myRect.second.x;i++)
-    for(int j=myRect.first.y;j<myRect.second.y;j++)
+    //only tiles in the viewport are ever lit, so only those columns need clearing
+    int h=dispatch.getH();
+    auto first=canvas.begin()+std::min(canvas.size(),size_t(dispatch.viewPort.first.x*h));
+    auto last=canvas.begin()+std::min(canvas.size(),size_t(dispatch.viewPort.second.x*h));
+    std::fill(first,last,rgbf(0,0,0));
+
+    size_t batch;
+    auto doBatch=[&](size_t id){
+        myRect=dispatch.batches[id];
+        for(int i=myRect.first.x;i<myRect.second.x;i++)
+        for(int j=myRect.first.y;j<myRect.second.y;j++)
+        {
+            doLight(i,j);
+        }
+    };
+    while(popBatch(batch))
+        doBatch(batch);
+    //own batches are done, help the others. Start with the next thread so that thieves spread out.
+    size_t count=dispatch.threadPool.size();
+    size_t self=0;
+    while(self<count && dispatch.threadPool[self].get()!=this)
+        self++;
+    for(size_t k=1;k<count;k++)
     {
-        doLight(i,j);
+        lightThread& victim=*dispatch.threadPool[(self+k)%count];
+        while(victim.stealBatch(batch))
+        {
+            doBatch(batch);
+            dispatch.stolenBatches++;
+        }
     }
 }
 
 void lightThread::combine()
 {
-    for(size_t i=0;i<canvas.size();i++)
+    int h=dispatch.getH();
+    size_t first=std::min(canvas.size(),size_t(dispatch.viewPort.first.x*h));
+    size_t last=std::min(canvas.size(),size_t(dispatch.viewPort.second.x*h));
+    for(size_t i=first;i<last;i++)
     {
         rgbf& c=dispatch.lightMap[i];
         c=blend(c,canvas[i]);
@@ -1399,41 +1568,45 @@ void lightThreadDispatch::signalDoneOcclusion()
         std::lock_guard<std::mutex> guardWrite(writeLock);
         writeCount=0;
     }
-    std::lock_guard<std::mutex> guard1(occlusionMutex);
-    std::lock_guard<std::mutex> guard2(unprocessedMutex);
-    while(!unprocessed.empty())
-        unprocessed.pop();
+    combineNs=0;
+    stolenBatches=0;
+    std::lock_guard<std::mutex> guard(occlusionMutex);
+    //cut the viewport into small batches, so that a thread that got lucky with a dark area
+    //can steal work from the ones that got the magma pool.
+    batches.clear();
     viewPort=getMapViewport();
-    int threadCount=threadPool.size();
-    int w=viewPort.second.x-viewPort.first.x;
-    int slicew=w/threadCount;
-    for(int i=0;i<threadCount;i++)
-    {
-        rect2d area=viewPort;
-        area.first.x=viewPort.first.x+i*slicew;
-        if(i==threadCount-1)
-            area.second.x=viewPort.second.x; //fix, when area is even number or sth.
-        else
-            area.second.x=viewPort.first.x+(i+1)*slicew;
-        unprocessed.push(area);
-    }
-    occlusionReady=true;
+    for(int x=viewPort.first.x;x<viewPort.second.x;x+=batchSize)
+    for(int y=viewPort.first.y;y<viewPort.second.y;y+=batchSize)
+    {
+        rect2d area;
+        area.first=coord2d(x,y);
+        area.second=coord2d(std::min(x+batchSize,int(viewPort.second.x)),std::min(y+batchSize,int(viewPort.second.y)));
+        batches.push_back(area);
+    }
+    //deal out contiguous runs of batches, so each thread starts on neighbouring tiles
+    size_t threadCount=threadPool.size();
+    for(size_t i=0;i<threadCount;i++)
+        threadPool[i]->assignBatches(batches.size()*i/threadCount,batches.size()*(i+1)/threadCount);
+    frame++;
     occlusionDone.notify_all();
 }
 
 lightThreadDispatch::lightThreadDispatch( lightingEngineViewscreen* p ):parent(p),lights(parent->lights),
-    occlusionReady(false),occlusion(parent->ocupancy),num_diffusion(parent->num_diffuse),
-    lightMap(parent->lightMap),writeCount(0)
+    frame(0),occlusion(parent->ocupancy),num_diffusion(parent->num_diffuse),
+    lightMap(parent->lightMap),writeCount(0),combineNs(0),stolenBatches(0)
 {
 
 }
 
 void lightThreadDispatch::shutdown()
 {
-    for(size_t i=0;i<threadPool.size();i++)
     {
-        threadPool[i]->isDone=true;
+        std::lock_guard<std::mutex> guard(occlusionMutex);
+        for(size_t i=0;i<threadPool.size();i++)
+        {
+            threadPool[i]->isDone=true;
 
+        }
     }
     occlusionDone.notify_all();//if stuck signal that you are done with stuff.
     for(size_t i=0;i<threadPool.size();i++)
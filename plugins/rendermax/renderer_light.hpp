@@ -9,14 +9,15 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
-#include <stack>
 #include <thread>
 #include <tuple>
 #include <unordered_map>
 
+#include "ColorText.h"
 #include "renderer_opengl.hpp"
 #include "Types.h"
 
@@ -162,9 +163,12 @@ public:
 
     virtual void loadSettings()=0;
     virtual void clear()=0;
+    //drop anything kept between frames that refers to the current map
+    virtual void clearMapCache()=0;
 
     virtual void setHour(float h)=0;
     virtual void debug(bool enable)=0;
+    virtual void printStats(DFHack::color_ostream &out)=0;
 protected:
     renderer_light* myRenderer;
 };
@@ -237,6 +241,9 @@ class lightThreadDispatch
 {
     lightingEngineViewscreen *parent;
 public:
+    //lights are cast from batches of batchSize x batchSize tiles
+    static const int batchSize=8;
+
     DFHack::rect2d viewPort;
 
     std::vector<std::unique_ptr<lightThread> > threadPool;
@@ -244,9 +251,8 @@ public:
 
     std::mutex occlusionMutex;
     std::condition_variable occlusionDone; //all threads wait for occlusion to finish
-    bool occlusionReady;
-    std::mutex unprocessedMutex;
-    std::stack<DFHack::rect2d> unprocessed; //stack of parts of map where lighting is not finished
+    unsigned frame; //bumped every time new occlusion is ready
+    std::vector<DFHack::rect2d> batches; //parts of map where lighting is not finished, dealt out to the threads
     std::vector<rgbf>& occlusion;
     int& num_diffusion;
 
@@ -256,6 +262,10 @@ public:
     std::condition_variable writesDone;
     int writeCount;
 
+    //per frame statistics
+    std::atomic<uint64_t> combineNs;
+    std::atomic<size_t> stolenBatches;
+
     lightThreadDispatch(lightingEngineViewscreen* p);
     ~lightThreadDispatch();
     void signalDoneOcclusion();
@@ -271,19 +281,35 @@ class lightThread
     std::vector<rgbf> canvas;
     lightThreadDispatch& dispatch;
     DFHack::rect2d myRect;
+    unsigned lastFrame;
+    //range of dispatch.batches still owned by this thread, packed as (front<<32)|back.
+    //owner pops from the front, other threads steal from the back.
+    std::atomic<uint64_t> queue;
     void work(); //main light calculation function
     void combine(); //combine existing canvas into global lightmap
+    bool popBatch(size_t& batch);
+    bool stealBatch(size_t& batch);
 public:
     std::thread *myThread;
     std::atomic<bool> isDone;
     lightThread(lightThreadDispatch& dispatch);
     ~lightThread();
     void run();
+    void assignBatches(size_t first,size_t last);
 private:
     void doLight(int x,int y);
     void doRay(const rgbf& power,int cx,int cy,int tx,int ty,int num_diffuse);
     rgbf lightUpCell(rgbf power,int dx,int dy,int tx,int ty);
 };
+//occlusion and material lights of one map block, kept between frames
+struct occlusionBlock
+{
+    df::map_block* block;
+    uint64_t signature;
+    unsigned lastUsed; //occlusionFrame this block was last looked up in
+    rgbf occlusion[16][16];
+    lightSource light[16][16];
+};
 class lightingEngineViewscreen:public lightingEngine
 {
 public:
@@ -296,8 +322,10 @@ public:
     void preRender();
     void loadSettings();
     void clear();
+    void clearMapCache();
 
     void debug(bool enable){doDebug=enable;};
+    void printStats(DFHack::color_ostream &out);
 private:
     void fixAdvMode(int mode);
     df::coord2d worldToViewportCoord(const df::coord2d& in,const DFHack::rect2d& r,const df::coord2d& window2d) ;
@@ -305,6 +333,9 @@ private:
 
     void doSun(const lightSource& sky,MapExtras::MapCache& map);
     void doOcupancyAndLights();
+    const occlusionBlock& getOcclusionBlock(MapExtras::Block* b,MapExtras::Block* bDown);
+    void buildOcclusionBlock(occlusionBlock& entry,MapExtras::Block* b,MapExtras::Block* bDown);
+    void trimOcclusionCache(size_t blocksInView);
     rgbf propogateSun(MapExtras::Block* b, int x,int y,const rgbf& in,bool lastLevel);
     void doRay(std::vector<rgbf> & target, rgbf power,int cx,int cy,int tx,int ty);
     void doFovs();
@@ -335,6 +366,9 @@ private:
     std::vector<rgbf> lightMap;
     std::vector<rgbf> ocupancy;
     std::vector<lightSource> lights;
+    //per block occlusion of the tiles themselves, rebuilt only when the block changes
+    std::unordered_map<uint64_t,occlusionBlock> occlusionCache;
+    unsigned occlusionFrame;
 
     //Threading stuff
     int num_diffuse; //under same lock as ocupancy
@@ -350,6 +384,15 @@ private:
     rgbf getSkyColor(float v);
     bool doDebug;
 
+    //timings of the last frame
+    uint64_t occlusionNs;
+    uint64_t lightNs;
+    uint64_t combineNs;
+    size_t batchCount;
+    size_t stolenCount;
+    size_t blocksReused;
+    size_t blocksRebuilt;
+
     //settings
     float daySpeed;
     float dayHour; //<0 to cycle
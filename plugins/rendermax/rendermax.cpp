@@ -311,6 +311,13 @@ DFhackCExport command_result plugin_onstatechange(color_ostream &out, state_chan
     case SC_WORLD_UNLOADED:
         enable_hooks(false);
         break;
+    case SC_MAP_UNLOADED:
+        {
+            //cached blocks point into the map that is going away
+            CoreSuspendClaimer suspender;
+            engine->clearMapCache();
+        }
+        break;
     default:
         break;
     }
@@ -429,6 +436,11 @@ static command_result rendermax(color_ostream &out, vector <string> & parameters
             {
                 engine->debug(false);
             }
+            else if(parameters[1]=="stats")
+            {
+                CoreSuspender guard;
+                engine->printStats(out);
+            }
         }
         else
             out.printerr("Light mode already enabled");
@@ -208,28 +208,6 @@ bool StockpileSettingsSerializer::unserialize_from_file(color_ostream &out, cons
     return parse_from_istream(out, &input, mode, filters);
 }
 
-/**
- * Find an enum's value based off the string label.
- * @param traits the enum's trait struct
- * @param token the string value in key_table
- * @return the enum's value,  -1 if not found
- */
-template <typename E>
-static typename df::enum_traits<E>::base_type linear_index(df::enum_traits<E> traits, const string& token) {
-    auto j = traits.first_item_value;
-    auto limit = traits.last_item_value;
-    // sometimes enums start at -1, which is bad news for array indexing
-    if (j < 0) {
-        j += abs(traits.first_item_value);
-        limit += abs(traits.first_item_value);
-    }
-    for (; j <= limit; ++j) {
-        if (token.compare(traits.key_table[j]) == 0)
-            return j;
-    }
-    return -1;
-}
-
 static bool matches_filter(color_ostream& out, const vector<string>& filters, const string& name) {
     for (auto & filter : filters) {
         DEBUG(log, out).print("searching for '%s' in '%s'\n", filter.c_str(), name.c_str());
@@ -359,12 +337,10 @@ static void unserialize_list_quality(color_ostream& out, const char* subcat, boo
         return;
     }
 
-    using df::enums::item_quality::item_quality;
-    df::enum_traits<item_quality> quality_traits;
     for (int i = 0; i < list_size; ++i) {
         const string quality = read_value(i);
-        df::enum_traits<item_quality>::base_type idx = linear_index(quality_traits, quality);
-        if (idx < 0) {
+        df::item_quality idx;
+        if (!find_enum_item(&idx, quality) || idx < 0) {
             WARN(log, out).print("invalid quality token: %s\n", quality.c_str());
             continue;
         }
@@ -527,13 +503,13 @@ static void unserialize_list_item_type(color_ostream& out, const char* subcat, b
         return;
     }
 
-    using df::enums::item_type::item_type;
-    df::enum_traits<item_type> type_traits;
     for (int i = 0; i < list_size; ++i) {
         const string token = read_value(i);
-        // subtract one because item_type starts at -1
-        const df::enum_traits<item_type>::base_type idx = linear_index(type_traits, token) - 1;
-        if (!is_allowed((item_type)idx))
+        df::item_type type;
+        if (!find_enum_item(&type, token))
+            continue;
+        const df::enum_traits<df::item_type>::base_type idx = type;
+        if (!is_allowed(type))
             continue;
         if (idx < 0 || size_t(idx) >= num_elems) {
             WARN(log, out).print("error item_type index too large! idx[%d] max_size[%zd]\n", idx, num_elems);
@@ -11,6 +11,7 @@
 #include "modules/World.h"
 
 #include "df/building.h"
+#include "df/construction.h"
 #include "df/construction_type.h"
 #include "df/coord.h"
 #include "df/item.h"
@@ -23,10 +24,12 @@
 
 #include <bitset>
 #include <functional>
+#include <optional>
 #include <ranges>
 #include <sstream>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 using std::string;
@@ -51,6 +54,7 @@ static PersistentDataItem config;
 enum ConfigValues {
     CONFIG_IS_ENABLED = 0,
     CONFIG_PREVENT_BLOCKING = 1,
+    CONFIG_INCREMENTAL = 2,
 };
 
 
@@ -58,6 +62,8 @@ static const int32_t CYCLE_TICKS = 1213; // about one day
 static int32_t cycle_timestamp = 0;      // world->frame_counter at last cycle
 static bool cycle_needed = false;          // run requested for next cycle
 
+static void updateConstructionListener();
+
 
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -608,13 +614,170 @@ private:
         return false;
     }
 
+    // suspension reasons that only depend on the tiles and buildings around the job
+    static std::optional<Reason> localReason(color_ostream &out, df::job* job, bool prevent_blocking) {
+        std::optional<Reason> reason;
+        if (constructionIsUnsupported(out, job))
+            reason = Reason::UNSUPPORTED;
+
+        if (!prevent_blocking)
+            return reason;
+
+        if (riskBlocking(out, job))
+            return Reason::RISK_BLOCKING;
+
+        // protect (unprocessed) designations
+        auto building = Job::getHolder(job);
+        if (building && buildingOnDesignation(building))
+            reason = Reason::ERASE_DESIGNATION;
+        return reason;
+    }
+
+    /*
+     * Incremental mode
+     *
+     * The local checks above only look at tiles up to two tiles away from the
+     * building, one level up or down. Their results are cached per job and
+     * only recomputed when a map block of that neighbourhood changed since the
+     * last cycle. Changes are detected by hashing the tile state the checks
+     * read, and by the job and construction events. Dead-end detection follows
+     * whole corridors, so it is still recomputed on every cycle.
+     */
+    static constexpr size_t full_refresh_cycles = 10;
+
+    static uint64_t blockKey(int32_t bx, int32_t by, int32_t bz) {
+        return uint64_t(uint16_t(bz)) << 32 | uint64_t(uint16_t(by)) << 16 | uint16_t(bx);
+    }
+
+    static uint64_t blockKey(coord pos) {
+        return blockKey(pos.x >> 4, pos.y >> 4, pos.z);
+    }
+
+    // hash of the tile properties read by localReason()
+    static uint64_t blockSignature(df::map_block *block) {
+        uint64_t hash = 14695981039346656037ULL;
+        auto mix = [&hash](uint32_t value) { hash = (hash ^ value) * 1099511628211ULL; };
+        for (int x = 0; x < 16; ++x) {
+            for (int y = 0; y < 16; ++y) {
+                auto &des = block->designation[x][y];
+                auto &occ = block->occupancy[x][y];
+                mix(uint32_t(block->tiletype[x][y]));
+                mix(block->walkable[x][y]);
+                mix(uint32_t(des.bits.dig) | uint32_t(des.bits.smooth) << 4);
+                mix(uint32_t(occ.bits.building) |
+                    occ.bits.carve_track_north << 4 | occ.bits.carve_track_south << 5 |
+                    occ.bits.carve_track_east << 6 | occ.bits.carve_track_west << 7);
+            }
+        }
+        return hash;
+    }
+
+    // call fn(key, block) for every map block that localReason() may read for this building
+    template<typename Fn>
+    static void forEachNeighbourhoodBlock(df::building *building, Fn fn) {
+        for (int32_t z = building->z - 1; z <= building->z + 1; ++z) {
+            for (int32_t bx = (building->x1 - 2) >> 4; bx <= (building->x2 + 2) >> 4; ++bx) {
+                for (int32_t by = (building->y1 - 2) >> 4; by <= (building->y2 + 2) >> 4; ++by) {
+                    if (auto block = Maps::getBlock(bx, by, z))
+                        fn(blockKey(bx, by, z), block);
+                }
+            }
+        }
+    }
+
+    // collect the blocks that changed since the last cycle into dirty_blocks
+    void updateDirtyBlocks() {
+        std::unordered_map<uint64_t,uint64_t> signatures;
+        std::unordered_map<int,uint64_t> jobs;
+
+        for (auto job : df::global::world->jobs.list) {
+            if (!isConstructionJob(job)) continue;
+
+            auto key = blockKey(job->pos);
+            jobs.emplace(job->id, key);
+            // a new plan changes the neighbourhood of the plans around it
+            if (!known_jobs.contains(job->id))
+                dirty_blocks.insert(key);
+
+            auto building = Job::getHolder(job);
+            if (!building) continue;
+            forEachNeighbourhoodBlock(building, [&](uint64_t block_key, df::map_block *block) {
+                if (!signatures.contains(block_key))
+                    signatures.emplace(block_key, blockSignature(block));
+            });
+        }
+
+        for (auto [key, signature] : signatures) {
+            auto it = block_signatures.find(key);
+            if (it == block_signatures.end() || it->second != signature)
+                dirty_blocks.insert(key);
+        }
+
+        // so does a cancelled one
+        for (auto [id, key] : known_jobs) {
+            if (!jobs.contains(id)) {
+                dirty_blocks.insert(key);
+                local_reasons.erase(id);
+            }
+        }
+
+        block_signatures.swap(signatures);
+        known_jobs.swap(jobs);
+    }
+
+    bool neighbourhoodIsDirty(df::job *job) {
+        auto building = Job::getHolder(job);
+        if (!building)
+            return true;
+        bool dirty = false;
+        forEachNeighbourhoodBlock(building, [&](uint64_t key, df::map_block *) {
+            dirty = dirty || dirty_blocks.contains(key);
+        });
+        return dirty;
+    }
+
+    void resetIncrementalState() {
+        local_reasons.clear();
+        block_signatures.clear();
+        known_jobs.clear();
+        cycles_since_full_refresh = 0;
+    }
+
     std::unordered_map<int,Reason> suspensions;
     std::unordered_set<int> leadsToDeadend;
     size_t num_suspend = 0, num_unsuspend = 0;
 
+    // incremental mode state
+    bool incremental = false;
+    bool cached_prevent_blocking = true;
+    size_t cycles_since_full_refresh = 0;
+    std::unordered_map<int,std::optional<Reason>> local_reasons;
+    std::unordered_map<uint64_t,uint64_t> block_signatures;
+    std::unordered_map<int,uint64_t> known_jobs;
+    std::unordered_set<uint64_t> dirty_blocks;
+
+    // statistics about the last refresh
+    uint64_t last_cycle_ns = 0;
+    size_t num_constructions = 0, num_evaluated = 0;
+
 public:
     bool prevent_blocking = true;
 
+    bool isIncremental() { return incremental; }
+
+    void setIncremental(bool enable) {
+        incremental = enable;
+        resetIncrementalState();
+        dirty_blocks.clear();
+        updateConstructionListener();
+    }
+
+    // record a map change reported by an event, picked up by the next cycle
+    void markDirty(coord pos) {
+        if (incremental)
+            dirty_blocks.insert(blockKey(pos));
+    }
+
     // gather some statistics about the last call to do_cycle()
     string getStatus (color_ostream &out) {
         std::map<Reason,int> stats;
@@ -629,67 +792,90 @@ public:
         for (auto stat : stats) {
             res << std::setw(5) << stat.second << "x " << reasonToString(stat.first) << std::endl;
         }
+        res << "last cycle took " << last_cycle_ns / 1000000.0 << " ms; re-evaluated "
+            << num_evaluated << " of " << num_constructions << " construction jobs"
+            << " (incremental mode " << (incremental ? "on" : "off") << ")\n";
 
         return res.str();
     }
 
-    void refresh(color_ostream &out)
+    void refresh(color_ostream &out, bool full = false)
     {
-        DEBUG(cycle,out).print("starting refresh, prevent blocking is %s\n",
-                               prevent_blocking ? "true" : "false");
+        DEBUG(cycle,out).print("starting refresh, prevent blocking is %s, incremental is %s\n",
+                               prevent_blocking ? "true" : "false",
+                               incremental ? "true" : "false");
         suspensions.clear();
         leadsToDeadend.clear();
 
+        bool use_cache = incremental && !full &&
+            cached_prevent_blocking == prevent_blocking &&
+            ++cycles_since_full_refresh < full_refresh_cycles;
+        if (!use_cache)
+            resetIncrementalState();
+        if (incremental) {
+            updateDirtyBlocks();
+            cached_prevent_blocking = prevent_blocking;
+        }
+
+        // reasons that can be set from other jobs, these take precedence
         for (auto job : df::global::world->jobs.list) {
 
             // check carving/detailing jobs and suspend buildings over them
             preserveDesigations(job);
 
+            // may suspend other jobs, must always be called
+            if (prevent_blocking && isConstructionJob(job)) suspendDeadend(out, job);
+        }
+
+        num_constructions = num_evaluated = 0;
+        for (auto job : df::global::world->jobs.list) {
             // remaining checks only apply to construction jobs
             if (!isConstructionJob(job)) continue;
+            ++num_constructions;
 
-            // may suspend other jobs, must always be called
-            if (prevent_blocking) suspendDeadend(out, job);
-
-            if (suspensions.contains(job->id))
+            if (suspensions.contains(job->id)) {
+                local_reasons.erase(job->id);
                 continue; // we already have a reason to suspend this job
+            }
 
             // external reasons
             if (Maps::getTileDesignation(job->pos)->bits.flow_size > 1) {
                 suspensions[job->id]=Reason::UNDER_WATER;
-                continue;
             } else if (isBuildingPlanJob(job)) {
                 suspensions[job->id]=Reason::BUILDINGPLAN;
-                continue;
             } else if (isOnUnmovableItem(job)) {
                 suspensions[job->id]=Reason::ITEM_IN_JOB;
-                continue;
             }
-
-            if (constructionIsUnsupported(out, job))
-                suspensions[job->id]=Reason::UNSUPPORTED;
-
-            if (!prevent_blocking) continue;
-
-            if (riskBlocking(out, job)) {
-                suspensions[job->id]=Reason::RISK_BLOCKING;
+            if (suspensions.contains(job->id)) {
+                local_reasons.erase(job->id);
                 continue;
             }
 
-            // protect (unprocessed) designations
-            auto building = Job::getHolder(job);
-            if (building && buildingOnDesignation(building))
-                suspensions[job->id]=Reason::ERASE_DESIGNATION;
+            std::optional<Reason> reason;
+            auto cached = local_reasons.find(job->id);
+            if (use_cache && cached != local_reasons.end() && !neighbourhoodIsDirty(job)) {
+                reason = cached->second;
+            } else {
+                reason = localReason(out, job, prevent_blocking);
+                ++num_evaluated;
+                if (incremental)
+                    local_reasons[job->id] = reason;
+            }
+            if (reason)
+                suspensions[job->id] = *reason;
         }
-        DEBUG(cycle,out).print("finished refresh: found %zu reasons for suspension\n",suspensions.size());
+        dirty_blocks.clear();
+        DEBUG(cycle,out).print("finished refresh: found %zu reasons for suspension, re-evaluated %zu of %zu constructions\n",
+                               suspensions.size(), num_evaluated, num_constructions);
     }
 
-    void do_cycle (color_ostream &out, bool unsuspend_everything = false)
+    void do_cycle (color_ostream &out, bool unsuspend_everything = false, bool full = false)
     {
+        uint64_t start_ns = PerfCounters::getTimestampNs();
         if (unsuspend_everything){
             suspensions.clear();
         } else {
-            refresh(out);
+            refresh(out, full);
         }
         num_suspend = 0, num_unsuspend = 0;
 
@@ -709,6 +895,7 @@ public:
                 }
             }
         }
+        last_cycle_ns = PerfCounters::getTimestampNs() - start_ns;
         DEBUG(cycle,out).print("suspended %zu constructions and unsuspended %zu constructions\n",
                               num_suspend, num_unsuspend);
     }
@@ -752,19 +939,19 @@ public:
 
 
 std::unique_ptr<SuspendManager> suspendmanager_instance;
-std::unique_ptr<EventManager::EventHandler> eventhandler_instance;
 
 
 static command_result do_command(color_ostream &out, vector<string> &parameters);
 static command_result do_unsuspend_command(color_ostream &out, vector<string> &parameters);
 static void do_cycle(color_ostream &out);
-static void jobCompletedHandler(color_ostream& out, void* ptr);
+static void jobCompletedHandler(color_ostream& out, df::job* job);
+static void constructionHandler(color_ostream& out, df::construction* construction);
+static void registerEventHandlers();
 
 DFhackCExport command_result plugin_init(color_ostream &out, std::vector <PluginCommand> &commands) {
     DEBUG(control,out).print("initializing %s\n", plugin_name);
 
     suspendmanager_instance = std::make_unique<SuspendManager>();
-    eventhandler_instance = std::make_unique<EventManager::EventHandler>(plugin_self,jobCompletedHandler,1);
 
     // provide a configuration interface for the plugin
     commands.push_back(PluginCommand(
@@ -792,8 +979,7 @@ DFhackCExport command_result plugin_enable(color_ostream &out, bool enable) {
                                 is_enabled ? "enabled" : "disabled");
         config.set_bool(CONFIG_IS_ENABLED, is_enabled);
         if (enable) {
-            EventManager::registerListener(EventManager::EventType::JOB_COMPLETED, *eventhandler_instance);
-            EventManager::registerListener(EventManager::EventType::JOB_INITIATED, *eventhandler_instance);
+            registerEventHandlers();
             do_cycle(out);
         } else {
             EventManager::unregisterAll(plugin_self);
@@ -810,7 +996,6 @@ DFhackCExport command_result plugin_enable(color_ostream &out, bool enable) {
 DFhackCExport command_result plugin_shutdown (color_ostream &out) {
     DEBUG(control,out).print("shutting down %s\n", plugin_name);
     suspendmanager_instance.release();
-    eventhandler_instance.release();
     return CR_OK;
 }
 
@@ -827,13 +1012,14 @@ DFhackCExport command_result plugin_load_site_data (color_ostream &out) {
 
     is_enabled = config.get_bool(CONFIG_IS_ENABLED);
     suspendmanager_instance->prevent_blocking = config.get_bool(CONFIG_PREVENT_BLOCKING);
-    DEBUG(control,out).print("loading persisted state: enabled is %s / prevent_blocking is %s\n",
+    suspendmanager_instance->setIncremental(config.get_bool(CONFIG_INCREMENTAL));
+    DEBUG(control,out).print("loading persisted state: enabled is %s / prevent_blocking is %s / incremental is %s\n",
                             is_enabled ? "true" : "false",
-                            suspendmanager_instance->prevent_blocking ? "true" : "false");
+                            suspendmanager_instance->prevent_blocking ? "true" : "false",
+                            suspendmanager_instance->isIncremental() ? "true" : "false");
     if(is_enabled) {
         DEBUG(control,out).print("registering job event handlers\n");
-        EventManager::registerListener(EventManager::EventType::JOB_COMPLETED, *eventhandler_instance);
-        EventManager::registerListener(EventManager::EventType::JOB_INITIATED, *eventhandler_instance);
+        registerEventHandlers();
         do_cycle(out);
     }
 
@@ -874,6 +1060,7 @@ static command_result do_command(color_ostream &out, vector<string> &parameters)
             out.print(
                 "%s is enabled %s supending blocking jobs\n", plugin_name,
                 suspendmanager_instance->prevent_blocking ? "and" : "but not");
+            out.print("%s", suspendmanager_instance->getStatus(out).c_str());
         }
         return CR_OK;
     } else if (parameters[0] == "now") {
@@ -902,6 +1089,21 @@ static command_result do_command(color_ostream &out, vector<string> &parameters)
             return CR_OK;
         } else
             return CR_WRONG_USAGE;
+    } else if (parameters.size() == 3 && parameters[0] == "set" && parameters[1] == "incremental") {
+        bool enable;
+        if (parameters[2] == "true")
+            enable = true;
+        else if (parameters[2] == "false")
+            enable = false;
+        else
+            return CR_WRONG_USAGE;
+        suspendmanager_instance->setIncremental(enable);
+        config.set_bool(CONFIG_INCREMENTAL, enable);
+        if (is_enabled) {
+            do_cycle(out);
+            out.print("%s", suspendmanager_instance->getStatus(out).c_str());
+        }
+        return CR_OK;
     } else {
         return CR_WRONG_USAGE;
     }
@@ -913,9 +1115,26 @@ static command_result do_unsuspend_command(color_ostream &out, vector<string> &p
     return ok ? CR_OK : CR_FAILURE;
 }
 
-static void jobCompletedHandler(color_ostream& out, void* ptr) {
+static void registerEventHandlers() {
+    using namespace EventManager;
+    registerListener<EventType::JOB_COMPLETED, jobCompletedHandler>(plugin_self, 1);
+    registerListener<EventType::JOB_INITIATED, jobCompletedHandler>(plugin_self, 1);
+    updateConstructionListener();
+}
+
+// construction events only feed the incremental mode's dirty blocks, so only
+// listen for them (and pay for EventManager's construction scan) while it is on
+static void updateConstructionListener() {
+    using namespace EventManager;
+    unregister<EventType::CONSTRUCTION, constructionHandler>(plugin_self, 100);
+    if (is_enabled && suspendmanager_instance->isIncremental())
+        registerListener<EventType::CONSTRUCTION, constructionHandler>(plugin_self, 100);
+}
+
+static void jobCompletedHandler(color_ostream& out, df::job* job) {
     TRACE(cycle,out).print("job completed/initiated handler called\n");
-    df::job* job = static_cast<df::job*>(ptr);
+    // digging, smoothing and carving jobs change the neighbourhood of planned constructions
+    suspendmanager_instance->markDirty(job->pos);
     if (SuspendManager::isConstructionJob(job)) {
         DEBUG(cycle,out).print("construction job initiated/completed (tick: %d)\n", world->frame_counter);
         cycle_needed = true;
@@ -923,6 +1142,12 @@ static void jobCompletedHandler(color_ostream& out, void* ptr) {
 
 }
 
+static void constructionHandler(color_ostream& out, df::construction* construction) {
+    TRACE(cycle,out).print("construction added/removed at (%d, %d, %d)\n",
+                           construction->pos.x, construction->pos.y, construction->pos.z);
+    suspendmanager_instance->markDirty(construction->pos);
+}
+
 /////////////////////////////////////////////////////
 // cycle logic
 //
@@ -965,7 +1190,7 @@ static bool suspendmanager_isKeptSuspended(df::job *job) {
 static void suspendmanager_runOnce(color_ostream &out, bool blocking, bool unsuspend_everything) {
     auto save = suspendmanager_instance->prevent_blocking;
     suspendmanager_instance->prevent_blocking = blocking;
-    suspendmanager_instance->do_cycle(out, unsuspend_everything);
+    suspendmanager_instance->do_cycle(out, unsuspend_everything, true);
     suspendmanager_instance->prevent_blocking = save;
 }
 
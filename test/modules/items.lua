@@ -0,0 +1,97 @@
+config.target = 'core'
+config.mode = 'fortress' -- needs items on a map
+
+local function distance(a, b)
+    return math.max(math.abs(a.x - b.x), math.abs(a.y - b.y)) + math.abs(a.z - b.z)
+end
+
+local function get_ground_items()
+    local items = {}
+    for _, item in ipairs(df.global.world.items.all) do
+        if item.flags.on_ground and dfhack.maps.isValidTilePos(item.pos) then
+            table.insert(items, item)
+        end
+    end
+    return items
+end
+
+local function get_center()
+    local item = get_ground_items()[1]
+    return item and copyall(item.pos) or xyz2pos(0, 0, 0)
+end
+
+local function sorted_ids(items)
+    local ids = {}
+    for _, item in ipairs(items) do
+        table.insert(ids, item.id)
+    end
+    table.sort(ids)
+    return ids
+end
+
+local function scan(pred)
+    local items = {}
+    for _, item in ipairs(get_ground_items()) do
+        if pred(item) then
+            table.insert(items, item)
+        end
+    end
+    return sorted_ids(items)
+end
+
+function test.getItemsInBox()
+    local c = get_center()
+    local pos1, pos2 = xyz2pos(c.x - 20, c.y - 20, c.z - 2), xyz2pos(c.x + 20, c.y + 20, c.z + 2)
+    local expected = scan(function(item)
+        local pos = item.pos
+        return pos.x >= pos1.x and pos.x <= pos2.x and pos.y >= pos1.y and pos.y <= pos2.y and
+            pos.z >= pos1.z and pos.z <= pos2.z
+    end)
+    expect.table_eq(sorted_ids(dfhack.items.getItemsInBox(pos1, pos2)), expected)
+    expect.table_eq(sorted_ids(dfhack.items.getItemsInBox(pos2, pos1)), expected)
+end
+
+function test.getItemsInRadius()
+    local c = get_center()
+    for _, radius in ipairs{0, 5, 30} do
+        local expected = scan(function(item) return distance(c, item.pos) <= radius end)
+        expect.table_eq(sorted_ids(dfhack.items.getItemsInRadius(c, radius)), expected, radius)
+    end
+    expect.eq(#dfhack.items.getItemsInRadius(c, -1), 0)
+end
+
+function test.getItemsInRadius_filter()
+    local c = get_center()
+    local is_even = function(item) return item.id % 2 == 0 end
+    local expected = scan(function(item) return distance(c, item.pos) <= 30 and is_even(item) end)
+    expect.table_eq(sorted_ids(dfhack.items.getItemsInRadius(c, 30, is_even)), expected)
+end
+
+function test.getNearestItems()
+    local c = get_center()
+    local dists = {}
+    for _, item in ipairs(get_ground_items()) do
+        table.insert(dists, distance(c, item.pos))
+    end
+    table.sort(dists)
+    local items = dfhack.items.getNearestItems(c, 10)
+    expect.eq(#items, math.min(10, #dists))
+    for i, item in ipairs(items) do
+        expect.eq(distance(c, item.pos), dists[i], i)
+        if i > 1 and distance(c, items[i-1].pos) == distance(c, item.pos) then
+            expect.lt(items[i-1].id, item.id, 'ties go to the lower id')
+        end
+    end
+    expect.eq(#dfhack.items.getNearestItems(c), math.min(1, #dists))
+end
+
+function test.getNearestItems_filter()
+    local c = get_center()
+    local is_even = function(item) return item.id % 2 == 0 end
+    local expected = scan(is_even)
+    local items = dfhack.items.getNearestItems(c, #df.global.world.items.all + 1, is_even)
+    expect.table_eq(sorted_ids(items), expected)
+    for i = 2, #items do
+        expect.le(distance(c, items[i-1].pos), distance(c, items[i].pos), i)
+    end
+end
@@ -0,0 +1,77 @@
+config.target = 'core'
+config.mode = 'fortress' -- needs the world raws
+
+local raws = df.global.world.raws
+
+function test.find_inorganic()
+    for i, inorganic in ipairs(raws.inorganics) do
+        local info = dfhack.matinfo.find('INORGANIC:' .. inorganic.id)
+        expect.eq(info and info.index, i, inorganic.id)
+    end
+    expect.nil_(dfhack.matinfo.find('INORGANIC:DFHACK_NOT_A_ROCK'))
+end
+
+local function check_materials(prefix, objs, get_id)
+    for i, obj in ipairs(objs) do
+        local id = get_id(obj)
+        for _, mat in ipairs(obj.material) do
+            local token = prefix .. ':' .. id .. ':' .. mat.id
+            local info = dfhack.matinfo.find(token)
+            expect.eq(info and info.index, i, token)
+            expect.eq(info and info.material.id, mat.id, token)
+        end
+        expect.nil_(dfhack.matinfo.find(prefix .. ':' .. id .. ':DFHACK_NOT_A_MATERIAL'))
+    end
+end
+
+function test.find_plant_materials()
+    check_materials('PLANT', raws.plants.all, function(plant) return plant.id end)
+end
+
+function test.find_creature_materials()
+    check_materials('CREATURE', raws.creatures.all, function(creature) return creature.creature_id end)
+end
+
+-- raws renamed in place are not picked up until the next world load, but a
+-- stale index entry must never resolve to the renamed raw. looking up the
+-- stale token reindexes, so we look up the test token again after restoring
+-- the original to leave the index as we found it.
+function test.find_renamed_raw()
+    local inorganic = raws.inorganics[0]
+    local old_id = inorganic.id
+    local new_id = 'DFHACK_TEST_RENAMED'
+    expect.eq(dfhack.matinfo.find('INORGANIC:' .. old_id).index, 0)
+    dfhack.with_finalize(
+        function()
+            inorganic.id = old_id
+            dfhack.matinfo.find('INORGANIC:' .. new_id)
+        end,
+        function()
+            inorganic.id = new_id
+            expect.nil_(dfhack.matinfo.find('INORGANIC:' .. old_id))
+            local info = dfhack.matinfo.find('INORGANIC:' .. new_id)
+            expect.eq(info and info.index, 0)
+        end)
+    expect.eq(dfhack.matinfo.find('INORGANIC:' .. old_id).index, 0)
+end
+
+function test.find_renamed_material()
+    local plant = raws.plants.all[0]
+    local mat = plant.material[0]
+    local old_id = mat.id
+    local new_id = 'DFHACK_TEST_RENAMED'
+    local prefix = 'PLANT:' .. plant.id .. ':'
+    expect.eq(dfhack.matinfo.find(prefix .. old_id).material.id, old_id)
+    dfhack.with_finalize(
+        function()
+            mat.id = old_id
+            dfhack.matinfo.find(prefix .. new_id)
+        end,
+        function()
+            mat.id = new_id
+            expect.nil_(dfhack.matinfo.find(prefix .. old_id))
+            local info = dfhack.matinfo.find(prefix .. new_id)
+            expect.eq(info and info.material.id, new_id)
+        end)
+    expect.eq(dfhack.matinfo.find(prefix .. old_id).material.id, old_id)
+end
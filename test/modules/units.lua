@@ -0,0 +1,112 @@
+config.target = 'core'
+config.mode = 'fortress' -- needs units on a map
+
+local function distance(a, b)
+    return math.max(math.abs(a.x - b.x), math.abs(a.y - b.y)) + math.abs(a.z - b.z)
+end
+
+local function get_center()
+    for _, unit in ipairs(df.global.world.units.active) do
+        if dfhack.maps.isValidTilePos(unit.pos) then
+            return copyall(unit.pos)
+        end
+    end
+end
+
+local function get_ids(units)
+    local ids = {}
+    for _, unit in ipairs(units) do
+        table.insert(ids, unit.id)
+    end
+    return ids
+end
+
+local function sorted_ids(units)
+    local ids = get_ids(units)
+    table.sort(ids)
+    return ids
+end
+
+-- the ids of the units on the map that pass pred, in world.units.all order
+local function scan(pred)
+    local units = {}
+    for _, unit in ipairs(df.global.world.units.all) do
+        if dfhack.maps.isValidTilePos(unit.pos) and pred(unit) then
+            table.insert(units, unit)
+        end
+    end
+    return get_ids(units)
+end
+
+-- the first query after an update scans the unit list and the next ones use
+-- the position index, so every check runs the query twice
+local function twice(fn)
+    dfhack.units.markUnitGridStale()
+    fn()
+    fn()
+end
+
+function test.getUnitsInBox()
+    local c = get_center()
+    local pos1, pos2 = xyz2pos(c.x - 20, c.y - 20, c.z - 2), xyz2pos(c.x + 20, c.y + 20, c.z + 2)
+    local expected = scan(function(unit)
+        return dfhack.units.isUnitInBox(unit, pos1.x, pos1.y, pos1.z, pos2.x, pos2.y, pos2.z)
+    end)
+    twice(function()
+        expect.table_eq(get_ids(dfhack.units.getUnitsInBox(
+            pos2.x, pos2.y, pos2.z, pos1.x, pos1.y, pos1.z)), expected)
+    end)
+end
+
+function test.getUnitsInRadius()
+    local c = get_center()
+    for _, radius in ipairs{0, 5, 30} do
+        local expected = scan(function(unit) return distance(c, unit.pos) <= radius end)
+        twice(function()
+            expect.table_eq(get_ids(dfhack.units.getUnitsInRadius(c, radius)), expected, radius)
+        end)
+    end
+end
+
+function test.getUnitsInRadius_filter()
+    local c = get_center()
+    local is_even = function(unit) return unit.id % 2 == 0 end
+    local expected = scan(function(unit) return distance(c, unit.pos) <= 30 and is_even(unit) end)
+    twice(function()
+        expect.table_eq(get_ids(dfhack.units.getUnitsInRadius(c, 30, is_even)), expected)
+    end)
+end
+
+function test.getNearestUnits()
+    local c = get_center()
+    local dists = {}
+    for _, unit in ipairs(df.global.world.units.all) do
+        if dfhack.maps.isValidTilePos(unit.pos) then
+            table.insert(dists, distance(c, unit.pos))
+        end
+    end
+    table.sort(dists)
+    twice(function()
+        local units = dfhack.units.getNearestUnits(c, 5)
+        expect.eq(#units, math.min(5, #dists))
+        for i, unit in ipairs(units) do
+            expect.eq(distance(c, unit.pos), dists[i], i)
+        end
+        expect.eq(#dfhack.units.getNearestUnits(c), math.min(1, #dists))
+        expect.eq(#dfhack.units.getNearestUnits(c, 0), 0)
+    end)
+end
+
+function test.getNearestUnits_filter()
+    local c = get_center()
+    local is_even = function(unit) return unit.id % 2 == 0 end
+    local expected = scan(is_even)
+    table.sort(expected)
+    twice(function()
+        local units = dfhack.units.getNearestUnits(c, #df.global.world.units.all + 1, is_even)
+        expect.table_eq(sorted_ids(units), expected)
+        for i = 2, #units do
+            expect.le(distance(c, units[i-1].pos), distance(c, units[i].pos), i)
+        end
+    end)
+end